@@ -1,13 +1,58 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <mysql.h>
-#include <conio.h>
 #include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
 #ifdef _WIN32
     #include <windows.h> // For Windows
+    #include <psapi.h>   // Peak working set for benchmarks
+    #include <conio.h>   // getch for password entry
+    #include <io.h>
 #else
     #include <unistd.h>  // For Linux/macOS
+    #include <termios.h> // Raw terminal input for getch
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/resource.h>
+#endif
+#ifdef __linux__
+    #include <linux/perf_event.h> // Cache-miss counters for benchmarks
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <sys/epoll.h>        // Event loops of the async executor and the seat lookup service
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <arpa/inet.h>
+    #include <signal.h>
+#endif
+
+// MariaDB's non-blocking client calls drive the async executor (blocking fallback elsewhere)
+#if defined(__linux__) && defined(LIBMARIADB)
+    #define ASYNC_DB_IO 1
+#else
+    #define ASYNC_DB_IO 0
+#endif
+
+// SIMD delimiter scanning for the CSV reader (scalar fallback elsewhere)
+#if defined(__GNUC__) && defined(__SSE2__)
+    #include <emmintrin.h>
+    #define CSV_HAVE_SSE2 1
+#else
+    #define CSV_HAVE_SSE2 0
+#endif
+#if CSV_HAVE_SSE2 && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define CSV_HAVE_AVX2 1 // Selected at runtime with __builtin_cpu_supports
+#else
+    #define CSV_HAVE_AVX2 0
 #endif
 
 // Global variables
@@ -21,29 +66,1008 @@ typedef struct {
     int room_number;
     int total_benches;
     int seats_per_bench;
-    int **seats; // 2D array for seat status
+    int two_seater_count; // Benches [0, two_seater_count) have 2 seats, the rest 3
+    int seat_count;
+    int *seats; // Subject per seat, bench after bench (see benchSeatOffset); 0 = free
+    int seatWords;      // 64-bit words per seat bitset
+    uint64_t *occupied; // Bit per seat: taken
+    uint64_t *blocked;  // seatWords words per subject slot: seats where that subject would sit next to itself
+    int firstFreeWord;  // No free seat before this word of occupied
 } Room;
 
+#define CACHE_LINE_SIZE 64
+
+// Bump allocator for seat matrices: one malloc per run, cache-line-aligned blocks, one free
+typedef struct {
+    char *block; // As returned by malloc
+    char *base;  // block rounded up to a cache line
+    size_t size;
+    size_t used;
+} SeatArena;
+
+// Open-addressing map from positive int keys to int values
+typedef struct {
+    int *keys; // 0 marks an empty slot
+    int *values;
+    size_t capacity;
+    size_t count;
+} IntMap;
+
+// Where first fit resumes for one subject. Seats only ever become unavailable during a day,
+// so no seat before the cursor can be the first fit for that subject again.
+typedef struct {
+    int room;
+    int word;
+} SubjectCursor;
+
+// One student-subject sitting and the seat the allocation engine gave it
+typedef struct {
+    int student_id;
+    int subject_id;
+    int subjectSlot; // Dense subject index within its day (AllocationDay.subjects)
+    int roomIndex; // Index into AllocationEngine.rooms, -1 if no seat was found
+    int bench;
+    int seat;
+} SeatAssignment;
+
+// A seat already saved in seat_allocation, as found by an incremental run
+typedef struct {
+    SeatAssignment assignment; // First member, so compareSeatAssignments orders these too
+    int enrolled; // The sitting is still in student_subjects for this day
+    int kept; // Still valid; otherwise its row is deleted and, if enrolled, the sitting placed again
+} ExistingSeat;
+
+// One exam day: its sittings and what seating them produced
+typedef struct {
+    int day;
+    SeatAssignment *assignments; // Sittings to place: new ones by student and subject, then displaced ones
+    int count;
+    int newCount; // Sittings that had no seat when the day was loaded
+    ExistingSeat *existing; // Incremental runs only, ordered by student and subject
+    int existingCount;
+    int kept;
+    int displaced;
+    IntMap subjects; // subject_id -> dense slot
+    int subjectCount;
+    int allocated;
+    int failed;
+    int roomsUsed; // Rooms with at least one seat taken
+    int usedCapacity; // Seats in those rooms
+    double loadSeconds;
+    double waitSeconds; // Part of loadSeconds the placement had to wait for; the rest was prefetched
+    double allocateSeconds;
+} AllocationDay;
+
+// A private copy of the rooms whose seat blocks, bitsets and cursors live in one arena
+typedef struct {
+    Room *rooms;
+    int roomCount;
+    int subjectCapacity;
+    SeatArena arena;
+    SubjectCursor *cursors; // Per subject slot
+} SeatWorkspace;
+
+// How a day's sittings are put into the rooms of an empty workspace. A strategy sets roomIndex,
+// bench and seat for every sitting it places and leaves roomIndex at -1 for the rest.
+typedef struct {
+    const char *name;
+    const char *option; // Name on the command line
+    int (*place)(SeatWorkspace *workspace, AllocationDay *day);
+} PlacementStrategy;
+
+// Room topology and the days to seat. Days are independent: each is seated on its own workspace.
+typedef struct {
+    Room *rooms; // Topology only; seats live in SeatWorkspace copies
+    int roomCount;
+    int dayCount;
+    AllocationDay *days; // days[d - 1] is day d
+    const PlacementStrategy *strategy;
+    int incremental; // Re-check every saved seat, keep the valid ones and place only the rest
+    IntMap roomSlots; // room_id -> index into rooms
+    struct StorageBackend *storage; // Where the rooms and sittings come from and the seats go
+    void *session; // The calling thread's session on storage
+} AllocationEngine;
+
+// Lanes of the interleaving pattern: outer and middle seats of even benches, then of odd benches
+#define INTERLEAVE_LANES 4
+
+#define DEFAULT_ALLOCATION_WORKERS 4
+#define DEFAULT_EXAM_DAYS 4 // Maximum number of exam days
+
+// Allocation worker: seats whole days on its own session, prefetching the next on a second one
+typedef struct {
+    AllocationEngine *engine;
+    void *session;
+    void *prefetchSession;
+    _Atomic int *nextDay;
+    _Atomic int *failed;
+    pthread_t thread;
+} AllocationWorker;
+
+// Background load of a worker's next day
+typedef struct {
+    AllocationEngine *engine;
+    void *session;
+    AllocationDay *day;
+    int status;
+    pthread_t thread;
+} DayPrefetch;
+
+// Bulk ingest tuning
+#define DEFAULT_BULK_BATCH_SIZE 5000          // CSV lines committed per transaction
+#define BULK_MAX_STATEMENT_BYTES (512 * 1024) // Keep multi-row statements well below max_allowed_packet
+
+// Instrumentation, enabled at run time with ECCS_METRICS=json or ECCS_METRICS=prometheus and
+// dumped at exit to ECCS_METRICS_FILE. Disabled, every wrapper costs one branch.
+typedef enum {
+    QUERY_OTHER,
+    QUERY_INGEST_WRITE,
+    QUERY_ID_LOOKUP,
+    QUERY_ALLOCATION_READ,
+    QUERY_ALLOCATION_WRITE,
+    QUERY_EXPORT,
+    QUERY_KIND_COUNT
+} QueryKind;
+
+typedef enum {
+    PHASE_INGEST,
+    PHASE_ALLOCATION_LOAD,
+    PHASE_ALLOCATION_PLACE,
+    PHASE_ALLOCATION_SAVE,
+    PHASE_EXPORT,
+    PHASE_COUNT
+} MetricsPhase;
+
+// Log-linear buckets in the style of HDR histograms: exact below 8, then 8 sub-buckets per power
+// of two, so any recorded value is within 12.5% of its bucket
+#define HISTOGRAM_SUB_BUCKET_BITS 3
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+    _Atomic uint64_t buckets[HISTOGRAM_BUCKETS];
+} Histogram;
+
+typedef struct {
+    _Atomic uint64_t errors;
+    _Atomic uint64_t rows; // Fetched, or affected by statements without a result set
+    _Atomic uint64_t bytesSent;
+    _Atomic uint64_t bytesReceived;
+    Histogram latency; // Nanoseconds per call; streamed results only count until the first row
+} QueryMetrics;
+
+typedef struct {
+    int enabled;
+    int prometheus;
+    char path[256];
+    QueryMetrics queries[QUERY_KIND_COUNT];
+    Histogram phases[PHASE_COUNT]; // Nanoseconds per run of a phase
+    Histogram seatsScanned; // Seats looked at per first-fit placement attempt, 0 once a subject has no room left
+} Metrics;
+
+Metrics metrics; // Zeroed, so instrumentation is off until metricsInit enables it
+
+// Growable buffer used to build multi-row SQL statements
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} SqlBuffer;
+
+// Multi-row statement builder: prefix, comma-separated rows, optional suffix
+typedef struct {
+    MYSQL *connection;
+    SqlBuffer buffer;
+    const char *prefix;
+    const char *suffix;
+    int rows;
+    int (*onResult)(MYSQL_RES *result, void *context); // Called for statements that return rows
+    void *context;
+    QueryKind kind; // Metrics bucket for the statements and fetched rows
+} SqlBatch;
+
+// Prepared statements, kept per connection so each query shape is parsed by the server once
+#define STATEMENT_CACHE_SIZE 16
+#define STATEMENT_BATCH_ROWS 1024 // Rows bound per cached multi-row statement
+
+typedef struct {
+    char *sql;
+    MYSQL_STMT *statement;
+    unsigned long lastUse; // Cache clock at the last lookup; the oldest entry is evicted first
+} CachedStatement;
+
+typedef struct {
+    MYSQL *connection;
+    CachedStatement entries[STATEMENT_CACHE_SIZE];
+    int count;
+    unsigned long clock;
+    long prepares;
+    long hits;
+} StatementCache;
+
+StatementCache mainStatements; // Prepared statements of conn
+
+// Hot query shapes, shared by the prepared statements and the startup EXPLAIN check
+const char dayEnrollmentsQuery[] =
+    "SELECT ss.student_id, ss.subject_id "
+    "FROM student_subjects ss "
+    "JOIN students s ON s.id = ss.student_id "
+    "WHERE ss.subject_index = ? "
+    "AND NOT EXISTS (SELECT 1 FROM seat_allocation a "
+    "WHERE a.student_id = ss.student_id "
+    "AND a.subject_id = ss.subject_id "
+    "AND a.day = ?)";
+const char savedSeatsQuery[] =
+    "SELECT a.student_id, a.subject_id, a.room_id, a.bench_number, a.seat_number, "
+    "EXISTS (SELECT 1 FROM student_subjects ss "
+    "WHERE ss.student_id = a.student_id "
+    "AND ss.subject_id = a.subject_id "
+    "AND ss.subject_index = a.day) "
+    "FROM seat_allocation a WHERE a.day = ?";
+const char studentIdQuery[] = "SELECT id FROM students WHERE symbol_number = ?";
+const char subjectIdQuery[] = "SELECT id FROM subjects WHERE subject_name = ?";
+
+// Multi-row prepared statement with integer columns: full chunks of STATEMENT_BATCH_ROWS rows share
+// one cached statement, the final partial chunk is prepared for its own size
+typedef struct {
+    StatementCache *cache;
+    SqlBuffer sql; // Text of a full chunk
+    const char *prefix;
+    const char *suffix;
+    int columns;
+    int *values; // Row-major, STATEMENT_BATCH_ROWS * columns
+    MYSQL_BIND *binds; // One per value, bound once
+    int rows;
+    long affectedRows;
+    QueryKind kind;
+} StatementBatch;
+
+// Schema bootstrap: missing tables are created, and databases that predate them get the indexes and
+// trigger the hot queries rely on. Every step checks first, so it is safe at every start.
+#define SCHEMA_SCAN_WARN_ROWS 1000 // Estimated rows above which a full table scan is reported
+
+typedef struct {
+    const char *table;
+    const char *name;
+    const char *columns;
+    const char *purpose;
+} SchemaIndex;
+
+typedef struct {
+    const char *name;
+    const char *query;
+    const char *sample; // Literal put in place of every ? for EXPLAIN
+} HotQuery;
+
+// Chunked string storage; pointers stay valid until the pool is freed
+typedef struct StringPoolBlock {
+    struct StringPoolBlock *next;
+    size_t used;
+    size_t capacity;
+    char data[];
+} StringPoolBlock;
+
+typedef struct {
+    StringPoolBlock *head;
+} StringPool;
+
+// Memory-mapped CSV input
+typedef struct {
+    const char *data;
+    size_t size;
+    size_t position;
+    long line;
+    int mapped;
+    size_t blockStart;   // Offset of the 64-byte block described by blockMask
+    uint64_t blockMask;  // Structural characters (, \n ") in that block
+} CsvReader;
+
+// Zero-copy view of one CSV field (quotes already stripped)
+typedef struct {
+    const char *data;
+    size_t length;
+    int escaped; // Field contains "" pairs; use csvFieldCopy to unescape
+} CsvField;
+
+#define CSV_VALUE_MAX 255 // Longest symbol, name, college or subject; the columns are VARCHAR(255)
+
+// One student-subject row staged for bulk ingest
+typedef struct {
+    const char *symbol_number;
+    const char *name;
+    const char *college_name;
+    const char *subject;
+} StagedEnrollment;
+
+// Sorted distinct keys of a staged batch and their database ids
+typedef struct {
+    const char *key;
+    const StagedEnrollment *row;
+    int id;
+} KeyIdEntry;
+
+typedef struct {
+    KeyIdEntry *entries;
+    int count;
+} KeyIdTable;
+
+// Open-addressing (linear probing) map from a string key to a database id
+typedef struct {
+    const char *key;
+    size_t length;
+    uint64_t hash;
+    int id;
+} IdDictionaryEntry;
+
+typedef struct {
+    IdDictionaryEntry *entries;
+    size_t capacity; // Power of two
+    size_t count;
+    StringPool keys;
+} IdDictionary;
+
+// Open-addressing set of (student_id, subject_id) pairs packed into one 64-bit key
+typedef struct {
+    uint64_t *slots; // 0 marks an empty slot; ids start at 1
+    size_t capacity;
+    size_t count;
+} PairSet;
+
+// Ingest-time lookups: symbol_number -> student id, subject_name -> subject id, known enrollments
+typedef struct {
+    IdDictionary students;
+    IdDictionary subjects;
+    PairSet enrollments;
+} IngestDictionary;
+
+// Parallel ingest tuning
+#define DEFAULT_INGEST_WRITERS 4
+#define MAX_INGEST_WRITERS 64
+#define INGEST_QUEUE_CAPACITY 64 // Work items per writer queue (power of two)
+#define ENTITY_PAGE_SIZE 4096
+#define ENTITY_MAX_PAGES 65536
+
+// Independent connections for worker threads
+typedef struct {
+    MYSQL **connections;
+    int size;
+} ConnectionPool;
+
+// Where every connection goes; set from ECCS_DB_* variables and command-line flags
+typedef struct {
+    const char *host;
+    const char *user;
+    const char *password;
+    const char *database;
+    unsigned int port;  // 0 for the default port
+    const char *socket; // NULL for the default socket
+} DatabaseSettings;
+
+DatabaseSettings dbSettings = {"localhost", "root", "password", "exam_db", 0, NULL};
+
+#define ASYNC_CONNECTIONS 4   // Connections multiplexed by the async executor
+#define ASYNC_QUEUE_LIMIT 256 // Statements queued per connection before submit waits
+
+// Statement queued on an async connection; the head of the queue is the one in flight
+typedef struct AsyncStatement {
+    struct AsyncStatement *next;
+    QueryKind kind;
+    unsigned long length;
+    char sql[];
+} AsyncStatement;
+
+typedef struct {
+    MYSQL *connection;
+    AsyncStatement *head;
+    AsyncStatement *tail;
+    int queued;
+    int busy;          // head has been started and not yet completed
+    int waitStatus;    // MYSQL_WAIT_* flags the client library is waiting on
+    uint32_t watched;  // epoll events currently registered for the socket
+    double started;
+    double deadline;   // When MYSQL_WAIT_TIMEOUT fires, if requested
+} AsyncConnection;
+
+// Keeps statements in flight on several connections at once; statements on one lane run in order
+typedef struct {
+    AsyncConnection *connections;
+    int count;
+    int epollFd;
+    long pending;
+    long completed;
+    long failed;
+    uint64_t affectedRows;
+    char error[256]; // First statement error
+} AsyncExecutor;
+
+// Bounded lock-free ring with one producer and one consumer
+typedef struct {
+    void **items;
+    size_t capacity; // Power of two
+    _Atomic size_t head;
+    _Atomic size_t tail;
+} SpscQueue;
+
+// Ids of entities inserted by writers, indexed by slot; pages never move once allocated
+typedef struct {
+    int *pages[ENTITY_MAX_PAGES];
+    int count;
+} EntityIdTable;
+
+typedef enum {
+    INGEST_ITEM_STUDENTS,
+    INGEST_ITEM_SUBJECTS,
+    INGEST_ITEM_ENROLLMENTS
+} IngestItemKind;
+
+// One unit of work handed from the parser to a writer
+typedef struct {
+    IngestItemKind kind;
+    int count;
+    int capacity;
+    StagedEnrollment *rows; // New students or subjects
+    int *slots;             // EntityIdTable slot for each row
+    int *pairs;             // Enrollments: student_id, subject_id pairs
+    StringPool strings;
+} IngestWorkItem;
+
+struct IngestPipeline;
+
+typedef struct {
+    int index;
+    MYSQL *connection;
+    SpscQueue queue;
+    struct IngestPipeline *pipeline;
+    pthread_t thread;
+    _Atomic long rowsWritten;
+    _Atomic long itemsProcessed;
+    _Atomic long busyMicroseconds;
+    size_t maxDepth; // Sampled by the monitoring thread
+} IngestWriter;
+
+typedef struct IngestPipeline {
+    const char *filename;
+    int writerCount;
+    int batchSize;
+    IngestWriter *writers;
+    IngestDictionary dict;     // Owned by the parser thread
+    EntityIdTable *studentIds;
+    EntityIdTable *subjectIds;
+    _Atomic long itemsPushed;
+    _Atomic long itemsDone;
+    _Atomic int parserDone;
+    _Atomic int failed;
+    long csvRows;
+    long insertedRows;
+} IngestPipeline;
+
+// Delta ingest manifest (<csv>.manifest, native byte order). Rows are hashed into
+// DELTA_BUCKET_COUNT chunks by the top bits of their identity hash, so a chunk's
+// contents do not depend on where its rows sit in the file.
+#define DELTA_MANIFEST_MAGIC "ECCSMAN1"
+#define DELTA_MANIFEST_VERSION 2
+#define DELTA_BUCKET_BITS 12
+#define DELTA_BUCKET_COUNT (1 << DELTA_BUCKET_BITS)
+#define DELTA_BUCKET(identity) ((int)((identity) >> (64 - DELTA_BUCKET_BITS)))
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t bucketCount;
+    uint64_t rowCount;
+    uint64_t stringBytes;
+    uint64_t databaseRows; // student_subjects rows after the ingest that wrote this manifest
+} ManifestHeader;
+
+typedef struct {
+    uint64_t chunkHash;
+    uint64_t firstRow;   // Rows are stored sorted by identity, so each chunk is a contiguous range
+    uint64_t rowCount;
+} ManifestBucket;
+
+typedef struct {
+    uint64_t identity;     // Hash of (symbol_number, subject)
+    uint64_t content;      // Hash of (name, college_name)
+    uint64_t stringOffset; // "symbol_number\0subject\0" in the string table
+} ManifestRow;
+
+typedef struct {
+    ManifestBucket *buckets; // NULL when there is no previous manifest
+    ManifestRow *rows;
+    char *strings;
+    uint64_t rowCount;
+    uint64_t stringBytes;
+    uint64_t databaseRows;
+} Manifest;
+
+// One student-subject row of the current file, located by offsets instead of copies
+typedef struct {
+    uint64_t identity;
+    uint64_t content;
+    uint64_t recordOffset;
+    uint32_t subjectOffset; // Relative to recordOffset
+    uint32_t subjectLength;
+} DeltaRow;
+
+// Seat matrix export: rows are streamed from the server and the text is gathered in one buffer
+#define EXPORT_BUFFER_SIZE (1024 * 1024) // Bytes of output collected before each fwrite
+
+typedef struct {
+    FILE *file;
+    char *data;
+    size_t length;
+    size_t capacity;
+    int failed; // A write failed; later output is dropped
+} SeatMatrixWriter;
+
+// Where a seat matrix being written is: the open day, room and bench sections, -1 before the first
+typedef struct {
+    int day;
+    int room_number;
+    int bench_number;
+    long seats;
+} SeatMatrixCursor;
+
+// id -> name for students (symbol numbers) or subjects, to export without joining on the server
+typedef struct {
+    IntMap ids; // id -> index into names
+    const char **names;
+    int count;
+    int capacity;
+    StringPool pool;
+} NameDictionary;
+
+// Storage behind the allocation engine: students, subjects, rooms, enrollments and seat allocations.
+// A session is what one thread works through: its own connection for MySQL, the shared tables for the
+// in-memory backend. Operations return EXIT_SUCCESS or EXIT_FAILURE and report their own errors.
+typedef struct StorageBackend {
+    const char *name;
+    void *state; // Backend data: the tables of the in-memory backend, nothing for MySQL
+    void *(*openSession)(struct StorageBackend *storage); // NULL on failure
+    void (*closeSession)(struct StorageBackend *storage, void *session);
+    int (*loadRooms)(void *session, AllocationEngine *engine); // Ordered by room id
+    int (*countDays)(void *session, int maxDays, int *dayCount);
+    int (*loadDayEnrollments)(void *session, AllocationDay *day); // Sittings of the day without a seat
+    int (*loadExistingSeats)(void *session, const AllocationEngine *engine, AllocationDay *day);
+    int (*countSeats)(void *session, int afterDay, long *count); // Saved seats on days after afterDay
+    int (*saveSeats)(void *session, const AllocationEngine *engine, long *writtenRows, long *deletedRows);
+    int (*loadNames)(void *session, NameDictionary *students, NameDictionary *subjects);
+} StorageBackend;
+
+typedef struct {
+    int student_id;
+    int subject_id;
+    int subject_index; // Exam day
+} MemoryEnrollment;
+
+typedef struct {
+    int student_id;
+    int subject_id;
+    int room_id;
+    int bench_number;
+    int seat_number;
+    int day;
+} MemorySeat;
+
+// Tables of the in-memory backend. Allocation workers only read them; seats are saved by one thread.
+typedef struct {
+    NameDictionary students; // id -> symbol_number
+    NameDictionary subjects; // id -> subject_name
+    IdDictionary studentIds; // symbol_number -> id
+    IdDictionary subjectIds; // subject_name -> id
+    PairSet enrolled; // (student, subject) pairs in enrollments
+    IntMap subjectCounts; // student id -> subjects enrolled, which numbers the next subject_index
+    int lastStudentId;
+    int lastSubjectId;
+    MemoryEnrollment *enrollments;
+    size_t enrollmentCount;
+    size_t enrollmentCapacity;
+    Room *rooms; // Only the columns of the rooms table are set
+    size_t roomCount;
+    size_t roomCapacity;
+    MemorySeat *seats;
+    size_t seatCount;
+    size_t seatCapacity;
+} MemoryStorage;
+
+// Binary seat plan for lookups without a database. Layout: header, fixed-width records in seat matrix
+// order (day, room number, bench, seat), subject names, then record numbers sorted by symbol number.
+// Every offset is from the start of the file; integers are in the byte order of the machine that wrote it.
+#define SEAT_PLAN_FILE "seat_plan.bin"
+#define SEAT_PLAN_MAGIC "ECCSPLAN"
+#define SEAT_PLAN_VERSION 1
+#define SEAT_PLAN_BYTE_ORDER 0x01020304u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder; // SEAT_PLAN_BYTE_ORDER as written; reads differently on the other endianness
+    uint32_t recordSize; // sizeof(SeatPlanRecord) + symbolWidth
+    uint32_t symbolWidth; // NUL-padded symbol_number bytes per record, a multiple of 8
+    uint32_t subjectWidth; // NUL-padded bytes per subject name, a multiple of 8
+    uint32_t recordCount;
+    uint32_t subjectCount;
+    uint32_t reserved;
+    uint64_t recordsOffset;
+    uint64_t subjectsOffset;
+    uint64_t indexOffset; // recordCount uint32_t record numbers ordered by symbol number, then seat
+    uint64_t checksum; // FNV-1a (hashKey) of every byte after the header
+} SeatPlanHeader;
+
+typedef struct {
+    int32_t day;
+    int32_t room_number;
+    int32_t bench_number;
+    int32_t seat_number;
+    uint32_t subject; // Index into the subject names
+    char symbol_number[]; // symbolWidth bytes
+} SeatPlanRecord;
+
+// Seats collected in seat matrix order until the plan is written
+typedef struct {
+    int day;
+    int room_number;
+    int bench_number;
+    int seat_number;
+    int subject;
+    const char *symbol;
+    size_t symbolLength;
+} SeatPlanEntry;
+
+typedef struct {
+    SeatPlanEntry *entries;
+    size_t count;
+    size_t capacity;
+    StringPool symbols;
+    IdDictionary subjects; // Subject name -> index into subjectNames
+    const char **subjectNames;
+    int subjectCount;
+    int subjectCapacity;
+    size_t longestSymbol;
+    size_t longestSubject;
+} SeatPlanBuilder;
+
+// A seat plan file opened for lookups: mapped where mmap exists, read into memory elsewhere
+typedef struct {
+    const char *data;
+    size_t size;
+    int mapped;
+    const SeatPlanHeader *header;
+} SeatPlan;
+
+// Seat lookup service: saved seats in a hash index on (symbol_number, day), answered over HTTP
+#define SEAT_SERVICE_PORT 8080
+#define SEAT_SERVICE_EVENTS 64
+#define SEAT_SERVICE_REQUEST_BYTES 2048  // Longest request head a client may send
+#define SEAT_SERVICE_RESPONSE_BYTES 8192
+#define SEAT_LOOKUP_MAX_SEATS 64         // Seats returned for one student
+
+// Never changed once built: a reload builds a new index beside the live one and the event loop swaps it in
+typedef struct {
+    SeatPlanBuilder seats; // Entries in seat matrix order, their symbols and the subject names
+    int32_t *buckets;      // First entry of each chain, -1 when empty
+    int32_t *next;         // Next entry with the same bucket, in seat matrix order
+    size_t mask;
+    int maxDay;
+    long generation;
+} SeatIndex;
+
+typedef struct ServiceClient {
+    struct ServiceClient *previous, *next; // Open connections, so close can drop the ones still open
+    int fd;
+    char request[SEAT_SERVICE_REQUEST_BYTES];
+    size_t received;
+    char response[SEAT_SERVICE_RESPONSE_BYTES];
+    size_t responseLength;
+    size_t sent;
+    int closeAfterResponse;
+    int waitingToWrite; // Watching for EPOLLOUT instead of EPOLLIN
+} ServiceClient;
+
+typedef struct {
+    SeatIndex *index;             // Read by the event loop thread only
+    _Atomic(SeatIndex *) pending; // Published by a reload, swapped in between requests
+    int listenFd;
+    int epollFd;
+    int wakeFds[2];               // Reload completions, reload and stop requests wake the loop
+    int port;
+    const char *unixPath;
+    ServiceClient *clients;
+    _Atomic int stop;
+    _Atomic int reloading;
+    long generation;
+    long requests;
+} SeatService;
+
+// One keep-alive connection of the lookup load generator
+typedef struct {
+    pthread_t thread;
+    int port;
+    const char **symbols;
+    const int *days;
+    int symbolCount;
+    int first;       // Offset into symbols so the clients do not march in step
+    long requests;
+    long found;
+    long missing;
+    long failed;
+    Histogram *latency;
+    SeatService *service;
+    int reloadAfter; // Request a reload after this many requests, 0 for none
+} LookupClient;
+
+// Sharded export: one sheet per day and room, written by a pool of workers
+#define SHEET_DIRECTORY "seat_sheets"
+#define SHEET_INDEX_FILE "index.csv"
+#define SHEET_FILE_FORMAT "day%d_room%d.txt" // Day, room number
+#define SHEET_BUFFER_SIZE (64 * 1024)
+#define DEFAULT_EXPORT_WORKERS 4
+
+typedef struct {
+    int day;
+    int room_number;
+    long seats;
+    int status;
+} SeatSheet;
+
+// Export worker: takes sheets off a shared counter and writes each from its own connection
+typedef struct {
+    SeatSheet *sheets;
+    int sheetCount;
+    const char *directory;
+    MYSQL *connection;
+    _Atomic int *nextSheet;
+    _Atomic int *failed;
+    pthread_t thread;
+} ExportWorker;
+
+// End-to-end benchmark: synthetic exam shape and per-phase results
+#define SYNTHETIC_CSV_FILE "synthetic_students.csv"
+#define SYNTHETIC_EXPORT_FILE "synthetic_seat_allocation.csv"
+#define BENCHMARK_RESULTS_FILE "benchmark_results.json"
+#define BENCHMARK_BASELINE_FILE "benchmark_baseline.json"
+#define BENCHMARK_REGRESSION_TOLERANCE 0.10 // Slower than baseline by more than this fraction
+#define BENCHMARK_NOISE_SECONDS 0.01 // ...and by more than this, so timer noise on tiny phases is ignored
+#define BENCHMARK_EXAM_DAYS 4
+#define BENCHMARK_ID_LOOKUPS 20000 // Students looked up by symbol number per protocol
+#define BENCHMARK_LOOKUP_CLIENTS 8
+#define BENCHMARK_LOOKUP_REQUESTS 200000 // HTTP lookups spread over the clients
+#define BENCHMARK_LOOKUP_MISS_EVERY 16   // One lookup in this many asks for an unknown student
+
+typedef struct {
+    long students;
+    int subjectsPerStudent;
+    int subjects;
+    int colleges;
+    int rooms;
+    int twoSeaters;
+    int threeSeaters;
+    unsigned int seed;
+} SyntheticConfig;
+
+typedef struct {
+    const char *name;
+    double seconds;
+    long items; // Rows generated or ingested, seats allocated or exported
+    long peakRssKb; // Peak for the process up to the end of the phase
+} BenchmarkPhase;
+
+// Command-line options of the batch commands
+typedef struct {
+    const char *command;
+    const char *input;       // ingest: CSV file
+    const char *mode;        // ingest: row, bulk, parallel or delta
+    int batchSize;
+    int workers;             // ingest writers, export sheet workers
+    int maxDays;
+    const PlacementStrategy *strategy;
+    int incremental;
+    const char *exportFile;  // allocate: also export from the run
+    const char *format;      // export: matrix, sheets or plan
+    const char *output;
+    int confirmed;           // reset: --yes was given
+    int port;                // serve: TCP port on 127.0.0.1
+    const char *unixPath;    // serve: Unix socket instead of TCP
+} BatchOptions;
+
 // ==== Function prototypes ====
 // Database-related functions
 int connectDatabase();
-void createDefaultAdminUser();  // Prototype added here
+void disconnectDatabase();
+void createDefaultAdminUser();
+int bootstrapSchema();
+int checkQueryPlan(const HotQuery *hot);
+void checkQueryPlans();
 int parseAndInsertCSV(const char *filename);
-
+int bulkInsertCSV(const char *filename, int batchSize);
+int flushBulkBatch(MYSQL *connection, IngestDictionary *dict, const StagedEnrollment *rows, int count,
+                   long *insertedRows);
+int selectKeyIds(MYSQL *connection, KeyIdTable *table, int useSubject);
+int insertStudentKeys(MYSQL *connection, KeyIdTable *students);
+int insertSubjectKeys(MYSQL *connection, KeyIdTable *subjects);
+int insertEnrollmentPairs(MYSQL *connection, const int *pairs, int count);
+void ingestMenu(const char *filename);
+
+// Parallel ingest functions
+MYSQL *openDatabaseConnection();
+int connectDatabaseHandle(MYSQL *connection);
+int asyncExecutorOpen(AsyncExecutor *executor, int count);
+int asyncExecutorSubmit(AsyncExecutor *executor, int lane, const char *sql, unsigned long length, QueryKind kind);
+int asyncExecutorPoll(AsyncExecutor *executor);
+int asyncExecutorDrain(AsyncExecutor *executor);
+void asyncExecutorClose(AsyncExecutor *executor);
+void asyncExecutorComplete(AsyncExecutor *executor, AsyncConnection *slot, int status);
+int asyncConnectionStart(AsyncExecutor *executor, AsyncConnection *slot);
+int asyncConnectionResume(AsyncExecutor *executor, AsyncConnection *slot, int ready);
+int asyncConnectionWatch(AsyncExecutor *executor, AsyncConnection *slot);
+int connectionPoolOpen(ConnectionPool *pool, int size);
+void connectionPoolClose(ConnectionPool *pool);
+void sleepMicroseconds(long microseconds);
+int spscQueueInit(SpscQueue *queue, size_t capacity);
+void spscQueueFree(SpscQueue *queue);
+int spscQueuePush(SpscQueue *queue, void *item);
+void *spscQueuePop(SpscQueue *queue);
+size_t spscQueueDepth(SpscQueue *queue);
+int entityIdTableAdd(EntityIdTable *table);
+int *entityIdTableSlot(EntityIdTable *table, int slot);
+void entityIdTableFree(EntityIdTable *table);
+IngestWorkItem *ingestWorkItemCreate(IngestItemKind kind, int capacity);
+void ingestWorkItemFree(IngestWorkItem *item);
+int ingestPipelinePush(IngestPipeline *pipeline, int writer, IngestWorkItem *item);
+int ingestWriterProcess(IngestWriter *writer, IngestWorkItem *item);
+void *ingestWriterThread(void *arg);
+int ingestStageEntity(IngestPipeline *pipeline, IngestWorkItem **pending, IngestItemKind kind,
+                      const StagedEnrollment *row, int slot);
+int ingestFlushPending(IngestPipeline *pipeline, IngestWorkItem **pending);
+int ingestResolveRef(IngestPipeline *pipeline, IdDictionary *dict, EntityIdTable *ids,
+                     IngestWorkItem **pending, IngestItemKind kind, const StagedEnrollment *row);
+int ingestRefToId(EntityIdTable *ids, int ref);
+void *ingestParserThread(void *arg);
+int parallelInsertCSV(const char *filename, int writerCount, int batchSize);
+
+// Delta ingest functions
+uint64_t hashField(uint64_t hash, const CsvField *field);
+uint64_t mixHash(uint64_t hash);
+int compareDeltaRows(const void *a, const void *b);
+int compareDeltaRowsByPosition(const void *a, const void *b);
+void computeBucketHashes(const DeltaRow *rows, size_t count, ManifestBucket *buckets);
+int scanDeltaRows(CsvReader *reader, DeltaRow **rowsOut, size_t *countOut);
+int materializeDeltaRow(CsvReader *reader, const DeltaRow *row, StringPool *pool, StagedEnrollment *out);
+int loadManifest(const char *path, Manifest *manifest);
+void freeManifest(Manifest *manifest);
+int writeManifest(const char *path, CsvReader *reader, const DeltaRow *rows, size_t count,
+                  const ManifestBucket *buckets, uint64_t databaseRows);
+int storeEnrollmentPairsResult(MYSQL_RES *result, void *context);
+int applyDelta(MYSQL *connection, StagedEnrollment *added, int addedCount,
+               StagedEnrollment *removed, int removedCount,
+               StagedEnrollment *updated, int updatedCount, long *insertedRows, long *deletedRows);
+int deltaInsertCSV(const char *filename);
+
+// ID dictionary functions
+uint64_t hashKey(const char *key, size_t length);
+int idDictionaryInit(IdDictionary *dict, size_t capacity);
+void idDictionaryFree(IdDictionary *dict);
+IdDictionaryEntry *idDictionaryProbe(const IdDictionary *dict, const char *key, size_t length, uint64_t hash);
+int idDictionaryFind(const IdDictionary *dict, const char *key, size_t length);
+int idDictionaryPut(IdDictionary *dict, const char *key, size_t length, int id);
+int pairSetInit(PairSet *set, size_t capacity);
+void pairSetFree(PairSet *set);
+size_t pairSetSlot(const PairSet *set, uint64_t key);
+int pairSetContains(const PairSet *set, int student_id, int subject_id);
+int pairSetInsert(PairSet *set, int student_id, int subject_id);
+int intMapInit(IntMap *map, size_t capacity);
+void intMapFree(IntMap *map);
+size_t intMapSlot(const IntMap *map, int key);
+int intMapFind(const IntMap *map, int key);
+int intMapPut(IntMap *map, int key, int value);
+int loadIngestDictionary(MYSQL *connection, IngestDictionary *dict);
+void freeIngestDictionary(IngestDictionary *dict);
+
+
+// CSV reader functions
+int csvReaderOpen(CsvReader *reader, const char *filename);
+void csvReaderClose(CsvReader *reader);
+int csvReaderNextRecord(CsvReader *reader, CsvField *fields, int maxFields);
+int csvNextSubfield(const CsvField *field, char separator, size_t *offset, CsvField *out);
+size_t csvFieldCopy(const CsvField *field, char *dest, size_t size);
+int csvRecordFits(const CsvField *fields);
+const char *csvFindAny(const char *p, const char *end, char a, char b, char c);
+const char *csvNextStructural(CsvReader *reader, size_t offset);
+uint64_t csvClassifyBlock(const char *block, char a, char b, char c);
+uint64_t csvClassifyBlockScalar(const char *block, char a, char b, char c);
+int csvCountTrailingZeros(uint64_t mask);
 
 // Room management functions
 void configureRooms();
-void resetTables();
+int resetTables();
 
 // Seat allocation functions
-void unifiedSeatAllocation(int maxDays);
-void allocateSeatsForDay(int day);
-void allocateSeatsForResult(MYSQL_RES *result, int day);
-int isAdjacentSeatConflict(int room_id, int bench, int seat, int total_benches, int seats_per_bench, int subject_id, int **seatMatrix);
-void allocateSeat(int student_id, int subject_id, Room *room, int bench, int seat, int day);
+void allocationMenu(int maxDays);
+int unifiedSeatAllocation(StorageBackend *storage, void *session, int maxDays, const PlacementStrategy *strategy,
+                          int incremental, const char *exportFile);
+int benchSeatCount(const Room *room, int bench);
+int benchSeatOffset(const Room *room, int bench);
+int seatArenaInit(SeatArena *arena, size_t size);
+void *seatArenaAlloc(SeatArena *arena, size_t bytes);
+void seatArenaFree(SeatArena *arena);
+int seatWorkspaceInit(SeatWorkspace *workspace, const Room *rooms, int roomCount, int subjectCapacity);
+void seatWorkspaceClear(SeatWorkspace *workspace);
+void seatWorkspaceFree(SeatWorkspace *workspace);
+int mysqlStorageLoadRooms(void *session, AllocationEngine *engine);
+int mapDaySubjects(AllocationDay *day);
+int compareSeatAssignments(const void *a, const void *b);
+int mysqlStorageCountDays(void *session, int maxDays, int *dayCount);
+int mysqlStorageLoadDayEnrollments(void *session, AllocationDay *day);
+int mysqlStorageLoadExistingSeats(void *session, const AllocationEngine *engine, AllocationDay *day);
+int reserveDisplacedSeats(AllocationDay *day);
+void seatExistingSeats(SeatWorkspace *workspace, AllocationDay *day);
+int allocationEngineInit(AllocationEngine *engine, StorageBackend *storage, void *session, int maxDays);
+void allocationEngineFree(AllocationEngine *engine);
+void bitsetSetRange(uint64_t *words, int from, int to);
+void placeSeat(Room *room, int bench, int seat, int subject_id, int subjectSlot);
+uint64_t seatWordMask(const Room *room, int word);
+void advanceFirstFreeWord(Room *room);
+int findFreeSeat(const Room *room, int subjectSlot, int startWord, int *wordOut, int *benchOut, int *seatOut);
+int placeFirstFit(SeatWorkspace *workspace, AllocationDay *day);
+int interleaveLane(int bench, int seat);
+int pickInterleaveSubject(const Room *room, int seatIndex, const int *remaining, int subjectCount,
+                          const int *lanes, int lane);
+int placeInterleaved(SeatWorkspace *workspace, AllocationDay *day);
+int allocateDay(SeatWorkspace *workspace, const Room *rooms, int roomCount, const PlacementStrategy *strategy,
+                AllocationDay *day);
+int loadAllocationDay(AllocationEngine *engine, void *session, AllocationDay *day);
+void *dayPrefetchThread(void *arg);
+int runAllocationWorker(AllocationEngine *engine, void *session, void *prefetchSession,
+                        _Atomic int *nextDay, _Atomic int *failed);
+void *allocationWorkerThread(void *arg);
+int allocationEngineRun(AllocationEngine *engine, int workerCount);
+int allocationEngineFlush(AllocationEngine *engine, long *writtenRows, long *deletedRows);
+int mysqlStorageSaveSeats(void *session, const AllocationEngine *engine, long *writtenRows, long *deletedRows);
+void *mysqlStorageOpenSession(StorageBackend *storage);
+void mysqlStorageCloseSession(StorageBackend *storage, void *session);
+int mysqlStorageCountSeats(void *session, int afterDay, long *count);
+int mysqlStorageLoadNames(void *session, NameDictionary *students, NameDictionary *subjects);
+int loadNameDictionaries(MYSQL *connection, NameDictionary *students, NameDictionary *subjects);
+
+// In-memory storage functions
+int growArray(void **items, size_t *capacity, size_t needed, size_t itemSize);
+int memoryStorageInit(MemoryStorage *store);
+void memoryStorageFree(MemoryStorage *store);
+StorageBackend memoryStorageBackend(MemoryStorage *store);
+int memoryStorageIntern(IdDictionary *ids, NameDictionary *names, int *lastId, const char *key, size_t length,
+                        int id);
+int memoryStorageEnroll(MemoryStorage *store, int student_id, int subject_id, int subject_index);
+int memoryStorageAddRoom(MemoryStorage *store, int room_id, int room_number, int twoSeaters, int threeSeaters);
+int memoryStorageIngestCSV(MemoryStorage *store, const char *filename, long *rowsOut);
+int memoryStorageLoadRoomsCSV(MemoryStorage *store, const char *filename);
+int memoryStorageCopyDatabase(MemoryStorage *store, MYSQL *connection);
+void *memoryStorageOpenSession(StorageBackend *storage);
+void memoryStorageCloseSession(StorageBackend *storage, void *session);
+int memoryStorageLoadRooms(void *session, AllocationEngine *engine);
+int memoryStorageCountDays(void *session, int maxDays, int *dayCount);
+int memoryStorageLoadDayEnrollments(void *session, AllocationDay *day);
+int memoryStorageLoadExistingSeats(void *session, const AllocationEngine *engine, AllocationDay *day);
+int memoryStorageCountSeats(void *session, int afterDay, long *count);
+int memoryStorageSaveSeats(void *session, const AllocationEngine *engine, long *writtenRows, long *deletedRows);
+int memoryStorageLoadNames(void *session, NameDictionary *students, NameDictionary *subjects);
+int offlineCommand(int argc, char *argv[]);
+void printUsage(const char *program);
+int loadDatabaseSettings();
+int parseCount(const char *text, int *value);
+int parseBatchOptions(int argc, char *argv[], BatchOptions *options);
+int batchCommand(int argc, char *argv[]);
+int serveCommand(const BatchOptions *options);
+void compareFillRates(AllocationEngine *engine);
+int isAdjacentSeatConflict(const Room *room, int bench, int seat, int subject_id);
 
 // User management functions
 void getPassword(char *password, size_t size);
+#ifndef _WIN32
+int getch();
+#endif
 int registerUser();
 int login(char *username, int *role);
 
@@ -55,19 +1079,196 @@ void clearScreenWithMessage(const char *message);
 // Input validation function
 int getValidatedChoice(const char *prompt);
 
+// Utility functions
+double getCurrentTimeSeconds();
+int sqlBufferReserve(SqlBuffer *buffer, size_t extra);
+int sqlBufferAppend(SqlBuffer *buffer, const char *text);
+int sqlBufferAppendEscaped(SqlBuffer *buffer, MYSQL *connection, const char *text);
+void sqlBufferFree(SqlBuffer *buffer);
+int sqlBatchBeginRow(SqlBatch *batch);
+int sqlBatchEndRow(SqlBatch *batch);
+int sqlBatchFlush(SqlBatch *batch);
+void statementCacheInit(StatementCache *cache, MYSQL *connection);
+void statementCacheClose(StatementCache *cache);
+MYSQL_STMT *prepareStatement(MYSQL *connection, const char *sql);
+MYSQL_STMT *statementCacheGet(StatementCache *cache, const char *sql);
+void bindInt(MYSQL_BIND *bind, int *value);
+void bindText(MYSQL_BIND *bind, const char *text, unsigned long *length);
+int appendPlaceholderRows(SqlBuffer *buffer, const char *prefix, const char *suffix, int rows, int columns);
+int statementBatchInit(StatementBatch *batch, StatementCache *cache, const char *prefix, const char *suffix,
+                       int columns, QueryKind kind);
+int statementBatchAdd(StatementBatch *batch, const int *row);
+int statementBatchFlush(StatementBatch *batch);
+void statementBatchFree(StatementBatch *batch);
+char *stringPoolAlloc(StringPool *pool, size_t size);
+const char *stringPoolCopy(StringPool *pool, const char *text);
+const char *stringPoolCopyField(StringPool *pool, const CsvField *field);
+void stringPoolFree(StringPool *pool);
+int compareKeyIdEntries(const void *a, const void *b);
+int buildKeyIdTable(KeyIdTable *table, const StagedEnrollment *rows, int count, int useSubject,
+                    const IdDictionary *known);
+KeyIdEntry *findKeyIdEntry(KeyIdTable *table, const char *key);
+int storeKeyIdResult(MYSQL_RES *result, void *context);
+
+// Instrumentation functions
+void metricsInit();
+void metricsDump();
+int histogramBucket(uint64_t value);
+uint64_t histogramBucketLimit(int bucket);
+void histogramRecord(Histogram *histogram, uint64_t value);
+uint64_t histogramPercentile(const Histogram *histogram, double percentile);
+void metricsRecordPhase(MetricsPhase phase, double seconds);
+int dbRealQuery(MYSQL *connection, const char *query, unsigned long length, QueryKind kind);
+void metricsRecordQuery(MYSQL *connection, QueryKind kind, double start, unsigned long length, int status);
+int dbQuery(MYSQL *connection, const char *query, QueryKind kind);
+MYSQL_ROW dbFetchRow(MYSQL_RES *result, QueryKind kind);
+int dbCommit(MYSQL *connection, QueryKind kind);
+int dbStatementExecute(MYSQL_STMT *statement, QueryKind kind);
+int dbStatementFetch(MYSQL_STMT *statement, QueryKind kind);
+void writeHistogramJson(FILE *file, const Histogram *histogram);
+void writeHistogramPrometheus(FILE *file, const char *name, const char *labels, const Histogram *histogram,
+                              double scale);
+
 // Export-related functions
-void exportAllocatedSeatsMatrix(const char *filename);
+int seatMatrixWriterOpen(SeatMatrixWriter *writer, const char *filename, size_t capacity);
+int seatMatrixWriterOpenMode(SeatMatrixWriter *writer, const char *filename, const char *mode, size_t capacity);
+void seatMatrixWriterFlush(SeatMatrixWriter *writer);
+void seatMatrixWriterAppend(SeatMatrixWriter *writer, const char *text, size_t length);
+void seatMatrixWriterText(SeatMatrixWriter *writer, const char *text);
+void seatMatrixWriterInt(SeatMatrixWriter *writer, long value);
+int seatMatrixWriterClose(SeatMatrixWriter *writer);
+void seatMatrixWriterSeat(SeatMatrixWriter *writer, const char *symbol, size_t symbolLength, const char *subject,
+                          size_t subjectLength);
+void seatMatrixWriteSeat(SeatMatrixWriter *writer, SeatMatrixCursor *cursor, int day, int room_number,
+                         int bench_number, const char *symbol, size_t symbolLength, const char *subject,
+                         size_t subjectLength);
+void seatMatrixFinish(SeatMatrixWriter *writer, const SeatMatrixCursor *cursor);
+int nameDictionaryInit(NameDictionary *dict);
+int nameDictionaryAdd(NameDictionary *dict, int id, const char *name);
+int nameDictionaryCopy(NameDictionary *dict, const NameDictionary *source);
+int loadNameDictionary(MYSQL *connection, const char *query, NameDictionary *dict);
+const char *nameDictionaryFind(const NameDictionary *dict, int id);
+void freeNameDictionary(NameDictionary *dict);
+int compareRoomNumbers(const void *a, const void *b);
+int exportEngineSeatMatrix(const AllocationEngine *engine, const char *filename, SeatPlanBuilder *plan,
+                           long *seatsOut);
+int seatPlanBuilderInit(SeatPlanBuilder *builder);
+void seatPlanBuilderFree(SeatPlanBuilder *builder);
+int seatPlanBuilderAdd(SeatPlanBuilder *builder, int day, int room_number, int bench_number, int seat_number,
+                       const char *symbol, size_t symbolLength, const char *subject, size_t subjectLength);
+int compareSeatPlanEntries(const void *a, const void *b);
+uint64_t hashBytes(uint64_t hash, const void *data, size_t length);
+void seatPlanAppend(SeatMatrixWriter *writer, uint64_t *checksum, const void *data, size_t length);
+int seatPlanBuilderWrite(const SeatPlanBuilder *builder, const char *filename);
+int writeSeatPlanFromDatabase(MYSQL *connection, const char *filename, long *seatsOut);
+int exportSeatPlan(const char *filename);
+int seatPlanOpen(SeatPlan *plan, const char *filename);
+void seatPlanClose(SeatPlan *plan);
+int seatPlanCheckSections(const SeatPlan *plan);
+int seatPlanVerify(const SeatPlan *plan);
+const SeatPlanRecord *seatPlanRecord(const SeatPlan *plan, uint32_t index);
+const char *seatPlanSubject(const SeatPlan *plan, uint32_t subject);
+int seatPlanFind(const SeatPlan *plan, const char *symbol, uint32_t *first, uint32_t *last);
+int seatPlanCommand(int argc, char *argv[]);
+int seatPlanBuilderLoad(SeatPlanBuilder *builder, MYSQL *connection);
+uint64_t seatIndexKey(const char *symbol, int day);
+SeatIndex *seatIndexBuild(MYSQL *connection);
+void seatIndexFree(SeatIndex *index);
+int seatIndexFind(const SeatIndex *index, const char *symbol, int day, const SeatPlanEntry **seats, int maxSeats);
+int seatIndexProbe(const SeatIndex *index, const char *symbol, int day, const SeatPlanEntry **seats, int maxSeats,
+                   int found);
+int seatServiceOpen(SeatService *service, MYSQL *connection, int port, const char *unixPath);
+int seatServiceRun(SeatService *service);
+void *seatServiceThread(void *arg);
+void seatServiceStop(SeatService *service);
+void seatServiceClose(SeatService *service);
+void seatServiceRequestReload(SeatService *service);
+void *seatServiceReloadThread(void *arg);
+void seatServiceAccept(SeatService *service);
+void seatServiceRead(SeatService *service, ServiceClient *client);
+void seatServiceWrite(SeatService *service, ServiceClient *client);
+void seatServiceHandle(SeatService *service, ServiceClient *client, char *head);
+void seatServiceLookup(SeatService *service, ServiceClient *client, char *query);
+void seatServiceRespond(ServiceClient *client, int status, const char *body, size_t length);
+void seatServiceDropClient(SeatService *service, ServiceClient *client);
+void seatServiceSignal(int signal);
+int appendJsonString(char *out, size_t size, size_t *length, const char *text);
+size_t urlDecode(char *out, size_t size, const char *text, size_t length);
+size_t urlEncode(char *out, size_t size, const char *text);
+void exportMenu();
+int exportAllocatedSeatsMatrix(const char *filename);
+int makeDirectory(const char *path);
+void seatSheetPath(char *path, size_t size, const char *directory, int day, int room_number);
+int loadSeatSheets(MYSQL *connection, SeatSheet **sheetsOut, int *countOut);
+int writeSeatSheet(MYSQL *connection, const char *directory, SeatSheet *sheet);
+void *exportWorkerThread(void *arg);
+int writeSheetIndex(const char *directory, const SeatSheet *sheets, int count);
+int exportSeatSheets(const char *directory, int workerCount);
+void regenerateSeatSheet(const char *directory);
+
+// Benchmark functions
+void runBenchmarks();
+void benchmarkCSVParsers(const char *filename);
+int benchmarkFgetsStrtok(const char *filename, long *records, long *subjects, long *truncated);
+int benchmarkCsvReader(const char *filename, long *records, long *subjects);
+int buildSyntheticEngine(AllocationEngine *engine, int roomCount, int twoSeaters, int threeSeaters,
+                         int days, int sittingsPerDay, int subjects);
+void benchmarkSeatLayouts();
+void benchmarkPlacementStrategies();
+int generateSyntheticCSV(const char *filename, const SyntheticConfig *config, long *rows);
+int addSyntheticRooms(const SyntheticConfig *config);
+long queryCount(const char *query);
+long peakRssKilobytes();
+void formatBenchmarkConfig(char *text, size_t size, const SyntheticConfig *config, const char *ingestMode);
+int writeBenchmarkJson(const char *filename, const char *configText, const BenchmarkPhase *phases, int phaseCount);
+int loadBenchmarkJson(const char *filename, char *text, size_t size);
+int baselineSeconds(const char *text, const char *phaseName, double *seconds);
+int compareWithBaseline(const char *baselineFile, const char *configText, const BenchmarkPhase *phases,
+                        int phaseCount);
+void benchmarkEndToEnd();
+void benchmarkStorageBackends();
+void benchmarkPreparedStatements();
+void benchmarkSeatService();
+void *lookupClientThread(void *arg);
+int loadDayEnrollmentsText(MYSQL *connection, AllocationDay *day);
+int legacySeatConflict(int **seats, int twoSeaterCount, int totalBenches, int bench, int seat, int subject_id);
+long legacySeatDay(const Room *rooms, int roomCount, SeatAssignment *assignments, int count);
+int perfCounterOpen();
+void perfCounterStart(int fd);
+long long perfCounterStop(int fd);
 
 
 // Main function
-int main() {
+int main(int argc, char *argv[]) {
+    // Seat plan lookups need no database, so they run before anything connects
+    if (argc > 1 && (strcmp(argv[1], "lookup") == 0 || strcmp(argv[1], "verify") == 0)) {
+        return seatPlanCommand(argc, argv);
+    }
+
+    // Initialise the client library up front; worker threads open their own connections
+    if (mysql_library_init(0, NULL, NULL)) {
+        fprintf(stderr, "Could not initialize MySQL client library\n");
+        return EXIT_FAILURE;
+    }
+    metricsInit();
+    if (loadDatabaseSettings() == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "offline") == 0) {
+        return offlineCommand(argc, argv);
+    }
+    if (argc > 1) {
+        return batchCommand(argc, argv);
+    }
+
     if (connectDatabase() == EXIT_FAILURE) {
         return EXIT_FAILURE;
     }
 
     char username[50];
     int role;
-    int maxDays = 4; // Maximum number of exam days
+    int maxDays = DEFAULT_EXAM_DAYS;
 
     printTitle();
     printf("Enter username: ");
@@ -75,7 +1276,7 @@ int main() {
 
     if (login(username, &role) == EXIT_FAILURE) {
         printf("\nLogin failed. Exiting...\n");
-        mysql_close(conn);
+        disconnectDatabase();
         return EXIT_FAILURE;
     }
 
@@ -89,19 +1290,19 @@ int main() {
         if (role == 1) { // Admin menu
             switch (choice) {
                 case 1:
-                    parseAndInsertCSV("students.csv");
+                    ingestMenu("students.csv");
                     break;
                 case 2:
                 	configureRooms();
                     break;
                 case 3:
-                    unifiedSeatAllocation(maxDays);
+                    allocationMenu(maxDays);
                     break;
                 case 4:
                     resetTables();
                     break;
                 case 5:
-                    exportAllocatedSeatsMatrix("seat_allocation.csv");
+                    exportMenu();
                     break;
                 case 6:
                     if (registerUser() == EXIT_FAILURE) {
@@ -109,8 +1310,11 @@ int main() {
                     }
                     break;
                 case 7:
+                    runBenchmarks();
+                    break;
+                case 8:
                     printf("Exiting...\n");
-                    mysql_close(conn);
+                    disconnectDatabase();
                     return EXIT_SUCCESS;
                 default:
                     printf("Invalid choice. Try again.\n");
@@ -118,14 +1322,14 @@ int main() {
         } else { // Coordinator menu
             switch (choice) {
                 case 1:
-                    unifiedSeatAllocation(maxDays);
+                    allocationMenu(maxDays);
                     break;
                 case 2:
-                    exportAllocatedSeatsMatrix("seat_allocation.csv");
+                    exportMenu();
                     break;
                 case 3:
                     printf("\nExiting...\n");
-                    mysql_close(conn);
+                    disconnectDatabase();
                     return EXIT_SUCCESS;
                 default:
                     printf("Invalid choice. Try again.\n");
@@ -133,22 +1337,23 @@ int main() {
         }
     }
 
-    mysql_close(conn);
+    disconnectDatabase();
     return EXIT_SUCCESS;
 }
 
 int connectDatabase() {
-    conn = mysql_init(NULL);
+    conn = openDatabaseConnection();
     if (conn == NULL) {
-        fprintf(stderr, "mysql_init() failed\n");
         return EXIT_FAILURE;
     }
+    statementCacheInit(&mainStatements, conn);
 
-    if (mysql_real_connect(conn, "localhost", "root", "password", "exam_db", 0, NULL, 0) == NULL) {
-        fprintf(stderr, "mysql_real_connect() failed: %s\n", mysql_error(conn));
-        mysql_close(conn);
+    // Bring the schema up to date before anything queries it
+    if (bootstrapSchema() == EXIT_FAILURE) {
+        disconnectDatabase();
         return EXIT_FAILURE;
     }
+    checkQueryPlans();
     
     // Create the default admin user
     createDefaultAdminUser();
@@ -156,6 +1361,12 @@ int connectDatabase() {
     return EXIT_SUCCESS;
 }
 
+// Statements belong to the connection, so they are closed first
+void disconnectDatabase() {
+    statementCacheClose(&mainStatements);
+    mysql_close(conn);
+}
+
 void createDefaultAdminUser() {
     // SQL query to insert the default admin user into the users table
     // Username: 'admin', Password: 'admin' (hashed using MD5), Role: 1 (Admin)
@@ -165,7 +1376,7 @@ void createDefaultAdminUser() {
              "VALUES ('admin', MD5('admin'), 1)");
 
     // Execute the query
-    if (mysql_query(conn, query)) {
+    if (dbQuery(conn, query, QUERY_OTHER)) {
         // Log an error if the query execution fails
         fprintf(stderr, "Error creating default admin user: %s\n", mysql_error(conn));
     } else {
@@ -175,6 +1386,198 @@ void createDefaultAdminUser() {
 }
 
 
+// ==== Schema bootstrap ====
+
+// InnoDB for the transactions the saves roll back. No foreign keys; the ingest paths resolve every
+// id before they write a row that refers to it, and resetTables truncates in any order.
+const char *schemaTables[] = {
+    "CREATE TABLE IF NOT EXISTS users ("
+    "id INT AUTO_INCREMENT PRIMARY KEY, "
+    "username VARCHAR(50) NOT NULL, "
+    "password CHAR(32) NOT NULL, "
+    "role INT NOT NULL, "
+    "UNIQUE KEY uq_users_username (username)) ENGINE=InnoDB",
+
+    "CREATE TABLE IF NOT EXISTS students ("
+    "id INT AUTO_INCREMENT PRIMARY KEY, "
+    "symbol_number VARCHAR(255) NOT NULL, "
+    "name VARCHAR(255) NOT NULL DEFAULT '', "
+    "college_name VARCHAR(255) NOT NULL DEFAULT '', "
+    "UNIQUE KEY uq_students_symbol_number (symbol_number)) ENGINE=InnoDB",
+
+    "CREATE TABLE IF NOT EXISTS subjects ("
+    "id INT AUTO_INCREMENT PRIMARY KEY, "
+    "subject_name VARCHAR(255) NOT NULL, "
+    "UNIQUE KEY uq_subjects_subject_name (subject_name)) ENGINE=InnoDB",
+
+    // subject_index is the exam day, numbered by the trigger below
+    "CREATE TABLE IF NOT EXISTS student_subjects ("
+    "student_id INT NOT NULL, "
+    "subject_id INT NOT NULL, "
+    "subject_index INT NULL, "
+    "PRIMARY KEY (student_id, subject_id)) ENGINE=InnoDB",
+
+    "CREATE TABLE IF NOT EXISTS rooms ("
+    "id INT AUTO_INCREMENT PRIMARY KEY, "
+    "room_number INT NOT NULL, "
+    "two_seater_count INT NOT NULL DEFAULT 0, "
+    "three_seater_count INT NOT NULL DEFAULT 0, "
+    "UNIQUE KEY uq_rooms_room_number (room_number)) ENGINE=InnoDB",
+
+    "CREATE TABLE IF NOT EXISTS seat_allocation ("
+    "id INT AUTO_INCREMENT PRIMARY KEY, "
+    "student_id INT NOT NULL, "
+    "subject_id INT NOT NULL, "
+    "room_id INT NOT NULL, "
+    "bench_number INT NOT NULL, "
+    "seat_number INT NOT NULL, "
+    "day INT NOT NULL) ENGINE=InnoDB",
+};
+
+// Secondary indexes, added by name to tables that lack them
+const SchemaIndex schemaIndexes[] = {
+    {"student_subjects", "idx_student_subjects_day", "subject_index, student_id, subject_id",
+     "sittings of a day, and the number of days"},
+    {"seat_allocation", "idx_seat_allocation_sitting", "student_id, subject_id, day",
+     "the has-a-seat probe of the day load, and deletes of displaced seats"},
+    {"seat_allocation", "idx_seat_allocation_position",
+     "day, room_id, bench_number, seat_number, student_id, subject_id",
+     "saved seats of a day, seat sheets and exports, covering"},
+};
+
+// Numbers each new enrollment after the student's others unless the insert gives a day
+#define SCHEMA_DAY_TRIGGER "student_subjects_number_day"
+
+// Exports read every row anyway, so only the queries that should touch a slice are checked
+const HotQuery hotQueries[] = {
+    {"Day enrollments", dayEnrollmentsQuery, "1"},
+    {"Saved seats of a day", savedSeatsQuery, "1"},
+    {"Student id lookup", studentIdQuery, "''"},
+    {"Subject id lookup", subjectIdQuery, "''"},
+    {"Seats after a day", "SELECT COUNT(*) FROM seat_allocation WHERE day > ?", "1"},
+    {"Displaced seat delete", "DELETE FROM seat_allocation WHERE (student_id, subject_id, day) IN ((?, ?, ?))", "1"},
+    {"Seat sheet",
+     "SELECT a.bench_number, s.symbol_number, sub.subject_name "
+     "FROM seat_allocation a "
+     "JOIN rooms r ON a.room_id = r.id "
+     "JOIN students s ON a.student_id = s.id "
+     "JOIN subjects sub ON a.subject_id = sub.id "
+     "WHERE a.day = ? AND r.room_number = ? "
+     "ORDER BY a.bench_number, a.seat_number", "1"},
+};
+
+// Creates the tables that are missing and adds the indexes and trigger. Only a table that cannot be
+// created fails the bootstrap; a missing index or trigger is reported and the program carries on.
+int bootstrapSchema() {
+    char query[512];
+    size_t i;
+
+    for (i = 0; i < sizeof(schemaTables) / sizeof(schemaTables[0]); i++) {
+        if (dbQuery(conn, schemaTables[i], QUERY_OTHER)) {
+            fprintf(stderr, "Could not create table: %s\n", mysql_error(conn));
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (i = 0; i < sizeof(schemaIndexes) / sizeof(schemaIndexes[0]); i++) {
+        const SchemaIndex *index = &schemaIndexes[i];
+        snprintf(query, sizeof(query),
+                 "SELECT COUNT(*) FROM information_schema.STATISTICS "
+                 "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = '%s' AND INDEX_NAME = '%s'",
+                 index->table, index->name);
+        long found = queryCount(query);
+        if (found != 0) {
+            continue; // Present, or the check failed and was reported
+        }
+        snprintf(query, sizeof(query), "ALTER TABLE %s ADD INDEX %s (%s)", index->table, index->name,
+                 index->columns);
+        if (dbQuery(conn, query, QUERY_OTHER)) {
+            fprintf(stderr, "Could not add index %s for %s: %s\n", index->name, index->purpose,
+                    mysql_error(conn));
+        } else {
+            printf("Added index %s on %s.\n", index->name, index->table);
+        }
+    }
+
+    long found = queryCount("SELECT COUNT(*) FROM information_schema.TRIGGERS "
+                            "WHERE TRIGGER_SCHEMA = DATABASE() AND TRIGGER_NAME = '" SCHEMA_DAY_TRIGGER "'");
+    if (found == 0 &&
+        dbQuery(conn, "CREATE TRIGGER " SCHEMA_DAY_TRIGGER " BEFORE INSERT ON student_subjects "
+                            "FOR EACH ROW SET NEW.subject_index = COALESCE(NEW.subject_index, "
+                            "(SELECT COALESCE(MAX(subject_index), 0) + 1 FROM student_subjects "
+                            "WHERE student_id = NEW.student_id))", QUERY_OTHER)) {
+        fprintf(stderr, "Could not create trigger " SCHEMA_DAY_TRIGGER ": %s\n", mysql_error(conn));
+    }
+    return EXIT_SUCCESS;
+}
+
+// Runs EXPLAIN on one hot query and warns about every large table it would read in full.
+// Returns the number of such scans, or -1 if the plan could not be read.
+int checkQueryPlan(const HotQuery *hot) {
+    SqlBuffer explain = {0};
+    const char *p;
+    int scans = 0;
+
+    if (sqlBufferAppend(&explain, "EXPLAIN ") == EXIT_FAILURE) {
+        return -1;
+    }
+    for (p = hot->query; *p; p++) {
+        char text[2] = {*p, '\0'};
+        if (sqlBufferAppend(&explain, *p == '?' ? hot->sample : text) == EXIT_FAILURE) {
+            sqlBufferFree(&explain);
+            return -1;
+        }
+    }
+    int failed = dbRealQuery(conn, explain.data, explain.length, QUERY_OTHER);
+    sqlBufferFree(&explain);
+    MYSQL_RES *result = failed ? NULL : mysql_store_result(conn);
+    if (result == NULL) {
+        fprintf(stderr, "Could not EXPLAIN %s: %s\n", hot->name, mysql_error(conn));
+        return -1;
+    }
+
+    // Columns differ between MySQL and MariaDB, so they are found by name
+    MYSQL_FIELD *fields = mysql_fetch_fields(result);
+    int columns = mysql_num_fields(result);
+    int table = -1, type = -1, rows = -1, i;
+    for (i = 0; i < columns; i++) {
+        if (strcmp(fields[i].name, "table") == 0) table = i;
+        if (strcmp(fields[i].name, "type") == 0) type = i;
+        if (strcmp(fields[i].name, "rows") == 0) rows = i;
+    }
+
+    MYSQL_ROW row;
+    while ((row = dbFetchRow(result, QUERY_OTHER))) {
+        long estimate = rows >= 0 && row[rows] ? atol(row[rows]) : 0;
+        if (type >= 0 && row[type] && strcmp(row[type], "ALL") == 0 && estimate >= SCHEMA_SCAN_WARN_ROWS) {
+            fprintf(stderr, "Warning: %s reads all of %s (about %ld rows); check its indexes.\n", hot->name,
+                    table >= 0 && row[table] ? row[table] : "a table", estimate);
+            scans++;
+        }
+    }
+    mysql_free_result(result);
+    return scans;
+}
+
+// Startup self-check: a hot query that scans a whole table will only get slower as the exam grows
+void checkQueryPlans() {
+    size_t i;
+    int scans = 0, unchecked = 0;
+    for (i = 0; i < sizeof(hotQueries) / sizeof(hotQueries[0]); i++) {
+        int found = checkQueryPlan(&hotQueries[i]);
+        if (found < 0) {
+            unchecked++;
+        } else {
+            scans += found;
+        }
+    }
+    if (scans == 0 && unchecked == 0) {
+        printf("Query plans checked: %d hot queries use indexes.\n", (int)i);
+    } else {
+        printf("Query plans checked: %d full table scans, %d queries not checked.\n", scans, unchecked);
+    }
+}
+
 // Function to validate numeric input
 int getValidatedChoice(const char *prompt) {
     char input[50];
@@ -205,741 +1608,8503 @@ int getValidatedChoice(const char *prompt) {
     return number;
 }
 
-void clearScreenWithMessage(const char *message) {
-    // Display the message
-    printf("%s\n", message);
-
-    // Pause for 2 seconds
-    #ifdef _WIN32
-        Sleep(1000); // Sleep in milliseconds
-    #else
-        sleep(1);    // Sleep in seconds
-    #endif
-
-    // Clear the screen based on the operating system
+// Monotonic wall-clock time in seconds, used for throughput reporting
+double getCurrentTimeSeconds() {
     #ifdef _WIN32
-        system("cls");  // Windows
+        LARGE_INTEGER frequency, counter;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&counter);
+        return (double)counter.QuadPart / (double)frequency.QuadPart;
     #else
-        system("clear"); // Linux/macOS
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
     #endif
 }
 
-void printTitle() {
-    printf("\n================================================\n");
-    printf(" Welcome to the Exam Center Coordination System \n");
-    printf("================================================\n\n");
-	clearScreenWithMessage("Starting the system... Please wait!");
+const char *queryKindNames[QUERY_KIND_COUNT] = {
+    "other", "ingest_write", "id_lookup", "allocation_read", "allocation_write", "export"
+};
+const char *metricsPhaseNames[PHASE_COUNT] = {
+    "ingest", "allocation_load", "allocation_place", "allocation_save", "export"
+};
+
+void metricsInit() {
+    const char *format = getenv("ECCS_METRICS");
+    const char *path = getenv("ECCS_METRICS_FILE");
+    if (format == NULL || (strcmp(format, "json") != 0 && strcmp(format, "prometheus") != 0)) {
+        return;
+    }
+    metrics.prometheus = strcmp(format, "prometheus") == 0;
+    snprintf(metrics.path, sizeof(metrics.path), "%s",
+             path ? path : (metrics.prometheus ? "eccs_metrics.prom" : "eccs_metrics.json"));
+    metrics.enabled = 1;
+    atexit(metricsDump);
 }
 
-void displayMenu(int role) {
-    if (role == 1) { // Admin menu
-        printf("\nAdmin Menu:\n");
-        printf("1. Parse and Insert CSV Data\n");
-        printf("2. Configure Rooms\n");
-        printf("3. Allocate Seats\n");
-        printf("4. Reset Tables\n");
-        printf("5. Export Allocated Seats\n");
-        printf("6. Register New User\n");
-        printf("7. Exit\n");
-    } else { // Coordinator menu
-        printf("\nExam Coordinator Menu:\n");
-        printf("1. Allocate Seats\n");
-        printf("2. Export Allocated Seats\n");
-        printf("3. Exit\n");
+int histogramBucket(uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return (int)value;
     }
+    int magnitude = 63;
+    while (!(value >> magnitude)) {
+        magnitude--;
+    }
+    int shift = magnitude - HISTOGRAM_SUB_BUCKET_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + (int)((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
 }
 
-int parseAndInsertCSV(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (file == NULL) {
-        fprintf(stderr, "Could not open CSV file\n");
-        return EXIT_FAILURE;
+// Highest value that lands in a bucket
+uint64_t histogramBucketLimit(int bucket) {
+    if (bucket < HISTOGRAM_SUB_BUCKETS) {
+        return (uint64_t)bucket;
     }
+    int shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t low = (uint64_t)(HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) << shift;
+    return low + (((uint64_t)1 << shift) - 1);
+}
 
-    char line[1024];
-    while (fgets(line, sizeof(line), file)) {
-        char *symbol_number = strtok(line, ",");
-        char *name = strtok(NULL, ",");
-        char *college_name = strtok(NULL, ",");
-        char *subjects = strtok(NULL, "\n");
+void histogramRecord(Histogram *histogram, uint64_t value) {
+    atomic_fetch_add(&histogram->count, 1);
+    atomic_fetch_add(&histogram->sum, value);
+    atomic_fetch_add(&histogram->buckets[histogramBucket(value)], 1);
+    uint64_t seen = atomic_load(&histogram->max);
+    while (value > seen && !atomic_compare_exchange_weak(&histogram->max, &seen, value)) {
+    }
+}
 
-        char queryStr[1024];
-        snprintf(queryStr, sizeof(queryStr),
-                 "INSERT IGNORE INTO students (symbol_number, name, college_name) VALUES ('%s', '%s', '%s')",
-                 symbol_number, name, college_name);
-        if (mysql_query(conn, queryStr)) {
-            fprintf(stderr, "INSERT failed: %s\n", mysql_error(conn));
-            fclose(file);
-            return EXIT_FAILURE;
+uint64_t histogramPercentile(const Histogram *histogram, double percentile) {
+    uint64_t count = atomic_load(&histogram->count);
+    uint64_t rank = (uint64_t)(count * percentile / 100.0 + 0.5);
+    uint64_t seen = 0;
+    int i;
+    if (rank == 0) rank = 1;
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += atomic_load(&histogram->buckets[i]);
+        if (seen >= rank) {
+            uint64_t limit = histogramBucketLimit(i);
+            uint64_t max = atomic_load(&histogram->max);
+            return limit < max ? limit : max;
         }
+    }
+    return atomic_load(&histogram->max);
+}
 
-        snprintf(queryStr, sizeof(queryStr), "SELECT id FROM students WHERE symbol_number='%s'", symbol_number);
-        if (mysql_query(conn, queryStr)) {
-            fprintf(stderr, "SELECT failed: %s\n", mysql_error(conn));
-            fclose(file);
-            return EXIT_FAILURE;
-        }
-        res = mysql_store_result(conn);
-        if ((row = mysql_fetch_row(res)) == NULL) {
-            fprintf(stderr, "Could not retrieve student ID.\n");
-            fclose(file);
-            return EXIT_FAILURE;
-        }
-        int student_id = atoi(row[0]);
-        mysql_free_result(res);
+void metricsRecordPhase(MetricsPhase phase, double seconds) {
+    if (metrics.enabled) {
+        histogramRecord(&metrics.phases[phase], (uint64_t)(seconds * 1e9));
+    }
+}
 
-        char *subject = strtok(subjects, ";");
-        while (subject != NULL) {
-            snprintf(queryStr, sizeof(queryStr),
-                     "INSERT IGNORE INTO subjects (subject_name) VALUES ('%s')", subject);
-            if (mysql_query(conn, queryStr)) {
-                fprintf(stderr, "INSERT failed: %s\n", mysql_error(conn));
-                fclose(file);
-                return EXIT_FAILURE;
-            }
+int dbRealQuery(MYSQL *connection, const char *query, unsigned long length, QueryKind kind) {
+    if (!metrics.enabled) {
+        return mysql_real_query(connection, query, length);
+    }
 
-            snprintf(queryStr, sizeof(queryStr),
-                     "SELECT id FROM subjects WHERE subject_name='%s'", subject);
-            if (mysql_query(conn, queryStr)) {
-                fprintf(stderr, "SELECT failed: %s\n", mysql_error(conn));
-                fclose(file);
-                return EXIT_FAILURE;
+    double start = getCurrentTimeSeconds();
+    int status = mysql_real_query(connection, query, length);
+    metricsRecordQuery(connection, kind, start, length, status);
+    return status;
+}
+
+// Books a finished text-protocol query started at start
+void metricsRecordQuery(MYSQL *connection, QueryKind kind, double start, unsigned long length, int status) {
+    QueryMetrics *counters = &metrics.queries[kind];
+    histogramRecord(&counters->latency, (uint64_t)((getCurrentTimeSeconds() - start) * 1e9));
+    atomic_fetch_add(&counters->bytesSent, length);
+    if (status) {
+        atomic_fetch_add(&counters->errors, 1);
+    } else if (mysql_field_count(connection) == 0) {
+        atomic_fetch_add(&counters->rows, mysql_affected_rows(connection));
+    }
+}
+
+int dbQuery(MYSQL *connection, const char *query, QueryKind kind) {
+    return dbRealQuery(connection, query, strlen(query), kind);
+}
+
+MYSQL_ROW dbFetchRow(MYSQL_RES *result, QueryKind kind) {
+    MYSQL_ROW row = mysql_fetch_row(result);
+    if (metrics.enabled && row != NULL) {
+        unsigned long *lengths = mysql_fetch_lengths(result);
+        unsigned int fields = mysql_num_fields(result);
+        uint64_t bytes = 0;
+        unsigned int i;
+        for (i = 0; lengths && i < fields; i++) {
+            bytes += lengths[i];
+        }
+        atomic_fetch_add(&metrics.queries[kind].rows, 1);
+        atomic_fetch_add(&metrics.queries[kind].bytesReceived, bytes);
+    }
+    return row;
+}
+
+int dbCommit(MYSQL *connection, QueryKind kind) {
+    if (!metrics.enabled) {
+        return mysql_commit(connection);
+    }
+    double start = getCurrentTimeSeconds();
+    int status = mysql_commit(connection);
+    histogramRecord(&metrics.queries[kind].latency, (uint64_t)((getCurrentTimeSeconds() - start) * 1e9));
+    if (status) {
+        atomic_fetch_add(&metrics.queries[kind].errors, 1);
+    }
+    return status;
+}
+
+// Prepared statements travel in the binary protocol, so only rows are counted, not bytes
+int dbStatementExecute(MYSQL_STMT *statement, QueryKind kind) {
+    if (!metrics.enabled) {
+        return mysql_stmt_execute(statement);
+    }
+
+    QueryMetrics *counters = &metrics.queries[kind];
+    double start = getCurrentTimeSeconds();
+    int status = mysql_stmt_execute(statement);
+    histogramRecord(&counters->latency, (uint64_t)((getCurrentTimeSeconds() - start) * 1e9));
+    if (status) {
+        atomic_fetch_add(&counters->errors, 1);
+    } else if (mysql_stmt_field_count(statement) == 0) {
+        atomic_fetch_add(&counters->rows, mysql_stmt_affected_rows(statement));
+    }
+    return status;
+}
+
+int dbStatementFetch(MYSQL_STMT *statement, QueryKind kind) {
+    int status = mysql_stmt_fetch(statement);
+    if (metrics.enabled && status == 0) {
+        atomic_fetch_add(&metrics.queries[kind].rows, 1);
+    }
+    return status;
+}
+
+void writeHistogramJson(FILE *file, const Histogram *histogram) {
+    uint64_t count = atomic_load(&histogram->count);
+    fprintf(file, "{\"count\": %llu, \"sum\": %llu, \"mean\": %.1f, \"p50\": %llu, \"p90\": %llu, "
+                  "\"p99\": %llu, \"p999\": %llu, \"max\": %llu}",
+            (unsigned long long)count, (unsigned long long)atomic_load(&histogram->sum),
+            count ? (double)atomic_load(&histogram->sum) / count : 0.0,
+            (unsigned long long)histogramPercentile(histogram, 50), (unsigned long long)histogramPercentile(histogram, 90),
+            (unsigned long long)histogramPercentile(histogram, 99),
+            (unsigned long long)histogramPercentile(histogram, 99.9), (unsigned long long)atomic_load(&histogram->max));
+}
+
+// Summary quantiles plus _sum and _count, the Prometheus layout for a summary
+void writeHistogramPrometheus(FILE *file, const char *name, const char *labels, const Histogram *histogram,
+                              double scale) {
+    const double quantiles[] = {50, 90, 99, 99.9};
+    int i;
+    for (i = 0; i < 4; i++) {
+        fprintf(file, "%s{%s%squantile=\"%g\"} %g\n", name, labels, *labels ? "," : "", quantiles[i] / 100,
+                histogramPercentile(histogram, quantiles[i]) * scale);
+    }
+    fprintf(file, "%s_sum{%s} %g\n", name, labels, atomic_load(&histogram->sum) * scale);
+    fprintf(file, "%s_count{%s} %llu\n", name, labels, (unsigned long long)atomic_load(&histogram->count));
+}
+
+// Registered with atexit by metricsInit
+void metricsDump() {
+    FILE *file = fopen(metrics.path, "w");
+    int i;
+    if (file == NULL) {
+        fprintf(stderr, "Could not write metrics to %s\n", metrics.path);
+        return;
+    }
+
+    if (metrics.prometheus) {
+        char labels[64];
+        fprintf(file, "# TYPE eccs_query_latency_seconds summary\n");
+        for (i = 0; i < QUERY_KIND_COUNT; i++) {
+            snprintf(labels, sizeof(labels), "kind=\"%s\"", queryKindNames[i]);
+            writeHistogramPrometheus(file, "eccs_query_latency_seconds", labels, &metrics.queries[i].latency, 1e-9);
+        }
+        const char *counters[] = {"errors", "rows", "bytes_sent", "bytes_received"};
+        int c;
+        for (c = 0; c < 4; c++) {
+            fprintf(file, "# TYPE eccs_query_%s_total counter\n", counters[c]);
+            for (i = 0; i < QUERY_KIND_COUNT; i++) {
+                const QueryMetrics *query = &metrics.queries[i];
+                const _Atomic uint64_t *value = c == 0 ? &query->errors : c == 1 ? &query->rows :
+                                                c == 2 ? &query->bytesSent : &query->bytesReceived;
+                fprintf(file, "eccs_query_%s_total{kind=\"%s\"} %llu\n", counters[c], queryKindNames[i],
+                        (unsigned long long)atomic_load(value));
+            }
+        }
+        fprintf(file, "# TYPE eccs_phase_seconds summary\n");
+        for (i = 0; i < PHASE_COUNT; i++) {
+            snprintf(labels, sizeof(labels), "phase=\"%s\"", metricsPhaseNames[i]);
+            writeHistogramPrometheus(file, "eccs_phase_seconds", labels, &metrics.phases[i], 1e-9);
+        }
+        fprintf(file, "# TYPE eccs_seats_scanned_per_placement summary\n");
+        writeHistogramPrometheus(file, "eccs_seats_scanned_per_placement", "", &metrics.seatsScanned, 1);
+    } else {
+        fprintf(file, "{\n  \"queries\": {\n");
+        for (i = 0; i < QUERY_KIND_COUNT; i++) {
+            const QueryMetrics *query = &metrics.queries[i];
+            fprintf(file, "    \"%s\": {\"errors\": %llu, \"rows\": %llu, \"bytes_sent\": %llu, "
+                          "\"bytes_received\": %llu, \"latency_ns\": ",
+                    queryKindNames[i], (unsigned long long)atomic_load(&query->errors),
+                    (unsigned long long)atomic_load(&query->rows), (unsigned long long)atomic_load(&query->bytesSent),
+                    (unsigned long long)atomic_load(&query->bytesReceived));
+            writeHistogramJson(file, &query->latency);
+            fprintf(file, "}%s\n", i + 1 < QUERY_KIND_COUNT ? "," : "");
+        }
+        fprintf(file, "  },\n  \"phases_ns\": {\n");
+        for (i = 0; i < PHASE_COUNT; i++) {
+            fprintf(file, "    \"%s\": ", metricsPhaseNames[i]);
+            writeHistogramJson(file, &metrics.phases[i]);
+            fprintf(file, "%s\n", i + 1 < PHASE_COUNT ? "," : "");
+        }
+        fprintf(file, "  },\n  \"seats_scanned_per_placement\": ");
+        writeHistogramJson(file, &metrics.seatsScanned);
+        fprintf(file, "\n}\n");
+    }
+    fclose(file);
+}
+
+void clearScreenWithMessage(const char *message) {
+    // Display the message
+    printf("%s\n", message);
+
+    // Output going to a file or pipe has nobody to pause for and no screen to clear
+    #ifdef _WIN32
+        if (!_isatty(_fileno(stdout))) {
+            return;
+        }
+    #else
+        if (!isatty(STDOUT_FILENO)) {
+            return;
+        }
+    #endif
+
+    // Pause for 2 seconds
+    #ifdef _WIN32
+        Sleep(1000); // Sleep in milliseconds
+    #else
+        sleep(1);    // Sleep in seconds
+    #endif
+
+    // Clear the screen based on the operating system
+    #ifdef _WIN32
+        system("cls");  // Windows
+    #else
+        system("clear"); // Linux/macOS
+    #endif
+}
+
+void printTitle() {
+    printf("\n================================================\n");
+    printf(" Welcome to the Exam Center Coordination System \n");
+    printf("================================================\n\n");
+	clearScreenWithMessage("Starting the system... Please wait!");
+}
+
+void displayMenu(int role) {
+    if (role == 1) { // Admin menu
+        printf("\nAdmin Menu:\n");
+        printf("1. Parse and Insert CSV Data\n");
+        printf("2. Configure Rooms\n");
+        printf("3. Allocate Seats\n");
+        printf("4. Reset Tables\n");
+        printf("5. Export Allocated Seats\n");
+        printf("6. Register New User\n");
+        printf("7. Run Benchmarks\n");
+        printf("8. Exit\n");
+    } else { // Coordinator menu
+        printf("\nExam Coordinator Menu:\n");
+        printf("1. Allocate Seats\n");
+        printf("2. Export Allocated Seats\n");
+        printf("3. Exit\n");
+    }
+}
+
+int parseAndInsertCSV(const char *filename) {
+    CsvReader reader;
+    if (csvReaderOpen(&reader, filename) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not open CSV file\n");
+        return EXIT_FAILURE;
+    }
+
+    IngestDictionary dict;
+    if (loadIngestDictionary(conn, &dict) == EXIT_FAILURE) {
+        csvReaderClose(&reader);
+        return EXIT_FAILURE;
+    }
+
+    // Every write is pipelined on the async connections and nothing waits for an id: a student's
+    // rows share one lane keyed by symbol, so its INSERT IGNORE lands before its enrollments, and
+    // enrollments of new students or subjects look both ids up on the server
+    AsyncExecutor writes;
+    IdDictionary subjectLanes; // New subject -> bitmask of the connections that have inserted it
+    if (idDictionaryInit(&subjectLanes, 0) == EXIT_FAILURE) {
+        csvReaderClose(&reader);
+        freeIngestDictionary(&dict);
+        return EXIT_FAILURE;
+    }
+    if (asyncExecutorOpen(&writes, ASYNC_CONNECTIONS) == EXIT_FAILURE) {
+        csvReaderClose(&reader);
+        freeIngestDictionary(&dict);
+        idDictionaryFree(&subjectLanes);
+        return EXIT_FAILURE;
+    }
+
+    double startTime = getCurrentTimeSeconds();
+    long rowCount = 0, duplicateCount = 0;
+    int provisionalId = 0; // New keys get negative ids so their pairs can still be deduplicated
+    int parsed = 0, status = EXIT_FAILURE;
+    SqlBuffer statement = {0};
+
+    CsvField fields[4];
+    int fieldCount;
+    while ((fieldCount = csvReaderNextRecord(&reader, fields, 4)) > 0) {
+        if (fieldCount < 4) {
+            fprintf(stderr, "Skipping malformed CSV line %ld.\n", reader.line);
+            continue;
+        }
+        // Cutting values short would silently merge students whose symbols share a prefix
+        if (!csvRecordFits(fields)) {
+            fprintf(stderr, "Skipping CSV line %ld: a value is longer than %d characters.\n", reader.line,
+                    CSV_VALUE_MAX);
+            continue;
+        }
+
+        char symbol_number[CSV_VALUE_MAX + 1], name[CSV_VALUE_MAX + 1], college_name[CSV_VALUE_MAX + 1];
+        char subject[CSV_VALUE_MAX + 1];
+        size_t symbolLength = csvFieldCopy(&fields[0], symbol_number, sizeof(symbol_number));
+        csvFieldCopy(&fields[1], name, sizeof(name));
+        csvFieldCopy(&fields[2], college_name, sizeof(college_name));
+
+        int lane = (int)(hashKey(symbol_number, symbolLength) & INT32_MAX);
+        unsigned int laneBit = 1u << ((unsigned int)lane % (unsigned int)writes.count);
+        int student_id = idDictionaryFind(&dict.students, symbol_number, symbolLength);
+        if (student_id == 0) {
+            student_id = --provisionalId;
+            statement.length = 0;
+            if (idDictionaryPut(&dict.students, symbol_number, symbolLength, student_id) == EXIT_FAILURE ||
+                sqlBufferAppend(&statement, "INSERT IGNORE INTO students (symbol_number, name, college_name) "
+                                            "VALUES (") ||
+                sqlBufferAppendEscaped(&statement, conn, symbol_number) || sqlBufferAppend(&statement, ", ") ||
+                sqlBufferAppendEscaped(&statement, conn, name) || sqlBufferAppend(&statement, ", ") ||
+                sqlBufferAppendEscaped(&statement, conn, college_name) || sqlBufferAppend(&statement, ")") ||
+                asyncExecutorSubmit(&writes, lane, statement.data, statement.length, QUERY_INGEST_WRITE)) {
+                goto drain;
+            }
+        }
+
+        size_t subjectOffset = 0;
+        CsvField subjectField;
+        while (csvNextSubfield(&fields[3], ';', &subjectOffset, &subjectField)) {
+            size_t subjectLength = csvFieldCopy(&subjectField, subject, sizeof(subject));
+            int subject_id = idDictionaryFind(&dict.subjects, subject, subjectLength);
+            if (subject_id == 0) {
+                subject_id = --provisionalId;
+                if (idDictionaryPut(&dict.subjects, subject, subjectLength, subject_id) == EXIT_FAILURE) {
+                    goto drain;
+                }
+            }
+            // A new subject (known ones count as on every connection) is inserted once per connection,
+            // ahead of the first enrollment there
+            // that needs it, so the lookup never races an insert still running on another connection
+            int lanes = subject_id < 0 ? idDictionaryFind(&subjectLanes, subject, subjectLength) : -1;
+            if (!(lanes & laneBit)) {
+                statement.length = 0;
+                if (idDictionaryPut(&subjectLanes, subject, subjectLength, lanes | laneBit) == EXIT_FAILURE ||
+                    sqlBufferAppend(&statement, "INSERT IGNORE INTO subjects (subject_name) VALUES (") ||
+                    sqlBufferAppendEscaped(&statement, conn, subject) || sqlBufferAppend(&statement, ")") ||
+                    asyncExecutorSubmit(&writes, lane, statement.data, statement.length, QUERY_INGEST_WRITE)) {
+                    goto drain;
+                }
+            }
+
+            // Skip pairs that are already enrolled so re-ingest does not duplicate them
+            int added = pairSetInsert(&dict.enrollments, student_id, subject_id);
+            if (added < 0) {
+                goto drain;
+            }
+            if (added == 0) {
+                duplicateCount++;
+                continue;
+            }
+
+            statement.length = 0;
+            if (student_id > 0 && subject_id > 0) {
+                char values[64];
+                snprintf(values, sizeof(values), "VALUES (%d, %d)", student_id, subject_id);
+                if (sqlBufferAppend(&statement, "INSERT INTO student_subjects (student_id, subject_id) ") ||
+                    sqlBufferAppend(&statement, values)) {
+                    goto drain;
+                }
+            } else if (sqlBufferAppend(&statement, "INSERT INTO student_subjects (student_id, subject_id) "
+                                                   "SELECT s.id, sub.id FROM students s, subjects sub "
+                                                   "WHERE s.symbol_number = ") ||
+                       sqlBufferAppendEscaped(&statement, conn, symbol_number) ||
+                       sqlBufferAppend(&statement, " AND sub.subject_name = ") ||
+                       sqlBufferAppendEscaped(&statement, conn, subject)) {
+                goto drain;
+            }
+            if (asyncExecutorSubmit(&writes, lane, statement.data, statement.length, QUERY_INGEST_WRITE) ==
+                EXIT_FAILURE) {
+                goto drain;
+            }
+            rowCount++;
+        }
+    }
+    parsed = 1;
+
+drain:
+    // Also waits out the statements already in flight when parsing stopped early
+    if (asyncExecutorDrain(&writes) == EXIT_SUCCESS && parsed) {
+        status = EXIT_SUCCESS;
+    }
+    asyncExecutorClose(&writes);
+    sqlBufferFree(&statement);
+    idDictionaryFree(&subjectLanes);
+    csvReaderClose(&reader);
+    freeIngestDictionary(&dict);
+    if (status == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    double elapsed = getCurrentTimeSeconds() - startTime;
+    metricsRecordPhase(PHASE_INGEST, elapsed);
+    printf("\nCSV data parsed and inserted successfully.\n");
+    printf("Inserted %ld enrollment rows in %.2f s (%.0f rows/s), skipped %ld already enrolled.\n",
+           rowCount, elapsed, elapsed > 0 ? rowCount / elapsed : 0.0, duplicateCount);
+    return EXIT_SUCCESS;
+}
+
+// ==== ID dictionary ====
+
+// FNV-1a; good enough spread for symbol numbers and subject names
+uint64_t hashKey(const char *key, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i;
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+int idDictionaryInit(IdDictionary *dict, size_t capacity) {
+    size_t slots = 1024;
+    while (slots < capacity * 2) {
+        slots *= 2;
+    }
+
+    memset(dict, 0, sizeof(*dict));
+    dict->entries = calloc(slots, sizeof(IdDictionaryEntry));
+    if (dict->entries == NULL) {
+        fprintf(stderr, "Memory allocation failed for ID dictionary.\n");
+        return EXIT_FAILURE;
+    }
+    dict->capacity = slots;
+    return EXIT_SUCCESS;
+}
+
+void idDictionaryFree(IdDictionary *dict) {
+    free(dict->entries);
+    stringPoolFree(&dict->keys);
+    memset(dict, 0, sizeof(*dict));
+}
+
+// Linear probe for key; returns its slot, or the empty slot where it would go
+IdDictionaryEntry *idDictionaryProbe(const IdDictionary *dict, const char *key, size_t length, uint64_t hash) {
+    size_t mask = dict->capacity - 1;
+    size_t slot = hash & mask;
+
+    while (1) {
+        IdDictionaryEntry *entry = &dict->entries[slot];
+        if (entry->key == NULL) {
+            return entry;
+        }
+        if (entry->hash == hash && entry->length == length && memcmp(entry->key, key, length) == 0) {
+            return entry;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+// Returns the id stored for key, or 0 if the key is unknown
+int idDictionaryFind(const IdDictionary *dict, const char *key, size_t length) {
+    IdDictionaryEntry *entry = idDictionaryProbe(dict, key, length, hashKey(key, length));
+    return entry->key ? entry->id : 0;
+}
+
+int idDictionaryPut(IdDictionary *dict, const char *key, size_t length, int id) {
+    // Keep the load factor under 0.7 so probe sequences stay short
+    if ((dict->count + 1) * 10 > dict->capacity * 7) {
+        IdDictionaryEntry *old = dict->entries;
+        size_t oldCapacity = dict->capacity, i;
+
+        dict->entries = calloc(oldCapacity * 2, sizeof(IdDictionaryEntry));
+        if (dict->entries == NULL) {
+            fprintf(stderr, "Memory allocation failed for ID dictionary.\n");
+            dict->entries = old;
+            return EXIT_FAILURE;
+        }
+        dict->capacity = oldCapacity * 2;
+        for (i = 0; i < oldCapacity; i++) {
+            if (old[i].key) {
+                *idDictionaryProbe(dict, old[i].key, old[i].length, old[i].hash) = old[i];
+            }
+        }
+        free(old);
+    }
+
+    uint64_t hash = hashKey(key, length);
+    IdDictionaryEntry *entry = idDictionaryProbe(dict, key, length, hash);
+    if (entry->key == NULL) {
+        char *copy = stringPoolAlloc(&dict->keys, length + 1);
+        if (copy == NULL) {
+            return EXIT_FAILURE;
+        }
+        memcpy(copy, key, length);
+        copy[length] = '\0';
+        entry->key = copy;
+        entry->length = length;
+        entry->hash = hash;
+        dict->count++;
+    }
+    entry->id = id;
+    return EXIT_SUCCESS;
+}
+
+int pairSetInit(PairSet *set, size_t capacity) {
+    size_t slots = 1024;
+    while (slots < capacity * 2) {
+        slots *= 2;
+    }
+
+    set->slots = calloc(slots, sizeof(uint64_t));
+    set->capacity = slots;
+    set->count = 0;
+    if (set->slots == NULL) {
+        fprintf(stderr, "Memory allocation failed for enrollment set.\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+void pairSetFree(PairSet *set) {
+    free(set->slots);
+    memset(set, 0, sizeof(*set));
+}
+
+// Mixes the packed pair so sequential ids don't cluster in one probe run
+size_t pairSetSlot(const PairSet *set, uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key & (set->capacity - 1);
+}
+
+int pairSetContains(const PairSet *set, int student_id, int subject_id) {
+    uint64_t key = ((uint64_t)(unsigned)student_id << 32) | (unsigned)subject_id;
+    size_t mask = set->capacity - 1;
+    size_t slot = pairSetSlot(set, key);
+
+    while (set->slots[slot]) {
+        if (set->slots[slot] == key) {
+            return 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return 0;
+}
+
+// Returns 1 if the pair was added, 0 if it was already present, -1 on allocation failure
+int pairSetInsert(PairSet *set, int student_id, int subject_id) {
+    if ((set->count + 1) * 10 > set->capacity * 7) {
+        PairSet grown;
+        size_t i;
+        if (pairSetInit(&grown, set->capacity) == EXIT_FAILURE) {
+            return -1;
+        }
+        for (i = 0; i < set->capacity; i++) {
+            if (set->slots[i]) {
+                size_t slot = pairSetSlot(&grown, set->slots[i]);
+                while (grown.slots[slot]) {
+                    slot = (slot + 1) & (grown.capacity - 1);
+                }
+                grown.slots[slot] = set->slots[i];
+            }
+        }
+        grown.count = set->count;
+        free(set->slots);
+        *set = grown;
+    }
+
+    uint64_t key = ((uint64_t)(unsigned)student_id << 32) | (unsigned)subject_id;
+    size_t mask = set->capacity - 1;
+    size_t slot = pairSetSlot(set, key);
+
+    while (set->slots[slot]) {
+        if (set->slots[slot] == key) {
+            return 0;
+        }
+        slot = (slot + 1) & mask;
+    }
+    set->slots[slot] = key;
+    set->count++;
+    return 1;
+}
+
+int intMapInit(IntMap *map, size_t capacity) {
+    size_t slots = 64;
+    while (slots < capacity * 2) {
+        slots *= 2;
+    }
+
+    map->keys = calloc(slots, sizeof(int));
+    map->values = malloc(sizeof(int) * slots);
+    map->capacity = slots;
+    map->count = 0;
+    if (map->keys == NULL || map->values == NULL) {
+        fprintf(stderr, "Memory allocation failed for id map.\n");
+        intMapFree(map);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+void intMapFree(IntMap *map) {
+    free(map->keys);
+    free(map->values);
+    memset(map, 0, sizeof(*map));
+}
+
+size_t intMapSlot(const IntMap *map, int key) {
+    uint64_t hash = (unsigned)key * 0x9e3779b97f4a7c15ULL;
+    return (hash >> 32) & (map->capacity - 1);
+}
+
+// Returns the value stored for key, or -1
+int intMapFind(const IntMap *map, int key) {
+    size_t mask = map->capacity - 1;
+    size_t slot = intMapSlot(map, key);
+
+    while (map->keys[slot]) {
+        if (map->keys[slot] == key) {
+            return map->values[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+int intMapPut(IntMap *map, int key, int value) {
+    if ((map->count + 1) * 10 > map->capacity * 7) {
+        IntMap grown;
+        size_t i;
+        if (intMapInit(&grown, map->capacity) == EXIT_FAILURE) {
+            return EXIT_FAILURE;
+        }
+        for (i = 0; i < map->capacity; i++) {
+            if (map->keys[i]) {
+                size_t slot = intMapSlot(&grown, map->keys[i]);
+                while (grown.keys[slot]) {
+                    slot = (slot + 1) & (grown.capacity - 1);
+                }
+                grown.keys[slot] = map->keys[i];
+                grown.values[slot] = map->values[i];
+            }
+        }
+        grown.count = map->count;
+        intMapFree(map);
+        *map = grown;
+    }
+
+    size_t mask = map->capacity - 1;
+    size_t slot = intMapSlot(map, key);
+    while (map->keys[slot] && map->keys[slot] != key) {
+        slot = (slot + 1) & mask;
+    }
+    if (map->keys[slot] == 0) {
+        map->keys[slot] = key;
+        map->count++;
+    }
+    map->values[slot] = value;
+    return EXIT_SUCCESS;
+}
+
+// Pre-warms the dictionaries with every student, subject and enrollment already in the database
+int loadIngestDictionary(MYSQL *connection, IngestDictionary *dict) {
+    const char *queries[] = {
+        "SELECT id, symbol_number FROM students",
+        "SELECT id, subject_name FROM subjects",
+        "SELECT student_id, subject_id FROM student_subjects"
+    };
+    int i;
+
+    memset(dict, 0, sizeof(*dict));
+    if (idDictionaryInit(&dict->students, 0) == EXIT_FAILURE ||
+        idDictionaryInit(&dict->subjects, 0) == EXIT_FAILURE ||
+        pairSetInit(&dict->enrollments, 0) == EXIT_FAILURE) {
+        freeIngestDictionary(dict);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (dbQuery(connection, queries[i], QUERY_ID_LOOKUP)) {
+            fprintf(stderr, "Dictionary query failed: %s\n", mysql_error(connection));
+            freeIngestDictionary(dict);
+            return EXIT_FAILURE;
+        }
+
+        // Stream rows; the tables can be far larger than we want to buffer twice
+        MYSQL_RES *result = mysql_use_result(connection);
+        if (result == NULL) {
+            fprintf(stderr, "Could not retrieve dictionary data: %s\n", mysql_error(connection));
+            freeIngestDictionary(dict);
+            return EXIT_FAILURE;
+        }
+
+        MYSQL_ROW dictRow;
+        int status = EXIT_SUCCESS;
+        while ((dictRow = dbFetchRow(result, QUERY_ID_LOOKUP))) {
+            if (status == EXIT_FAILURE) {
+                continue; // Drain the stream before bailing out
+            }
+            if (i == 2) {
+                status = pairSetInsert(&dict->enrollments, atoi(dictRow[0]), atoi(dictRow[1])) < 0
+                         ? EXIT_FAILURE : EXIT_SUCCESS;
+            } else {
+                IdDictionary *target = (i == 0) ? &dict->students : &dict->subjects;
+                status = idDictionaryPut(target, dictRow[1], strlen(dictRow[1]), atoi(dictRow[0]));
+            }
+        }
+        mysql_free_result(result);
+
+        if (status == EXIT_FAILURE) {
+            freeIngestDictionary(dict);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void freeIngestDictionary(IngestDictionary *dict) {
+    idDictionaryFree(&dict->students);
+    idDictionaryFree(&dict->subjects);
+    pairSetFree(&dict->enrollments);
+}
+
+// ==== Parallel ingest pipeline ====
+
+// Opens a new connection with the application's credentials
+MYSQL *openDatabaseConnection() {
+    MYSQL *connection = mysql_init(NULL);
+    if (connection == NULL) {
+        fprintf(stderr, "mysql_init() failed\n");
+        return NULL;
+    }
+
+    if (connectDatabaseHandle(connection) == EXIT_FAILURE) {
+        mysql_close(connection);
+        return NULL;
+    }
+    return connection;
+}
+
+// Connects a handle from mysql_init(), after any options have been set on it
+int connectDatabaseHandle(MYSQL *connection) {
+    if (mysql_real_connect(connection, dbSettings.host, dbSettings.user, dbSettings.password, dbSettings.database,
+                           dbSettings.port, dbSettings.socket, 0) == NULL) {
+        fprintf(stderr, "mysql_real_connect() failed: %s\n", mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int connectionPoolOpen(ConnectionPool *pool, int size) {
+    int i;
+    pool->connections = calloc(size, sizeof(MYSQL *));
+    pool->size = 0;
+    if (pool->connections == NULL) {
+        fprintf(stderr, "Memory allocation failed for connection pool.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < size; i++) {
+        pool->connections[i] = openDatabaseConnection();
+        if (pool->connections[i] == NULL) {
+            connectionPoolClose(pool);
+            return EXIT_FAILURE;
+        }
+        pool->size++;
+    }
+    return EXIT_SUCCESS;
+}
+
+void connectionPoolClose(ConnectionPool *pool) {
+    int i;
+    for (i = 0; i < pool->size; i++) {
+        mysql_close(pool->connections[i]);
+    }
+    free(pool->connections);
+    pool->connections = NULL;
+    pool->size = 0;
+}
+
+// ==== Async statement executor ====
+
+int asyncExecutorOpen(AsyncExecutor *executor, int count) {
+    int i;
+    memset(executor, 0, sizeof(*executor));
+    executor->epollFd = -1;
+#if !ASYNC_DB_IO
+    count = 1; // Without the non-blocking API statements run inline on a single connection
+#endif
+    executor->connections = calloc(count, sizeof(AsyncConnection));
+    if (executor->connections == NULL) {
+        fprintf(stderr, "Memory allocation failed for async connections.\n");
+        return EXIT_FAILURE;
+    }
+
+#if ASYNC_DB_IO
+    executor->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (executor->epollFd < 0) {
+        perror("epoll_create1");
+        asyncExecutorClose(executor);
+        return EXIT_FAILURE;
+    }
+#endif
+
+    for (i = 0; i < count; i++) {
+        MYSQL *connection = mysql_init(NULL);
+        if (connection == NULL) {
+            fprintf(stderr, "mysql_init() failed\n");
+            asyncExecutorClose(executor);
+            return EXIT_FAILURE;
+        }
+#if ASYNC_DB_IO
+        mysql_options(connection, MYSQL_OPT_NONBLOCK, 0);
+#endif
+        if (connectDatabaseHandle(connection) == EXIT_FAILURE) {
+            mysql_close(connection);
+            asyncExecutorClose(executor);
+            return EXIT_FAILURE;
+        }
+        executor->connections[i].connection = connection;
+        executor->count++;
+
+#if ASYNC_DB_IO
+        // Registered idle; asyncConnectionWatch switches on the events the client waits for
+        struct epoll_event event;
+        event.events = 0;
+        event.data.ptr = &executor->connections[i];
+        if (epoll_ctl(executor->epollFd, EPOLL_CTL_ADD, mysql_get_socket(connection), &event)) {
+            perror("epoll_ctl");
+            asyncExecutorClose(executor);
+            return EXIT_FAILURE;
+        }
+#endif
+    }
+    return EXIT_SUCCESS;
+}
+
+// Queues a statement without a result set on lane % count. Statement failures are
+// collected for asyncExecutorDrain; a failure return means nothing more should be submitted.
+int asyncExecutorSubmit(AsyncExecutor *executor, int lane, const char *sql, unsigned long length, QueryKind kind) {
+    AsyncConnection *slot = &executor->connections[(unsigned int)lane % (unsigned int)executor->count];
+    if (executor->failed) {
+        return EXIT_FAILURE;
+    }
+
+#if ASYNC_DB_IO
+    // A lane that falls behind holds up the producer instead of growing without bound
+    while (slot->queued >= ASYNC_QUEUE_LIMIT) {
+        if (asyncExecutorPoll(executor) == EXIT_FAILURE) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    AsyncStatement *statement = malloc(sizeof(AsyncStatement) + length + 1);
+    if (statement == NULL) {
+        fprintf(stderr, "Memory allocation failed for async statement.\n");
+        return EXIT_FAILURE;
+    }
+    statement->next = NULL;
+    statement->kind = kind;
+    statement->length = length;
+    memcpy(statement->sql, sql, length);
+    statement->sql[length] = '\0';
+
+    if (slot->tail != NULL) {
+        slot->tail->next = statement;
+    } else {
+        slot->head = statement;
+    }
+    slot->tail = statement;
+    slot->queued++;
+    executor->pending++;
+    if (slot->busy) {
+        return EXIT_SUCCESS;
+    }
+    return asyncConnectionStart(executor, slot);
+#else
+    int status = dbRealQuery(slot->connection, sql, length, kind);
+    if (status == 0 && mysql_field_count(slot->connection) != 0) {
+        mysql_free_result(mysql_store_result(slot->connection));
+    }
+    if (status) {
+        if (executor->failed == 0) {
+            snprintf(executor->error, sizeof(executor->error), "%s", mysql_error(slot->connection));
+        }
+        executor->failed++;
+    } else {
+        executor->affectedRows += mysql_affected_rows(slot->connection);
+        executor->completed++;
+    }
+    return EXIT_SUCCESS;
+#endif
+}
+
+// Retires the statement at the head of a connection's queue
+void asyncExecutorComplete(AsyncExecutor *executor, AsyncConnection *slot, int status) {
+    AsyncStatement *statement = slot->head;
+    if (metrics.enabled) {
+        metricsRecordQuery(slot->connection, statement->kind, slot->started, statement->length, status);
+    }
+
+    if (status) {
+        if (executor->failed == 0) {
+            snprintf(executor->error, sizeof(executor->error), "%s", mysql_error(slot->connection));
+        }
+        executor->failed++;
+    } else {
+        // Writes are expected, but a stray result set must still be read off the wire
+        if (mysql_field_count(slot->connection) != 0) {
+            mysql_free_result(mysql_store_result(slot->connection));
+        } else {
+            executor->affectedRows += mysql_affected_rows(slot->connection);
+        }
+        executor->completed++;
+    }
+
+    slot->head = statement->next;
+    if (slot->head == NULL) {
+        slot->tail = NULL;
+    }
+    slot->queued--;
+    slot->busy = 0;
+    executor->pending--;
+    free(statement);
+}
+
+#if ASYNC_DB_IO
+// Starts queued statements until the client library has to wait on the socket
+int asyncConnectionStart(AsyncExecutor *executor, AsyncConnection *slot) {
+    while (slot->head != NULL) {
+        int error = 0;
+        slot->busy = 1;
+        slot->started = getCurrentTimeSeconds();
+        slot->waitStatus = mysql_real_query_start(&error, slot->connection, slot->head->sql, slot->head->length);
+        if (slot->waitStatus != 0) {
+            return asyncConnectionWatch(executor, slot);
+        }
+        asyncExecutorComplete(executor, slot, error);
+    }
+    return asyncConnectionWatch(executor, slot);
+}
+
+// Hands the events that fired back to the client library
+int asyncConnectionResume(AsyncExecutor *executor, AsyncConnection *slot, int ready) {
+    int error = 0;
+    slot->waitStatus = mysql_real_query_cont(&error, slot->connection, ready);
+    if (slot->waitStatus != 0) {
+        return asyncConnectionWatch(executor, slot);
+    }
+    asyncExecutorComplete(executor, slot, error);
+    return asyncConnectionStart(executor, slot);
+}
+
+// Points epoll at whatever the connection is waiting for, nothing while it is idle
+int asyncConnectionWatch(AsyncExecutor *executor, AsyncConnection *slot) {
+    struct epoll_event event;
+    event.events = 0;
+    event.data.ptr = slot;
+    if (slot->busy) {
+        if (slot->waitStatus & MYSQL_WAIT_READ) {
+            event.events |= EPOLLIN;
+        }
+        if (slot->waitStatus & MYSQL_WAIT_WRITE) {
+            event.events |= EPOLLOUT;
+        }
+        if (slot->waitStatus & MYSQL_WAIT_EXCEPT) {
+            event.events |= EPOLLPRI;
+        }
+        if (slot->waitStatus & MYSQL_WAIT_TIMEOUT) {
+            slot->deadline = getCurrentTimeSeconds() + mysql_get_timeout_value_ms(slot->connection) / 1000.0;
+        }
+    }
+
+    if (event.events == slot->watched) {
+        return EXIT_SUCCESS;
+    }
+    if (epoll_ctl(executor->epollFd, EPOLL_CTL_MOD, mysql_get_socket(slot->connection), &event)) {
+        perror("epoll_ctl");
+        return EXIT_FAILURE;
+    }
+    slot->watched = event.events;
+    return EXIT_SUCCESS;
+}
+#endif
+
+// Waits until at least one connection makes progress
+int asyncExecutorPoll(AsyncExecutor *executor) {
+#if ASYNC_DB_IO
+    struct epoll_event events[ASYNC_CONNECTIONS];
+    double now = getCurrentTimeSeconds();
+    int timeout = -1;
+    int i, ready;
+
+    if (executor->pending == 0) {
+        return EXIT_SUCCESS;
+    }
+    for (i = 0; i < executor->count; i++) {
+        AsyncConnection *slot = &executor->connections[i];
+        if (slot->busy && (slot->waitStatus & MYSQL_WAIT_TIMEOUT)) {
+            int remaining = slot->deadline > now ? (int)((slot->deadline - now) * 1000.0) + 1 : 0;
+            if (timeout < 0 || remaining < timeout) {
+                timeout = remaining;
+            }
+        }
+    }
+
+    ready = epoll_wait(executor->epollFd, events, ASYNC_CONNECTIONS, timeout);
+    if (ready < 0) {
+        if (errno == EINTR) {
+            return EXIT_SUCCESS;
+        }
+        perror("epoll_wait");
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < ready; i++) {
+        AsyncConnection *slot = events[i].data.ptr;
+        int status = 0;
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            status |= MYSQL_WAIT_READ;
+        }
+        if (events[i].events & EPOLLOUT) {
+            status |= MYSQL_WAIT_WRITE;
+        }
+        if (events[i].events & EPOLLPRI) {
+            status |= MYSQL_WAIT_EXCEPT;
+        }
+        if (slot->busy && asyncConnectionResume(executor, slot, status) == EXIT_FAILURE) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Connections whose timer ran out without socket activity
+    now = getCurrentTimeSeconds();
+    for (i = 0; i < executor->count; i++) {
+        AsyncConnection *slot = &executor->connections[i];
+        if (slot->busy && (slot->waitStatus & MYSQL_WAIT_TIMEOUT) && slot->deadline <= now) {
+            if (asyncConnectionResume(executor, slot, MYSQL_WAIT_TIMEOUT) == EXIT_FAILURE) {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+#else
+    (void)executor;
+#endif
+    return EXIT_SUCCESS;
+}
+
+// Waits for every submitted statement and reports whether all of them succeeded
+int asyncExecutorDrain(AsyncExecutor *executor) {
+    while (executor->pending > 0) {
+        if (asyncExecutorPoll(executor) == EXIT_FAILURE) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (executor->failed) {
+        fprintf(stderr, "%ld of %ld statements failed, first error: %s\n", executor->failed,
+                executor->failed + executor->completed, executor->error);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Statements still queued are dropped; call asyncExecutorDrain first to keep them
+void asyncExecutorClose(AsyncExecutor *executor) {
+    int i;
+    for (i = 0; i < executor->count; i++) {
+        AsyncConnection *slot = &executor->connections[i];
+        while (slot->head != NULL) {
+            AsyncStatement *next = slot->head->next;
+            free(slot->head);
+            slot->head = next;
+        }
+        mysql_close(slot->connection);
+    }
+#if ASYNC_DB_IO
+    if (executor->epollFd >= 0) {
+        close(executor->epollFd);
+    }
+#endif
+    free(executor->connections);
+    executor->connections = NULL;
+    executor->count = 0;
+    executor->pending = 0;
+}
+
+void sleepMicroseconds(long microseconds) {
+    #ifdef _WIN32
+        Sleep(microseconds >= 1000 ? microseconds / 1000 : 1);
+    #else
+        usleep(microseconds);
+    #endif
+}
+
+int spscQueueInit(SpscQueue *queue, size_t capacity) {
+    queue->items = calloc(capacity, sizeof(void *));
+    if (queue->items == NULL) {
+        fprintf(stderr, "Memory allocation failed for work queue.\n");
+        return EXIT_FAILURE;
+    }
+    queue->capacity = capacity;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    return EXIT_SUCCESS;
+}
+
+void spscQueueFree(SpscQueue *queue) {
+    free(queue->items);
+    queue->items = NULL;
+}
+
+// Single-producer push; returns 0 when the queue is full
+int spscQueuePush(SpscQueue *queue, void *item) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head == queue->capacity) {
+        return 0;
+    }
+    queue->items[tail & (queue->capacity - 1)] = item;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+// Single-consumer pop; returns NULL when the queue is empty
+void *spscQueuePop(SpscQueue *queue) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail) {
+        return NULL;
+    }
+    void *item = queue->items[head & (queue->capacity - 1)];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return item;
+}
+
+size_t spscQueueDepth(SpscQueue *queue) {
+    return atomic_load_explicit(&queue->tail, memory_order_acquire) -
+           atomic_load_explicit(&queue->head, memory_order_acquire);
+}
+
+// Reserves a slot for an entity whose database id a writer will fill in later
+int entityIdTableAdd(EntityIdTable *table) {
+    int slot = table->count;
+    int page = slot / ENTITY_PAGE_SIZE;
+    if (page >= ENTITY_MAX_PAGES) {
+        fprintf(stderr, "Too many distinct keys for the ingest pipeline.\n");
+        return -1;
+    }
+    if (table->pages[page] == NULL) {
+        table->pages[page] = calloc(ENTITY_PAGE_SIZE, sizeof(int));
+        if (table->pages[page] == NULL) {
+            fprintf(stderr, "Memory allocation failed for entity table.\n");
+            return -1;
+        }
+    }
+    table->count++;
+    return slot;
+}
+
+int *entityIdTableSlot(EntityIdTable *table, int slot) {
+    return &table->pages[slot / ENTITY_PAGE_SIZE][slot % ENTITY_PAGE_SIZE];
+}
+
+void entityIdTableFree(EntityIdTable *table) {
+    int i;
+    for (i = 0; i < ENTITY_MAX_PAGES && table->pages[i]; i++) {
+        free(table->pages[i]);
+    }
+    free(table);
+}
+
+IngestWorkItem *ingestWorkItemCreate(IngestItemKind kind, int capacity) {
+    IngestWorkItem *item = calloc(1, sizeof(IngestWorkItem));
+    if (item == NULL) {
+        return NULL;
+    }
+    item->kind = kind;
+    item->capacity = capacity;
+    if (kind == INGEST_ITEM_ENROLLMENTS) {
+        item->pairs = malloc(sizeof(int) * 2 * capacity);
+    } else {
+        item->rows = malloc(sizeof(StagedEnrollment) * capacity);
+        item->slots = malloc(sizeof(int) * capacity);
+    }
+    if ((kind == INGEST_ITEM_ENROLLMENTS && item->pairs == NULL) ||
+        (kind != INGEST_ITEM_ENROLLMENTS && (item->rows == NULL || item->slots == NULL))) {
+        ingestWorkItemFree(item);
+        return NULL;
+    }
+    return item;
+}
+
+void ingestWorkItemFree(IngestWorkItem *item) {
+    if (item == NULL) {
+        return;
+    }
+    free(item->rows);
+    free(item->slots);
+    free(item->pairs);
+    stringPoolFree(&item->strings);
+    free(item);
+}
+
+// Hands an item to its writer, waiting while that writer's queue is full
+int ingestPipelinePush(IngestPipeline *pipeline, int writer, IngestWorkItem *item) {
+    atomic_fetch_add(&pipeline->itemsPushed, 1);
+    while (!spscQueuePush(&pipeline->writers[writer].queue, item)) {
+        if (atomic_load(&pipeline->failed)) {
+            atomic_fetch_add(&pipeline->itemsDone, 1);
+            ingestWorkItemFree(item);
+            return EXIT_FAILURE;
+        }
+        sleepMicroseconds(50);
+    }
+    return EXIT_SUCCESS;
+}
+
+// Writes one work item on the writer's own connection
+int ingestWriterProcess(IngestWriter *writer, IngestWorkItem *item) {
+    IngestPipeline *pipeline = writer->pipeline;
+    KeyIdTable table = {0};
+    int status, i;
+
+    if (item->kind == INGEST_ITEM_ENROLLMENTS) {
+        return insertEnrollmentPairs(writer->connection, item->pairs, item->count);
+    }
+
+    // Every key in an entity item is new and owned by this writer's partition
+    if (buildKeyIdTable(&table, item->rows, item->count, item->kind == INGEST_ITEM_SUBJECTS, NULL) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    status = (item->kind == INGEST_ITEM_SUBJECTS)
+             ? insertSubjectKeys(writer->connection, &table)
+             : insertStudentKeys(writer->connection, &table);
+
+    if (status == EXIT_SUCCESS) {
+        EntityIdTable *ids = (item->kind == INGEST_ITEM_SUBJECTS) ? pipeline->subjectIds : pipeline->studentIds;
+        for (i = 0; i < table.count; i++) {
+            int slot = item->slots[table.entries[i].row - item->rows];
+            *entityIdTableSlot(ids, slot) = table.entries[i].id;
+        }
+    }
+    free(table.entries);
+    return status;
+}
+
+void *ingestWriterThread(void *arg) {
+    IngestWriter *writer = arg;
+    IngestPipeline *pipeline = writer->pipeline;
+
+    mysql_thread_init();
+    mysql_autocommit(writer->connection, 0);
+    while (1) {
+        IngestWorkItem *item = spscQueuePop(&writer->queue);
+        if (item == NULL) {
+            if (atomic_load(&pipeline->parserDone) && spscQueueDepth(&writer->queue) == 0) {
+                break;
+            }
+            sleepMicroseconds(50);
+            continue;
+        }
+
+        if (!atomic_load(&pipeline->failed)) {
+            double start = getCurrentTimeSeconds();
+            int attempt, status = EXIT_FAILURE;
+            char error[512] = "";
+            // An item can span several statements, so each attempt is one transaction and a
+            // deadlock victim is rolled back in full before it retries
+            for (attempt = 0; attempt < 3 && status == EXIT_FAILURE; attempt++) {
+                status = ingestWriterProcess(writer, item);
+                if (status == EXIT_SUCCESS && dbCommit(writer->connection, QUERY_INGEST_WRITE)) {
+                    status = EXIT_FAILURE;
+                }
+                if (status == EXIT_FAILURE) {
+                    unsigned int errorCode = mysql_errno(writer->connection);
+                    snprintf(error, sizeof(error), "%s", mysql_error(writer->connection));
+                    mysql_rollback(writer->connection);
+                    if (errorCode != 1213) {
+                        break;
+                    }
+                }
+            }
+            if (status == EXIT_FAILURE) {
+                fprintf(stderr, "Writer %d failed: %s\n", writer->index, error);
+                atomic_store(&pipeline->failed, 1);
+            } else {
+                atomic_fetch_add(&writer->rowsWritten, item->count);
+                atomic_fetch_add(&writer->itemsProcessed, 1);
+            }
+            atomic_fetch_add(&writer->busyMicroseconds, (long)((getCurrentTimeSeconds() - start) * 1e6));
+        }
+        ingestWorkItemFree(item);
+        atomic_fetch_add(&pipeline->itemsDone, 1);
+    }
+    mysql_autocommit(writer->connection, 1);
+    mysql_thread_end();
+    return NULL;
+}
+
+// Adds a new entity to its partition's pending item, pushing the item when it fills up
+int ingestStageEntity(IngestPipeline *pipeline, IngestWorkItem **pending, IngestItemKind kind,
+                      const StagedEnrollment *row, int slot) {
+    const char *key = (kind == INGEST_ITEM_SUBJECTS) ? row->subject : row->symbol_number;
+    int writer = (int)(hashKey(key, strlen(key)) % pipeline->writerCount);
+
+    if (pending[writer] == NULL) {
+        pending[writer] = ingestWorkItemCreate(kind, pipeline->batchSize);
+        if (pending[writer] == NULL) {
+            fprintf(stderr, "Memory allocation failed for work item.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    IngestWorkItem *item = pending[writer];
+    StagedEnrollment *copy = &item->rows[item->count];
+    memset(copy, 0, sizeof(*copy));
+    if (kind == INGEST_ITEM_SUBJECTS) {
+        copy->subject = stringPoolCopy(&item->strings, row->subject);
+        if (copy->subject == NULL) return EXIT_FAILURE;
+    } else {
+        copy->symbol_number = stringPoolCopy(&item->strings, row->symbol_number);
+        copy->name = stringPoolCopy(&item->strings, row->name);
+        copy->college_name = stringPoolCopy(&item->strings, row->college_name);
+        if (!copy->symbol_number || !copy->name || !copy->college_name) return EXIT_FAILURE;
+    }
+    item->slots[item->count++] = slot;
+
+    if (item->count == item->capacity) {
+        pending[writer] = NULL;
+        return ingestPipelinePush(pipeline, writer, item);
+    }
+    return EXIT_SUCCESS;
+}
+
+int ingestFlushPending(IngestPipeline *pipeline, IngestWorkItem **pending) {
+    int i, status = EXIT_SUCCESS;
+    for (i = 0; i < pipeline->writerCount; i++) {
+        if (pending[i]) {
+            if (ingestPipelinePush(pipeline, i, pending[i]) == EXIT_FAILURE) {
+                status = EXIT_FAILURE;
+            }
+            pending[i] = NULL;
+        }
+    }
+    return status;
+}
+
+// Dictionary value for a key: > 0 is a database id, < 0 is -(slot + 1) of a pending entity
+int ingestResolveRef(IngestPipeline *pipeline, IdDictionary *dict, EntityIdTable *ids,
+                     IngestWorkItem **pending, IngestItemKind kind, const StagedEnrollment *row) {
+    const char *key = (kind == INGEST_ITEM_SUBJECTS) ? row->subject : row->symbol_number;
+    size_t length = strlen(key);
+    int ref = idDictionaryFind(dict, key, length);
+    if (ref != 0) {
+        return ref;
+    }
+
+    int slot = entityIdTableAdd(ids);
+    if (slot < 0 ||
+        idDictionaryPut(dict, key, length, -(slot + 1)) == EXIT_FAILURE ||
+        ingestStageEntity(pipeline, pending, kind, row, slot) == EXIT_FAILURE) {
+        return 0;
+    }
+    return -(slot + 1);
+}
+
+int ingestRefToId(EntityIdTable *ids, int ref) {
+    return ref > 0 ? ref : *entityIdTableSlot(ids, -ref - 1);
+}
+
+// Producer: parses the CSV, queues new students/subjects partitioned by key hash, waits for
+// them to be written, then queues the enrollments partitioned by student so that each
+// student's subjects are inserted in file order by a single writer
+void *ingestParserThread(void *arg) {
+    IngestPipeline *pipeline = arg;
+    // Separate pending items per kind; students and subjects never share a work item
+    IngestWorkItem **pending = calloc(pipeline->writerCount, sizeof(IngestWorkItem *));
+    IngestWorkItem **pendingSubjects = calloc(pipeline->writerCount, sizeof(IngestWorkItem *));
+    int *refs = NULL;
+    size_t refCount = 0, refCapacity = 0;
+    CsvReader reader;
+    int readerOpen = 0;
+    size_t i;
+
+    if (pending == NULL || pendingSubjects == NULL) {
+        fprintf(stderr, "Memory allocation failed for ingest pipeline.\n");
+        goto fail;
+    }
+    if (csvReaderOpen(&reader, pipeline->filename) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not open CSV file\n");
+        goto fail;
+    }
+    readerOpen = 1;
+
+    // Stage 1: entities
+    CsvField fields[4];
+    int fieldCount;
+    char symbol_number[CSV_VALUE_MAX + 1], name[CSV_VALUE_MAX + 1], college_name[CSV_VALUE_MAX + 1];
+    char subject[CSV_VALUE_MAX + 1];
+    while ((fieldCount = csvReaderNextRecord(&reader, fields, 4)) > 0 && !atomic_load(&pipeline->failed)) {
+        if (fieldCount < 4) {
+            fprintf(stderr, "Skipping malformed CSV line %ld.\n", reader.line);
+            continue;
+        }
+        if (!csvRecordFits(fields)) {
+            fprintf(stderr, "Skipping CSV line %ld: a value is longer than %d characters.\n", reader.line,
+                    CSV_VALUE_MAX);
+            continue;
+        }
+        StagedEnrollment row = {symbol_number, name, college_name, subject};
+        csvFieldCopy(&fields[0], symbol_number, sizeof(symbol_number));
+        csvFieldCopy(&fields[1], name, sizeof(name));
+        csvFieldCopy(&fields[2], college_name, sizeof(college_name));
+
+        int studentRef = ingestResolveRef(pipeline, &pipeline->dict.students, pipeline->studentIds,
+                                          pending, INGEST_ITEM_STUDENTS, &row);
+        if (studentRef == 0) goto fail;
+
+        size_t subjectOffset = 0;
+        CsvField subjectField;
+        while (csvNextSubfield(&fields[3], ';', &subjectOffset, &subjectField)) {
+            csvFieldCopy(&subjectField, subject, sizeof(subject));
+            int subjectRef = ingestResolveRef(pipeline, &pipeline->dict.subjects, pipeline->subjectIds,
+                                              pendingSubjects, INGEST_ITEM_SUBJECTS, &row);
+            if (subjectRef == 0) goto fail;
+
+            if (refCount == refCapacity) {
+                size_t capacity = refCapacity ? refCapacity * 2 : 65536;
+                int *grown = realloc(refs, sizeof(int) * 2 * capacity);
+                if (grown == NULL) {
+                    fprintf(stderr, "Memory allocation failed for enrollment rows.\n");
+                    goto fail;
+                }
+                refs = grown;
+                refCapacity = capacity;
+            }
+            refs[2 * refCount] = studentRef;
+            refs[2 * refCount + 1] = subjectRef;
+            refCount++;
+        }
+    }
+    pipeline->csvRows = refCount;
+    if (atomic_load(&pipeline->failed) ||
+        ingestFlushPending(pipeline, pending) == EXIT_FAILURE ||
+        ingestFlushPending(pipeline, pendingSubjects) == EXIT_FAILURE) {
+        goto fail;
+    }
+
+    // Barrier: every pending entity id must be known before enrollments can be written
+    while (atomic_load(&pipeline->itemsDone) < atomic_load(&pipeline->itemsPushed)) {
+        sleepMicroseconds(200);
+    }
+    if (atomic_load(&pipeline->failed)) goto fail;
+
+    // Stage 2: enrollments
+    for (i = 0; i < refCount; i++) {
+        int student_id = ingestRefToId(pipeline->studentIds, refs[2 * i]);
+        int subject_id = ingestRefToId(pipeline->subjectIds, refs[2 * i + 1]);
+
+        int added = pairSetInsert(&pipeline->dict.enrollments, student_id, subject_id);
+        if (added < 0) goto fail;
+        if (added == 0) continue;
+
+        int writer = student_id % pipeline->writerCount;
+        if (pending[writer] == NULL) {
+            pending[writer] = ingestWorkItemCreate(INGEST_ITEM_ENROLLMENTS, pipeline->batchSize);
+            if (pending[writer] == NULL) {
+                fprintf(stderr, "Memory allocation failed for work item.\n");
+                goto fail;
+            }
+        }
+        IngestWorkItem *item = pending[writer];
+        item->pairs[2 * item->count] = student_id;
+        item->pairs[2 * item->count + 1] = subject_id;
+        item->count++;
+        pipeline->insertedRows++;
+
+        if (item->count == item->capacity) {
+            pending[writer] = NULL;
+            if (ingestPipelinePush(pipeline, writer, item) == EXIT_FAILURE) goto fail;
+        }
+    }
+    if (ingestFlushPending(pipeline, pending) == EXIT_FAILURE) goto fail;
+    goto done;
+
+fail:
+    atomic_store(&pipeline->failed, 1);
+    if (pending && pendingSubjects) {
+        int w;
+        for (w = 0; w < pipeline->writerCount; w++) {
+            ingestWorkItemFree(pending[w]);
+            ingestWorkItemFree(pendingSubjects[w]);
+        }
+    }
+
+done:
+    if (readerOpen) csvReaderClose(&reader);
+    free(refs);
+    free(pending);
+    free(pendingSubjects);
+    atomic_store(&pipeline->parserDone, 1);
+    return NULL;
+}
+
+// Parallel ingest: one parser thread feeding writerCount writers, each with its own connection
+int parallelInsertCSV(const char *filename, int writerCount, int batchSize) {
+    IngestPipeline pipeline;
+    ConnectionPool pool = {0};
+    pthread_t parser;
+    int started = 0, status = EXIT_FAILURE;
+    int i;
+
+    if (writerCount < 1) writerCount = 1;
+    if (writerCount > MAX_INGEST_WRITERS) writerCount = MAX_INGEST_WRITERS;
+
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.filename = filename;
+    pipeline.writerCount = writerCount;
+    pipeline.batchSize = batchSize;
+    atomic_init(&pipeline.itemsPushed, 0);
+    atomic_init(&pipeline.itemsDone, 0);
+    atomic_init(&pipeline.parserDone, 0);
+    atomic_init(&pipeline.failed, 0);
+
+    pipeline.writers = calloc(writerCount, sizeof(IngestWriter));
+    pipeline.studentIds = calloc(1, sizeof(EntityIdTable));
+    pipeline.subjectIds = calloc(1, sizeof(EntityIdTable));
+    if (pipeline.writers == NULL || pipeline.studentIds == NULL || pipeline.subjectIds == NULL) {
+        fprintf(stderr, "Memory allocation failed for ingest pipeline.\n");
+        goto cleanup;
+    }
+    if (loadIngestDictionary(conn, &pipeline.dict) == EXIT_FAILURE) {
+        goto cleanup;
+    }
+    if (connectionPoolOpen(&pool, writerCount) == EXIT_FAILURE) {
+        freeIngestDictionary(&pipeline.dict);
+        goto cleanup;
+    }
+
+    for (i = 0; i < writerCount; i++) {
+        IngestWriter *writer = &pipeline.writers[i];
+        writer->index = i;
+        writer->connection = pool.connections[i];
+        writer->pipeline = &pipeline;
+        atomic_init(&writer->rowsWritten, 0);
+        atomic_init(&writer->itemsProcessed, 0);
+        atomic_init(&writer->busyMicroseconds, 0);
+        if (spscQueueInit(&writer->queue, INGEST_QUEUE_CAPACITY) == EXIT_FAILURE) {
+            atomic_store(&pipeline.failed, 1);
+            break;
+        }
+    }
+
+    double startTime = getCurrentTimeSeconds();
+    if (!atomic_load(&pipeline.failed)) {
+        for (started = 0; started < writerCount; started++) {
+            if (pthread_create(&pipeline.writers[started].thread, NULL, ingestWriterThread, &pipeline.writers[started])) {
+                fprintf(stderr, "Could not start writer thread.\n");
+                atomic_store(&pipeline.failed, 1);
+                break;
+            }
+        }
+    }
+    if (started == writerCount && pthread_create(&parser, NULL, ingestParserThread, &pipeline) == 0) {
+        // Monitor: sample queue depths and report progress once a second
+        double lastReport = startTime;
+        while (!atomic_load(&pipeline.parserDone) ||
+               atomic_load(&pipeline.itemsDone) < atomic_load(&pipeline.itemsPushed)) {
+            sleepMicroseconds(100000);
+            size_t depth = 0;
+            for (i = 0; i < writerCount; i++) {
+                size_t writerDepth = spscQueueDepth(&pipeline.writers[i].queue);
+                if (writerDepth > pipeline.writers[i].maxDepth) {
+                    pipeline.writers[i].maxDepth = writerDepth;
+                }
+                depth += writerDepth;
+            }
+            double now = getCurrentTimeSeconds();
+            if (now - lastReport >= 1.0) {
+                long written = 0;
+                for (i = 0; i < writerCount; i++) {
+                    written += atomic_load(&pipeline.writers[i].rowsWritten);
+                }
+                printf("  %.0fs: %ld rows written, queue depth %zu\n", now - startTime, written, depth);
+                lastReport = now;
+            }
+        }
+        pthread_join(parser, NULL);
+    } else {
+        atomic_store(&pipeline.failed, 1);
+        atomic_store(&pipeline.parserDone, 1);
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(pipeline.writers[i].thread, NULL);
+    }
+    double elapsed = getCurrentTimeSeconds() - startTime;
+
+    status = atomic_load(&pipeline.failed) ? EXIT_FAILURE : EXIT_SUCCESS;
+    if (status == EXIT_SUCCESS) {
+        metricsRecordPhase(PHASE_INGEST, elapsed);
+        printf("\nCSV data inserted successfully by %d writers.\n", writerCount);
+    }
+    printf("Processed %ld CSV rows in %.2f s (%.0f rows/s); inserted %ld new enrollments.\n",
+           pipeline.csvRows, elapsed, elapsed > 0 ? pipeline.csvRows / elapsed : 0.0, pipeline.insertedRows);
+    printf("Writer | Items | Rows written | Busy (s) | Rows/s | Max queue depth\n");
+    printf("-------------------------------------------------------------------\n");
+    for (i = 0; i < writerCount; i++) {
+        IngestWriter *writer = &pipeline.writers[i];
+        double busy = atomic_load(&writer->busyMicroseconds) / 1e6;
+        long rows = atomic_load(&writer->rowsWritten);
+        printf("%-6d | %5ld | %12ld | %8.2f | %6.0f | %zu\n", i, atomic_load(&writer->itemsProcessed),
+               rows, busy, busy > 0 ? rows / busy : 0.0, writer->maxDepth);
+    }
+
+    freeIngestDictionary(&pipeline.dict);
+    connectionPoolClose(&pool);
+
+cleanup:
+    if (pipeline.writers) {
+        for (i = 0; i < writerCount; i++) {
+            spscQueueFree(&pipeline.writers[i].queue);
+        }
+        free(pipeline.writers);
+    }
+    if (pipeline.studentIds) entityIdTableFree(pipeline.studentIds);
+    if (pipeline.subjectIds) entityIdTableFree(pipeline.subjectIds);
+    return status;
+}
+
+// ==== Delta ingest ====
+
+// Continues an FNV-1a hash over a field, unescaping "" pairs on the fly
+uint64_t hashField(uint64_t hash, const CsvField *field) {
+    size_t i;
+    for (i = 0; i < field->length; i++) {
+        if (field->escaped && field->data[i] == '"' && i + 1 < field->length && field->data[i + 1] == '"') {
+            i++;
+        }
+        hash ^= (unsigned char)field->data[i];
+        hash *= 1099511628211ULL;
+    }
+    // Field separator so ("ab","c") and ("a","bc") differ
+    hash ^= 0x1f;
+    hash *= 1099511628211ULL;
+    return hash;
+}
+
+// Final avalanche so the top bits (used as bucket numbers) are well mixed
+uint64_t mixHash(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+int compareDeltaRows(const void *a, const void *b) {
+    const DeltaRow *x = a, *y = b;
+    if (x->identity != y->identity) return x->identity < y->identity ? -1 : 1;
+    if (x->recordOffset != y->recordOffset) return x->recordOffset < y->recordOffset ? -1 : 1;
+    return (x->subjectOffset > y->subjectOffset) - (x->subjectOffset < y->subjectOffset);
+}
+
+int compareDeltaRowsByPosition(const void *a, const void *b) {
+    const DeltaRow *x = *(const DeltaRow * const *)a, *y = *(const DeltaRow * const *)b;
+    if (x->recordOffset != y->recordOffset) return x->recordOffset < y->recordOffset ? -1 : 1;
+    return (x->subjectOffset > y->subjectOffset) - (x->subjectOffset < y->subjectOffset);
+}
+
+// Order-independent chunk hash: rows are combined in identity order, not file order
+void computeBucketHashes(const DeltaRow *rows, size_t count, ManifestBucket *buckets) {
+    size_t i;
+    memset(buckets, 0, sizeof(ManifestBucket) * DELTA_BUCKET_COUNT);
+    for (i = 0; i < count; i++) {
+        ManifestBucket *bucket = &buckets[DELTA_BUCKET(rows[i].identity)];
+        if (bucket->rowCount == 0) {
+            bucket->firstRow = i;
+        }
+        bucket->chunkHash = mixHash(bucket->chunkHash ^ rows[i].identity) + rows[i].content;
+        bucket->rowCount++;
+    }
+}
+
+// Reads every record into compact identity/content hashes, sorted by identity with duplicates removed
+int scanDeltaRows(CsvReader *reader, DeltaRow **rowsOut, size_t *countOut) {
+    DeltaRow *rows = NULL;
+    size_t count = 0, capacity = 0, i;
+    CsvField fields[4];
+    int fieldCount;
+
+    while (1) {
+        size_t recordOffset = reader->position;
+        fieldCount = csvReaderNextRecord(reader, fields, 4);
+        if (fieldCount <= 0) {
+            break;
+        }
+        if (fieldCount < 4) {
+            fprintf(stderr, "Skipping malformed CSV line %ld.\n", reader->line);
+            continue;
+        }
+
+        uint64_t symbolHash = hashField(14695981039346656037ULL, &fields[0]);
+        uint64_t content = mixHash(hashField(hashField(14695981039346656037ULL, &fields[1]), &fields[2]));
+
+        size_t subjectOffset = 0;
+        CsvField subject;
+        while (csvNextSubfield(&fields[3], ';', &subjectOffset, &subject)) {
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 65536;
+                DeltaRow *grown = realloc(rows, sizeof(DeltaRow) * capacity);
+                if (grown == NULL) {
+                    fprintf(stderr, "Memory allocation failed for delta rows.\n");
+                    free(rows);
+                    return EXIT_FAILURE;
+                }
+                rows = grown;
+            }
+            DeltaRow *row = &rows[count++];
+            row->identity = mixHash(hashField(symbolHash, &subject));
+            row->content = content;
+            row->recordOffset = recordOffset;
+            row->subjectOffset = (uint32_t)(subject.data - (reader->data + recordOffset));
+            row->subjectLength = (uint32_t)subject.length;
+        }
+    }
+
+    qsort(rows, count, sizeof(DeltaRow), compareDeltaRows);
+    size_t unique = 0;
+    for (i = 0; i < count; i++) {
+        if (unique == 0 || rows[unique - 1].identity != rows[i].identity) {
+            rows[unique++] = rows[i];
+        }
+    }
+
+    *rowsOut = rows;
+    *countOut = unique;
+    return EXIT_SUCCESS;
+}
+
+// Re-parses the record a delta row came from and copies its values into the pool
+int materializeDeltaRow(CsvReader *reader, const DeltaRow *row, StringPool *pool, StagedEnrollment *out) {
+    CsvField fields[4];
+    reader->position = row->recordOffset;
+    if (csvReaderNextRecord(reader, fields, 4) < 4) {
+        return EXIT_FAILURE;
+    }
+
+    CsvField subject = {reader->data + row->recordOffset + row->subjectOffset, row->subjectLength, fields[3].escaped};
+    out->symbol_number = stringPoolCopyField(pool, &fields[0]);
+    out->name = stringPoolCopyField(pool, &fields[1]);
+    out->college_name = stringPoolCopyField(pool, &fields[2]);
+    out->subject = stringPoolCopyField(pool, &subject);
+    return (out->symbol_number && out->name && out->college_name && out->subject) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Loads a manifest written by a previous delta ingest; a missing or foreign file yields an empty manifest
+int loadManifest(const char *path, Manifest *manifest) {
+    memset(manifest, 0, sizeof(*manifest));
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return EXIT_SUCCESS;
+    }
+
+    ManifestHeader header;
+    int valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                memcmp(header.magic, DELTA_MANIFEST_MAGIC, sizeof(header.magic)) == 0 &&
+                header.version == DELTA_MANIFEST_VERSION && header.bucketCount == DELTA_BUCKET_COUNT &&
+                header.rowCount <= SIZE_MAX / sizeof(ManifestRow) && header.stringBytes <= SIZE_MAX;
+    if (valid) {
+        manifest->buckets = malloc(sizeof(ManifestBucket) * DELTA_BUCKET_COUNT);
+        manifest->rows = malloc(sizeof(ManifestRow) * (header.rowCount ? header.rowCount : 1));
+        manifest->strings = malloc(header.stringBytes ? header.stringBytes : 1);
+        valid = manifest->buckets && manifest->rows && manifest->strings &&
+                fread(manifest->buckets, sizeof(ManifestBucket), DELTA_BUCKET_COUNT, file) == DELTA_BUCKET_COUNT &&
+                fread(manifest->rows, sizeof(ManifestRow), header.rowCount, file) == header.rowCount &&
+                fread(manifest->strings, 1, header.stringBytes, file) == header.stringBytes;
+        manifest->rowCount = header.rowCount;
+        manifest->stringBytes = header.stringBytes;
+        manifest->databaseRows = header.databaseRows;
+    }
+
+    // Reject manifests whose offsets point outside their own tables
+    uint64_t i;
+    for (i = 0; valid && i < DELTA_BUCKET_COUNT; i++) {
+        valid = manifest->buckets[i].rowCount <= manifest->rowCount &&
+                manifest->buckets[i].firstRow <= manifest->rowCount - manifest->buckets[i].rowCount;
+    }
+    if (valid && manifest->rowCount > 0) {
+        // Every row has strings, and the table must end in a terminator for strlen to stop inside it
+        valid = manifest->stringBytes > 0 && manifest->strings[manifest->stringBytes - 1] == '\0';
+    }
+    for (i = 0; valid && i < manifest->rowCount; i++) {
+        valid = manifest->rows[i].stringOffset < manifest->stringBytes &&
+                manifest->rows[i].stringOffset + strlen(manifest->strings + manifest->rows[i].stringOffset) + 1 <
+                    manifest->stringBytes;
+    }
+    fclose(file);
+
+    if (!valid) {
+        fprintf(stderr, "Ignoring unreadable manifest %s; all rows will be treated as new.\n", path);
+        freeManifest(manifest);
+    }
+    return EXIT_SUCCESS;
+}
+
+void freeManifest(Manifest *manifest) {
+    free(manifest->buckets);
+    free(manifest->rows);
+    free(manifest->strings);
+    memset(manifest, 0, sizeof(*manifest));
+}
+
+// Writes the manifest for the rows just ingested; written to a temporary file and renamed into place
+int writeManifest(const char *path, CsvReader *reader, const DeltaRow *rows, size_t count,
+                  const ManifestBucket *buckets, uint64_t databaseRows) {
+    char tempPath[1024];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    FILE *file = fopen(tempPath, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not write manifest %s\n", tempPath);
+        return EXIT_FAILURE;
+    }
+
+    ManifestRow *manifestRows = malloc(sizeof(ManifestRow) * (count ? count : 1));
+    SqlBuffer strings = {0};
+    size_t i;
+    int status = manifestRows ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    for (i = 0; i < count && status == EXIT_SUCCESS; i++) {
+        CsvField fields[4];
+        reader->position = rows[i].recordOffset;
+        if (csvReaderNextRecord(reader, fields, 4) < 4) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        CsvField subject = {reader->data + rows[i].recordOffset + rows[i].subjectOffset, rows[i].subjectLength,
+                            fields[3].escaped};
+
+        // symbol_number\0subject_name\0
+        manifestRows[i].identity = rows[i].identity;
+        manifestRows[i].content = rows[i].content;
+        manifestRows[i].stringOffset = strings.length;
+        if (sqlBufferReserve(&strings, fields[0].length + subject.length + 2) == EXIT_FAILURE) {
+            status = EXIT_FAILURE;
+            break;
+        }
+        strings.length += csvFieldCopy(&fields[0], strings.data + strings.length, fields[0].length + 1) + 1;
+        strings.length += csvFieldCopy(&subject, strings.data + strings.length, subject.length + 1) + 1;
+    }
+
+    if (status == EXIT_SUCCESS) {
+        ManifestHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, DELTA_MANIFEST_MAGIC, sizeof(header.magic));
+        header.version = DELTA_MANIFEST_VERSION;
+        header.bucketCount = DELTA_BUCKET_COUNT;
+        header.rowCount = count;
+        header.stringBytes = strings.length;
+        header.databaseRows = databaseRows;
+        if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+            fwrite(buckets, sizeof(ManifestBucket), DELTA_BUCKET_COUNT, file) != DELTA_BUCKET_COUNT ||
+            fwrite(manifestRows, sizeof(ManifestRow), count, file) != count ||
+            fwrite(strings.data ? strings.data : "", 1, strings.length, file) != strings.length) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    if (fclose(file) != 0) {
+        status = EXIT_FAILURE;
+    }
+    free(manifestRows);
+    sqlBufferFree(&strings);
+
+    if (status == EXIT_FAILURE) {
+        fprintf(stderr, "Could not write manifest %s\n", tempPath);
+        remove(tempPath);
+        return EXIT_FAILURE;
+    }
+#ifdef _WIN32
+    remove(path); // rename() does not replace existing files on Windows
+#endif
+    if (rename(tempPath, path) != 0) {
+        fprintf(stderr, "Could not replace manifest %s\n", path);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Result handler that records existing (student_id, subject_id) pairs
+int storeEnrollmentPairsResult(MYSQL_RES *result, void *context) {
+    PairSet *set = context;
+    MYSQL_ROW pairRow;
+    while ((pairRow = dbFetchRow(result, QUERY_ID_LOOKUP))) {
+        if (pairSetInsert(set, atoi(pairRow[0]), atoi(pairRow[1])) < 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// Applies the changed rows in one transaction. Only the keys that appear in the delta are
+// looked up, so the server work is proportional to the change, not to the file.
+int applyDelta(MYSQL *connection, StagedEnrollment *added, int addedCount,
+               StagedEnrollment *removed, int removedCount,
+               StagedEnrollment *updated, int updatedCount, long *insertedRows, long *deletedRows) {
+    IngestDictionary dict;
+    KeyIdTable students = {0}, subjects = {0};
+    StagedEnrollment *all = NULL;
+    SqlBatch batch = {0};
+    int total = addedCount + removedCount + updatedCount;
+    int status = EXIT_FAILURE;
+    int i;
+
+    memset(&dict, 0, sizeof(dict));
+    if (idDictionaryInit(&dict.students, total) == EXIT_FAILURE ||
+        idDictionaryInit(&dict.subjects, total) == EXIT_FAILURE ||
+        pairSetInit(&dict.enrollments, total) == EXIT_FAILURE) {
+        goto cleanup;
+    }
+
+    all = malloc(sizeof(StagedEnrollment) * (total > 0 ? total : 1));
+    if (all == NULL) {
+        fprintf(stderr, "Memory allocation failed for delta rows.\n");
+        goto cleanup;
+    }
+    memcpy(all, added, sizeof(StagedEnrollment) * addedCount);
+    memcpy(all + addedCount, removed, sizeof(StagedEnrollment) * removedCount);
+    memcpy(all + addedCount + removedCount, updated, sizeof(StagedEnrollment) * updatedCount);
+
+    // Ids of existing students and subjects touched by the delta
+    if (buildKeyIdTable(&students, all, total, 0, NULL) == EXIT_FAILURE ||
+        buildKeyIdTable(&subjects, all, addedCount + removedCount, 1, NULL) == EXIT_FAILURE ||
+        selectKeyIds(connection, &students, 0) == EXIT_FAILURE ||
+        selectKeyIds(connection, &subjects, 1) == EXIT_FAILURE) {
+        goto cleanup;
+    }
+    for (i = 0; i < students.count; i++) {
+        if (students.entries[i].id &&
+            idDictionaryPut(&dict.students, students.entries[i].key, strlen(students.entries[i].key),
+                            students.entries[i].id) == EXIT_FAILURE) {
+            goto cleanup;
+        }
+    }
+    for (i = 0; i < subjects.count; i++) {
+        if (subjects.entries[i].id &&
+            idDictionaryPut(&dict.subjects, subjects.entries[i].key, strlen(subjects.entries[i].key),
+                            subjects.entries[i].id) == EXIT_FAILURE) {
+            goto cleanup;
+        }
+    }
+
+    // Existing enrollments of those students, so re-added pairs are not duplicated
+    batch.connection = connection;
+    batch.prefix = "SELECT student_id, subject_id FROM student_subjects WHERE student_id IN (";
+    batch.suffix = ")";
+    batch.onResult = storeEnrollmentPairsResult;
+    batch.kind = QUERY_ID_LOOKUP;
+    batch.context = &dict.enrollments;
+    for (i = 0; i < students.count; i++) {
+        if (students.entries[i].id == 0) {
+            continue;
+        }
+        char value[16];
+        snprintf(value, sizeof(value), "%d", students.entries[i].id);
+        if (sqlBatchBeginRow(&batch) || sqlBufferAppend(&batch.buffer, value) || sqlBatchEndRow(&batch)) {
+            goto cleanup;
+        }
+    }
+    if (sqlBatchFlush(&batch)) goto cleanup;
+
+    if (mysql_autocommit(connection, 0)) {
+        fprintf(stderr, "Could not start transaction: %s\n", mysql_error(connection));
+        goto cleanup;
+    }
+
+    if (addedCount > 0 && flushBulkBatch(connection, &dict, added, addedCount, insertedRows) == EXIT_FAILURE) {
+        goto rollback;
+    }
+
+    batch.prefix = "DELETE FROM student_subjects WHERE (student_id, subject_id) IN (";
+    batch.onResult = NULL;
+    batch.kind = QUERY_INGEST_WRITE;
+    batch.context = NULL;
+    for (i = 0; i < removedCount; i++) {
+        int student_id = idDictionaryFind(&dict.students, removed[i].symbol_number, strlen(removed[i].symbol_number));
+        int subject_id = idDictionaryFind(&dict.subjects, removed[i].subject, strlen(removed[i].subject));
+        if (student_id == 0 || subject_id == 0 || !pairSetContains(&dict.enrollments, student_id, subject_id)) {
+            continue; // Already gone from the database
+        }
+        char values[64];
+        snprintf(values, sizeof(values), "(%d,%d)", student_id, subject_id);
+        if (sqlBatchBeginRow(&batch) || sqlBufferAppend(&batch.buffer, values) || sqlBatchEndRow(&batch)) {
+            goto rollback;
+        }
+        (*deletedRows)++;
+    }
+    if (sqlBatchFlush(&batch)) goto rollback;
+
+    for (i = 0; i < updatedCount; i++) {
+        SqlBuffer update = {0};
+        int failed = sqlBufferAppend(&update, "UPDATE students SET name=") ||
+                     sqlBufferAppendEscaped(&update, connection, updated[i].name) ||
+                     sqlBufferAppend(&update, ", college_name=") ||
+                     sqlBufferAppendEscaped(&update, connection, updated[i].college_name) ||
+                     sqlBufferAppend(&update, " WHERE symbol_number=") ||
+                     sqlBufferAppendEscaped(&update, connection, updated[i].symbol_number);
+        if (!failed && dbRealQuery(connection, update.data, update.length, QUERY_INGEST_WRITE)) {
+            fprintf(stderr, "UPDATE failed: %s\n", mysql_error(connection));
+            failed = 1;
+        }
+        sqlBufferFree(&update);
+        if (failed) goto rollback;
+    }
+
+    if (dbCommit(connection, QUERY_INGEST_WRITE)) {
+        fprintf(stderr, "Commit failed: %s\n", mysql_error(connection));
+        goto rollback;
+    }
+    status = EXIT_SUCCESS;
+    goto restore;
+
+rollback:
+    mysql_rollback(connection);
+restore:
+    mysql_autocommit(connection, 1);
+cleanup:
+    sqlBufferFree(&batch.buffer);
+    free(students.entries);
+    free(subjects.entries);
+    free(all);
+    freeIngestDictionary(&dict);
+    return status;
+}
+
+// Delta ingest: compares the file against the manifest of the last ingest chunk by chunk
+// (a chunk is a hash bucket of rows, so reordering lines changes nothing) and applies
+// only added, removed and changed student-subject rows
+int deltaInsertCSV(const char *filename) {
+    char manifestPath[1024];
+    snprintf(manifestPath, sizeof(manifestPath), "%s.manifest", filename);
+
+    CsvReader reader;
+    if (csvReaderOpen(&reader, filename) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not open CSV file\n");
+        return EXIT_FAILURE;
+    }
+
+    double startTime = getCurrentTimeSeconds();
+    DeltaRow *rows = NULL;
+    size_t rowCount = 0, i;
+    ManifestBucket *buckets = malloc(sizeof(ManifestBucket) * DELTA_BUCKET_COUNT);
+    Manifest manifest = {0};
+    StringPool pool = {0};
+    const DeltaRow **addedRows = NULL;
+    StagedEnrollment *added = NULL, *removed = NULL, *updated = NULL;
+    int addedCount = 0, removedCount = 0, updatedCount = 0, changedBuckets = 0;
+    long insertedRows = 0, deletedRows = 0, databaseRows;
+    int status = EXIT_FAILURE;
+
+    if (buckets == NULL ||
+        scanDeltaRows(&reader, &rows, &rowCount) == EXIT_FAILURE ||
+        loadManifest(manifestPath, &manifest) == EXIT_FAILURE) {
+        goto cleanup;
+    }
+    computeBucketHashes(rows, rowCount, buckets);
+
+    // A reset or another writer changed the table since the manifest was written, so its
+    // rows can no longer be assumed present; applyDelta skips pairs that do still exist
+    databaseRows = queryCount("SELECT COUNT(*) FROM student_subjects");
+    if (databaseRows < 0) {
+        goto cleanup;
+    }
+    if (manifest.buckets != NULL && manifest.databaseRows != (uint64_t)databaseRows) {
+        printf("The database changed since the last delta ingest; treating every row as new.\n");
+        freeManifest(&manifest);
+    }
+
+    addedRows = malloc(sizeof(DeltaRow *) * (rowCount ? rowCount : 1));
+    updated = malloc(sizeof(StagedEnrollment) * (rowCount ? rowCount : 1));
+    removed = malloc(sizeof(StagedEnrollment) * (manifest.rowCount ? manifest.rowCount : 1));
+    if (addedRows == NULL || updated == NULL || removed == NULL) {
+        fprintf(stderr, "Memory allocation failed for delta rows.\n");
+        goto cleanup;
+    }
+
+    // Merge old and new rows of every chunk whose hash changed
+    int bucket;
+    for (bucket = 0; bucket < DELTA_BUCKET_COUNT; bucket++) {
+        const ManifestBucket *oldBucket = manifest.buckets ? &manifest.buckets[bucket] : NULL;
+        uint64_t oldCount = oldBucket ? oldBucket->rowCount : 0;
+        if (oldCount == buckets[bucket].rowCount &&
+            (oldCount == 0 || oldBucket->chunkHash == buckets[bucket].chunkHash)) {
+            continue;
+        }
+        changedBuckets++;
+
+        const ManifestRow *oldRows = oldCount ? &manifest.rows[oldBucket->firstRow] : NULL;
+        const DeltaRow *newRows = &rows[buckets[bucket].firstRow];
+        uint64_t newCount = buckets[bucket].rowCount, a = 0, b = 0;
+        while (a < oldCount || b < newCount) {
+            if (b == newCount || (a < oldCount && oldRows[a].identity < newRows[b].identity)) {
+                StagedEnrollment *row = &removed[removedCount++];
+                memset(row, 0, sizeof(*row));
+                row->symbol_number = manifest.strings + oldRows[a].stringOffset;
+                row->subject = row->symbol_number + strlen(row->symbol_number) + 1;
+                a++;
+            } else if (a == oldCount || newRows[b].identity < oldRows[a].identity) {
+                addedRows[addedCount++] = &newRows[b];
+                b++;
+            } else {
+                if (oldRows[a].content != newRows[b].content) {
+                    if (materializeDeltaRow(&reader, &newRows[b], &pool, &updated[updatedCount]) == EXIT_FAILURE) {
+                        goto cleanup;
+                    }
+                    updatedCount++;
+                }
+                a++;
+                b++;
+            }
+        }
+    }
+
+    // New rows go in file order so each student's subject order is preserved
+    qsort(addedRows, addedCount, sizeof(DeltaRow *), compareDeltaRowsByPosition);
+    added = malloc(sizeof(StagedEnrollment) * (addedCount ? addedCount : 1));
+    if (added == NULL) {
+        fprintf(stderr, "Memory allocation failed for delta rows.\n");
+        goto cleanup;
+    }
+    for (i = 0; i < (size_t)addedCount; i++) {
+        if (materializeDeltaRow(&reader, addedRows[i], &pool, &added[i]) == EXIT_FAILURE) {
+            goto cleanup;
+        }
+    }
+
+    if (addedCount + removedCount + updatedCount > 0 &&
+        applyDelta(conn, added, addedCount, removed, removedCount, updated, updatedCount,
+                   &insertedRows, &deletedRows) == EXIT_FAILURE) {
+        goto cleanup;
+    }
+    databaseRows = queryCount("SELECT COUNT(*) FROM student_subjects");
+    if (databaseRows < 0 ||
+        writeManifest(manifestPath, &reader, rows, rowCount, buckets, (uint64_t)databaseRows) == EXIT_FAILURE) {
+        goto cleanup;
+    }
+    status = EXIT_SUCCESS;
+
+    double elapsed = getCurrentTimeSeconds() - startTime;
+    metricsRecordPhase(PHASE_INGEST, elapsed);
+    printf("\nDelta ingest complete: %d of %d chunks changed.\n", changedBuckets, DELTA_BUCKET_COUNT);
+    printf("Rows in file: %zu, added: %d (%ld inserted), removed: %d (%ld deleted), updated: %d.\n",
+           rowCount, addedCount, insertedRows, removedCount, deletedRows, updatedCount);
+    printf("Finished in %.2f s (%.0f rows/s scanned).\n", elapsed, elapsed > 0 ? rowCount / elapsed : 0.0);
+
+cleanup:
+    csvReaderClose(&reader);
+    freeManifest(&manifest);
+    stringPoolFree(&pool);
+    free(rows);
+    free(buckets);
+    free(addedRows);
+    free(added);
+    free(removed);
+    free(updated);
+    return status;
+}
+
+// ==== CSV reader ====
+
+// Bitmask of the bytes in a 64-byte block equal to a, b or c (bit i = block[i])
+uint64_t csvClassifyBlockScalar(const char *block, char a, char b, char c) {
+    uint64_t mask = 0;
+    int i;
+    for (i = 0; i < 64; i++) {
+        if (block[i] == a || block[i] == b || block[i] == c) {
+            mask |= (uint64_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+#if CSV_HAVE_SSE2
+uint64_t csvClassifyBlockSSE2(const char *block, char a, char b, char c) {
+    const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b), vc = _mm_set1_epi8(c);
+    uint64_t mask = 0;
+    int i;
+    for (i = 0; i < 4; i++) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(block + i * 16));
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)),
+                                    _mm_cmpeq_epi8(chunk, vc));
+        mask |= (uint64_t)(unsigned)_mm_movemask_epi8(hits) << (i * 16);
+    }
+    return mask;
+}
+#endif
+
+#if CSV_HAVE_AVX2
+__attribute__((target("avx2")))
+uint64_t csvClassifyBlockAVX2(const char *block, char a, char b, char c) {
+    const __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b), vc = _mm256_set1_epi8(c);
+    __m256i lo = _mm256_loadu_si256((const __m256i *)block);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(block + 32));
+    __m256i hitsLo = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(lo, va), _mm256_cmpeq_epi8(lo, vb)),
+                                     _mm256_cmpeq_epi8(lo, vc));
+    __m256i hitsHi = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(hi, va), _mm256_cmpeq_epi8(hi, vb)),
+                                     _mm256_cmpeq_epi8(hi, vc));
+    return (uint64_t)(unsigned)_mm256_movemask_epi8(hitsLo) |
+           ((uint64_t)(unsigned)_mm256_movemask_epi8(hitsHi) << 32);
+}
+#endif
+
+// Classifies a block with the widest instruction set the CPU supports (checked once)
+uint64_t csvClassifyBlock(const char *block, char a, char b, char c) {
+#if CSV_HAVE_AVX2
+    static int useAVX2 = -1;
+    if (useAVX2 < 0) {
+        useAVX2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    if (useAVX2) {
+        return csvClassifyBlockAVX2(block, a, b, c);
+    }
+#endif
+#if CSV_HAVE_SSE2
+    return csvClassifyBlockSSE2(block, a, b, c);
+#else
+    return csvClassifyBlockScalar(block, a, b, c);
+#endif
+}
+
+// Returns the first occurrence of a, b or c in [p, end), or end if there is none
+const char *csvFindAny(const char *p, const char *end, char a, char b, char c) {
+    while (end - p >= 64) {
+        uint64_t mask = csvClassifyBlock(p, a, b, c);
+        if (mask) {
+            return p + csvCountTrailingZeros(mask);
+        }
+        p += 64;
+    }
+    for (; p < end; p++) {
+        if (*p == a || *p == b || *p == c) {
+            return p;
+        }
+    }
+    return end;
+}
+
+int csvCountTrailingZeros(uint64_t mask) {
+#ifdef __GNUC__
+    return __builtin_ctzll(mask);
+#else
+    int count = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+// Next ',', '\n' or '"' at or after offset. Each 64-byte block is classified once and
+// its bitmask cached, so short fields cost a mask lookup instead of a new vector scan.
+const char *csvNextStructural(CsvReader *reader, size_t offset) {
+    while (offset < reader->size) {
+        size_t blockStart = offset & ~(size_t)63;
+        if (blockStart != reader->blockStart) {
+            if (reader->size - blockStart >= 64) {
+                reader->blockMask = csvClassifyBlock(reader->data + blockStart, ',', '\n', '"');
+            } else {
+                // Final partial block: classify by hand so we never read past the mapping
+                char tail[64] = {0};
+                memcpy(tail, reader->data + blockStart, reader->size - blockStart);
+                reader->blockMask = csvClassifyBlockScalar(tail, ',', '\n', '"') &
+                                    ((~(uint64_t)0) >> (64 - (reader->size - blockStart)));
+            }
+            reader->blockStart = blockStart;
+        }
+
+        uint64_t mask = reader->blockMask & ((~(uint64_t)0) << (offset - blockStart));
+        if (mask) {
+            return reader->data + blockStart + csvCountTrailingZeros(mask);
+        }
+        offset = blockStart + 64;
+    }
+    return reader->data + reader->size;
+}
+
+int csvReaderOpen(CsvReader *reader, const char *filename) {
+    memset(reader, 0, sizeof(*reader));
+    reader->blockStart = (size_t)-1;
+
+#ifdef _WIN32
+    // No mmap on Windows: read the whole file into memory instead
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return EXIT_FAILURE;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = malloc(size > 0 ? size : 1);
+    if (data == NULL || fread(data, 1, size, file) != (size_t)size) {
+        free(data);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+    fclose(file);
+    reader->data = data;
+    reader->size = size;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return EXIT_FAILURE;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    if (info.st_size > 0) {
+        void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return EXIT_FAILURE;
+        }
+        madvise(data, info.st_size, MADV_SEQUENTIAL);
+        reader->data = data;
+        reader->size = info.st_size;
+        reader->mapped = 1;
+    }
+    close(fd);
+#endif
+
+    return EXIT_SUCCESS;
+}
+
+void csvReaderClose(CsvReader *reader) {
+#ifdef _WIN32
+    free((void *)reader->data);
+#else
+    if (reader->mapped) {
+        munmap((void *)reader->data, reader->size);
+    }
+#endif
+    reader->data = NULL;
+    reader->size = reader->position = 0;
+}
+
+// Parses the next non-empty record into zero-copy field views.
+// Returns the number of fields in the record (fields past maxFields are skipped), 0 at end of input.
+int csvReaderNextRecord(CsvReader *reader, CsvField *fields, int maxFields) {
+    const char *end = reader->data + reader->size;
+
+    while (reader->position < reader->size) {
+        const char *p = reader->data + reader->position;
+        int fieldCount = 0;
+        int endOfRecord = 0;
+        reader->line++;
+
+        while (!endOfRecord) {
+            CsvField field = {p, 0, 0};
+            int quoted = p < end && *p == '"';
+
+            if (quoted) {
+                // Quoted field: runs to the closing quote, "" is an escaped quote
+                const char *q = ++p;
+                field.data = p;
+                for (;;) {
+                    q = csvNextStructural(reader, q - reader->data);
+                    if (q < end && *q != '"') {
+                        q++; // Delimiters inside quotes are data
+                        continue;
+                    }
+                    if (q + 1 < end && q[1] == '"') {
+                        field.escaped = 1;
+                        q += 2;
+                        continue;
+                    }
+                    break;
+                }
+                field.length = q - p;
+                p = q < end ? q + 1 : end;
+                // Anything between the closing quote and the delimiter is ignored
+                while (p < end && *p != ',' && *p != '\n') {
+                    p++;
+                }
+            } else {
+                const char *q = csvNextStructural(reader, p - reader->data);
+                while (q < end && *q == '"') {
+                    q = csvNextStructural(reader, q - reader->data + 1); // Stray quote in unquoted field
+                }
+                field.length = q - p;
+                p = q;
+            }
+
+            if (p >= end || *p == '\n') {
+                endOfRecord = 1;
+                // Tolerate CRLF line endings
+                if (!quoted && field.length > 0 && field.data[field.length - 1] == '\r') {
+                    field.length--;
+                }
+            }
+            if (p < end) {
+                p++;
+            }
+
+            if (fieldCount < maxFields) {
+                fields[fieldCount] = field;
+            }
+            fieldCount++;
+        }
+
+        reader->position = p - reader->data;
+        if (fieldCount == 1 && fields[0].length == 0) {
+            continue; // Blank line
+        }
+        return fieldCount;
+    }
+
+    return 0;
+}
+
+// Iterates separator-delimited parts of a field (e.g. ';' subject lists), skipping empty parts like strtok
+int csvNextSubfield(const CsvField *field, char separator, size_t *offset, CsvField *out) {
+    const char *end = field->data + field->length;
+
+    while (*offset < field->length) {
+        const char *start = field->data + *offset;
+        const char *q = csvFindAny(start, end, separator, separator, separator);
+        *offset = (q - field->data) + (q < end ? 1 : 0);
+        if (q > start) {
+            out->data = start;
+            out->length = q - start;
+            out->escaped = field->escaped;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Copies a field into a NUL-terminated buffer, unescaping "" pairs. Returns the untruncated length.
+size_t csvFieldCopy(const CsvField *field, char *dest, size_t size) {
+    size_t written = 0, length = 0, i;
+    for (i = 0; i < field->length; i++) {
+        if (field->escaped && field->data[i] == '"' && i + 1 < field->length && field->data[i + 1] == '"') {
+            i++;
+        }
+        if (written + 1 < size) {
+            dest[written++] = field->data[i];
+        }
+        length++;
+    }
+    if (size > 0) {
+        dest[written] = '\0';
+    }
+    return length;
+}
+
+// Whether every value of a student record fits in CSV_VALUE_MAX bytes once unescaped
+int csvRecordFits(const CsvField *fields) {
+    size_t subjectOffset = 0;
+    CsvField subjectField;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        if (csvFieldCopy(&fields[i], NULL, 0) > CSV_VALUE_MAX) {
+            return 0;
+        }
+    }
+    while (csvNextSubfield(&fields[3], ';', &subjectOffset, &subjectField)) {
+        if (csvFieldCopy(&subjectField, NULL, 0) > CSV_VALUE_MAX) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Copies a field into the string pool so it outlives the reader
+const char *stringPoolCopyField(StringPool *pool, const CsvField *field) {
+    char *copy = stringPoolAlloc(pool, field->length + 1);
+    if (copy == NULL) {
+        return NULL;
+    }
+    csvFieldCopy(field, copy, field->length + 1);
+    return copy;
+}
+
+// ==== Bulk ingest helpers ====
+
+int sqlBufferReserve(SqlBuffer *buffer, size_t extra) {
+    if (buffer->length + extra + 1 <= buffer->capacity) {
+        return EXIT_SUCCESS;
+    }
+
+    size_t newCapacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+    while (newCapacity < buffer->length + extra + 1) {
+        newCapacity *= 2;
+    }
+
+    char *data = realloc(buffer->data, newCapacity);
+    if (data == NULL) {
+        fprintf(stderr, "Memory allocation failed for SQL buffer.\n");
+        return EXIT_FAILURE;
+    }
+    buffer->data = data;
+    buffer->capacity = newCapacity;
+    return EXIT_SUCCESS;
+}
+
+int sqlBufferAppend(SqlBuffer *buffer, const char *text) {
+    size_t length = strlen(text);
+    if (sqlBufferReserve(buffer, length) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    memcpy(buffer->data + buffer->length, text, length + 1);
+    buffer->length += length;
+    return EXIT_SUCCESS;
+}
+
+// Appends a quoted, escaped string literal ('...')
+int sqlBufferAppendEscaped(SqlBuffer *buffer, MYSQL *connection, const char *text) {
+    size_t length = strlen(text);
+    if (sqlBufferReserve(buffer, length * 2 + 2) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    buffer->data[buffer->length++] = '\'';
+    buffer->length += mysql_real_escape_string(connection, buffer->data + buffer->length, text, length);
+    buffer->data[buffer->length++] = '\'';
+    buffer->data[buffer->length] = '\0';
+    return EXIT_SUCCESS;
+}
+
+void sqlBufferFree(SqlBuffer *buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = buffer->capacity = 0;
+}
+
+char *stringPoolAlloc(StringPool *pool, size_t length) {
+    StringPoolBlock *block = pool->head;
+
+    if (block == NULL || block->capacity - block->used < length) {
+        size_t capacity = length > 65536 ? length : 65536;
+        block = malloc(sizeof(StringPoolBlock) + capacity);
+        if (block == NULL) {
+            fprintf(stderr, "Memory allocation failed for string pool.\n");
+            return NULL;
+        }
+        block->next = pool->head;
+        block->used = 0;
+        block->capacity = capacity;
+        pool->head = block;
+    }
+
+    char *memory = block->data + block->used;
+    block->used += length;
+    return memory;
+}
+
+const char *stringPoolCopy(StringPool *pool, const char *text) {
+    size_t length = strlen(text) + 1;
+    char *copy = stringPoolAlloc(pool, length);
+    if (copy) {
+        memcpy(copy, text, length);
+    }
+    return copy;
+}
+
+void stringPoolFree(StringPool *pool) {
+    while (pool->head) {
+        StringPoolBlock *next = pool->head->next;
+        free(pool->head);
+        pool->head = next;
+    }
+}
+
+// Starts a new row in a multi-row statement, writing the prefix for the first row
+int sqlBatchBeginRow(SqlBatch *batch) {
+    return sqlBufferAppend(&batch->buffer, batch->rows == 0 ? batch->prefix : ",");
+}
+
+// Finishes a row and sends the statement once it grows past BULK_MAX_STATEMENT_BYTES
+int sqlBatchEndRow(SqlBatch *batch) {
+    batch->rows++;
+    if (batch->buffer.length >= BULK_MAX_STATEMENT_BYTES) {
+        return sqlBatchFlush(batch);
+    }
+    return EXIT_SUCCESS;
+}
+
+int sqlBatchFlush(SqlBatch *batch) {
+    if (batch->rows == 0) {
+        return EXIT_SUCCESS;
+    }
+    if (batch->suffix && sqlBufferAppend(&batch->buffer, batch->suffix) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+    if (dbRealQuery(batch->connection, batch->buffer.data, batch->buffer.length, batch->kind)) {
+        fprintf(stderr, "Batched statement failed: %s\n", mysql_error(batch->connection));
+        status = EXIT_FAILURE;
+    } else if (batch->onResult) {
+        MYSQL_RES *result = mysql_store_result(batch->connection);
+        if (result == NULL) {
+            fprintf(stderr, "Could not retrieve batched result: %s\n", mysql_error(batch->connection));
+            status = EXIT_FAILURE;
+        } else {
+            status = batch->onResult(result, batch->context);
+            mysql_free_result(result);
+        }
+    }
+
+    batch->buffer.length = 0;
+    batch->rows = 0;
+    return status;
+}
+
+void statementCacheInit(StatementCache *cache, MYSQL *connection) {
+    memset(cache, 0, sizeof(*cache));
+    cache->connection = connection;
+}
+
+// Closes every cached statement; call before the connection itself is closed
+void statementCacheClose(StatementCache *cache) {
+    int i;
+    for (i = 0; i < cache->count; i++) {
+        mysql_stmt_close(cache->entries[i].statement);
+        free(cache->entries[i].sql);
+    }
+    cache->count = 0;
+}
+
+MYSQL_STMT *prepareStatement(MYSQL *connection, const char *sql) {
+    MYSQL_STMT *statement = mysql_stmt_init(connection);
+    if (statement == NULL) {
+        fprintf(stderr, "mysql_stmt_init() failed\n");
+        return NULL;
+    }
+    if (mysql_stmt_prepare(statement, sql, strlen(sql))) {
+        fprintf(stderr, "Could not prepare statement: %s\n", mysql_stmt_error(statement));
+        mysql_stmt_close(statement);
+        return NULL;
+    }
+    return statement;
+}
+
+// Returns the prepared statement for sql, preparing it on first use. Once the cache is full the
+// least recently used statement is closed, so a statement is only good until a later lookup.
+MYSQL_STMT *statementCacheGet(StatementCache *cache, const char *sql) {
+    int i, slot = 0;
+    cache->clock++;
+    for (i = 0; i < cache->count; i++) {
+        if (strcmp(cache->entries[i].sql, sql) == 0) {
+            cache->entries[i].lastUse = cache->clock;
+            cache->hits++;
+            return cache->entries[i].statement;
+        }
+        if (cache->entries[i].lastUse < cache->entries[slot].lastUse) {
+            slot = i;
+        }
+    }
+
+    size_t length = strlen(sql) + 1;
+    char *copy = malloc(length);
+    if (copy == NULL) {
+        fprintf(stderr, "Memory allocation failed for statement cache.\n");
+        return NULL;
+    }
+    MYSQL_STMT *statement = prepareStatement(cache->connection, sql);
+    if (statement == NULL) {
+        free(copy);
+        return NULL;
+    }
+    memcpy(copy, sql, length);
+
+    if (cache->count < STATEMENT_CACHE_SIZE) {
+        slot = cache->count++;
+    } else {
+        mysql_stmt_close(cache->entries[slot].statement);
+        free(cache->entries[slot].sql);
+    }
+    cache->entries[slot].sql = copy;
+    cache->entries[slot].statement = statement;
+    cache->entries[slot].lastUse = cache->clock;
+    cache->prepares++;
+    return statement;
+}
+
+void bindInt(MYSQL_BIND *bind, int *value) {
+    memset(bind, 0, sizeof(*bind));
+    bind->buffer_type = MYSQL_TYPE_LONG;
+    bind->buffer = value;
+}
+
+// Binds text as a string parameter; length must outlive the execution
+void bindText(MYSQL_BIND *bind, const char *text, unsigned long *length) {
+    memset(bind, 0, sizeof(*bind));
+    *length = strlen(text);
+    bind->buffer_type = MYSQL_TYPE_STRING;
+    bind->buffer = (void *)text;
+    bind->buffer_length = *length;
+    bind->length = length;
+}
+
+// Writes prefix (?,?,...),(?,?,...) suffix for rows rows of columns placeholders
+int appendPlaceholderRows(SqlBuffer *buffer, const char *prefix, const char *suffix, int rows, int columns) {
+    int r, c;
+    buffer->length = 0;
+    if (sqlBufferAppend(buffer, prefix) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    for (r = 0; r < rows; r++) {
+        if (sqlBufferAppend(buffer, r == 0 ? "(?" : ",(?") == EXIT_FAILURE) {
+            return EXIT_FAILURE;
+        }
+        for (c = 1; c < columns; c++) {
+            if (sqlBufferAppend(buffer, ",?") == EXIT_FAILURE) {
+                return EXIT_FAILURE;
+            }
+        }
+        if (sqlBufferAppend(buffer, ")") == EXIT_FAILURE) {
+            return EXIT_FAILURE;
+        }
+    }
+    return suffix ? sqlBufferAppend(buffer, suffix) : EXIT_SUCCESS;
+}
+
+int statementBatchInit(StatementBatch *batch, StatementCache *cache, const char *prefix, const char *suffix,
+                       int columns, QueryKind kind) {
+    int i;
+    memset(batch, 0, sizeof(*batch));
+    batch->cache = cache;
+    batch->prefix = prefix;
+    batch->suffix = suffix;
+    batch->columns = columns;
+    batch->kind = kind;
+    batch->values = malloc(sizeof(int) * STATEMENT_BATCH_ROWS * columns);
+    batch->binds = malloc(sizeof(MYSQL_BIND) * STATEMENT_BATCH_ROWS * columns);
+    if (batch->values == NULL || batch->binds == NULL) {
+        fprintf(stderr, "Memory allocation failed for statement batch.\n");
+        statementBatchFree(batch);
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < STATEMENT_BATCH_ROWS * columns; i++) {
+        bindInt(&batch->binds[i], &batch->values[i]);
+    }
+    if (appendPlaceholderRows(&batch->sql, prefix, suffix, STATEMENT_BATCH_ROWS, columns) == EXIT_FAILURE) {
+        statementBatchFree(batch);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Adds one row of columns values and sends the chunk once it is full
+int statementBatchAdd(StatementBatch *batch, const int *row) {
+    memcpy(batch->values + (size_t)batch->rows * batch->columns, row, sizeof(int) * batch->columns);
+    if (++batch->rows == STATEMENT_BATCH_ROWS) {
+        return statementBatchFlush(batch);
+    }
+    return EXIT_SUCCESS;
+}
+
+int statementBatchFlush(StatementBatch *batch) {
+    if (batch->rows == 0) {
+        return EXIT_SUCCESS;
+    }
+
+    MYSQL_STMT *statement;
+    int partial = batch->rows < STATEMENT_BATCH_ROWS;
+    if (partial) {
+        // Sized for this chunk alone; caching it would only push out statements that get reused
+        SqlBuffer sql = {0};
+        statement = appendPlaceholderRows(&sql, batch->prefix, batch->suffix, batch->rows, batch->columns) ==
+                    EXIT_SUCCESS ? prepareStatement(batch->cache->connection, sql.data) : NULL;
+        sqlBufferFree(&sql);
+    } else {
+        statement = statementCacheGet(batch->cache, batch->sql.data);
+    }
+
+    int status = EXIT_SUCCESS;
+    if (statement == NULL) {
+        status = EXIT_FAILURE;
+    } else if (mysql_stmt_bind_param(statement, batch->binds) || dbStatementExecute(statement, batch->kind)) {
+        fprintf(stderr, "Batched statement failed: %s\n", mysql_stmt_error(statement));
+        status = EXIT_FAILURE;
+    } else {
+        batch->affectedRows += (long)mysql_stmt_affected_rows(statement);
+    }
+    if (partial && statement) {
+        mysql_stmt_close(statement);
+    }
+    batch->rows = 0;
+    return status;
+}
+
+void statementBatchFree(StatementBatch *batch) {
+    sqlBufferFree(&batch->sql);
+    free(batch->values);
+    free(batch->binds);
+    batch->values = NULL;
+    batch->binds = NULL;
+}
+
+int compareKeyIdEntries(const void *a, const void *b) {
+    return strcmp(((const KeyIdEntry *)a)->key, ((const KeyIdEntry *)b)->key);
+}
+
+// Collects the distinct keys of a batch that are not yet in the known dictionary (if any),
+// sorted so ids can be resolved with bsearch
+int buildKeyIdTable(KeyIdTable *table, const StagedEnrollment *rows, int count, int useSubject,
+                    const IdDictionary *known) {
+    table->entries = malloc(sizeof(KeyIdEntry) * (count > 0 ? count : 1));
+    table->count = 0;
+    if (table->entries == NULL) {
+        fprintf(stderr, "Memory allocation failed for key table.\n");
+        return EXIT_FAILURE;
+    }
+
+    int i, unknown = 0;
+    for (i = 0; i < count; i++) {
+        const char *key = useSubject ? rows[i].subject : rows[i].symbol_number;
+        if (known && idDictionaryFind(known, key, strlen(key))) {
+            continue;
+        }
+        table->entries[unknown].key = key;
+        table->entries[unknown].row = &rows[i];
+        table->entries[unknown].id = 0;
+        unknown++;
+    }
+    qsort(table->entries, unknown, sizeof(KeyIdEntry), compareKeyIdEntries);
+
+    for (i = 0; i < unknown; i++) {
+        if (table->count == 0 || strcmp(table->entries[table->count - 1].key, table->entries[i].key) != 0) {
+            table->entries[table->count++] = table->entries[i];
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+KeyIdEntry *findKeyIdEntry(KeyIdTable *table, const char *key) {
+    KeyIdEntry probe;
+    probe.key = key;
+    return bsearch(&probe, table->entries, table->count, sizeof(KeyIdEntry), compareKeyIdEntries);
+}
+
+// Result handler for "SELECT id, key ... WHERE key IN (...)" lookups
+int storeKeyIdResult(MYSQL_RES *result, void *context) {
+    KeyIdTable *table = context;
+    MYSQL_ROW idRow;
+    while ((idRow = dbFetchRow(result, QUERY_ID_LOOKUP))) {
+        KeyIdEntry *entry = findKeyIdEntry(table, idRow[1]);
+        if (entry) {
+            entry->id = atoi(idRow[0]);
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// Fills in the ids of the keys in a table with IN-list lookups; keys not in the database keep id 0
+int selectKeyIds(MYSQL *connection, KeyIdTable *table, int useSubject) {
+    SqlBatch batch = {0};
+    int status = EXIT_FAILURE;
+    int i;
+
+    batch.connection = connection;
+    batch.prefix = useSubject ? "SELECT id, subject_name FROM subjects WHERE subject_name IN ("
+                              : "SELECT id, symbol_number FROM students WHERE symbol_number IN (";
+    batch.suffix = ")";
+    batch.onResult = storeKeyIdResult;
+    batch.kind = QUERY_ID_LOOKUP;
+    batch.context = table;
+    for (i = 0; i < table->count; i++) {
+        if (sqlBatchBeginRow(&batch) ||
+            sqlBufferAppendEscaped(&batch.buffer, connection, table->entries[i].key) ||
+            sqlBatchEndRow(&batch)) {
+            goto cleanup;
+        }
+    }
+    if (sqlBatchFlush(&batch)) goto cleanup;
+    status = EXIT_SUCCESS;
+
+cleanup:
+    sqlBufferFree(&batch.buffer);
+    return status;
+}
+
+// Inserts the students of a key table with one multi-row INSERT IGNORE and resolves all their ids
+int insertStudentKeys(MYSQL *connection, KeyIdTable *students) {
+    SqlBatch batch = {0};
+    int status = EXIT_FAILURE;
+    int i;
+
+    batch.connection = connection;
+    batch.prefix = "INSERT IGNORE INTO students (symbol_number, name, college_name) VALUES ";
+    batch.kind = QUERY_INGEST_WRITE;
+    for (i = 0; i < students->count; i++) {
+        const StagedEnrollment *row = students->entries[i].row;
+        if (sqlBatchBeginRow(&batch) || sqlBufferAppend(&batch.buffer, "(") ||
+            sqlBufferAppendEscaped(&batch.buffer, connection, row->symbol_number) ||
+            sqlBufferAppend(&batch.buffer, ",") ||
+            sqlBufferAppendEscaped(&batch.buffer, connection, row->name) ||
+            sqlBufferAppend(&batch.buffer, ",") ||
+            sqlBufferAppendEscaped(&batch.buffer, connection, row->college_name) ||
+            sqlBufferAppend(&batch.buffer, ")") || sqlBatchEndRow(&batch)) {
+            goto cleanup;
+        }
+    }
+    if (sqlBatchFlush(&batch) || selectKeyIds(connection, students, 0)) goto cleanup;
+
+    for (i = 0; i < students->count; i++) {
+        if (students->entries[i].id == 0) {
+            fprintf(stderr, "Could not retrieve student ID for %s.\n", students->entries[i].key);
+            goto cleanup;
+        }
+    }
+    status = EXIT_SUCCESS;
+
+cleanup:
+    sqlBufferFree(&batch.buffer);
+    return status;
+}
+
+// Inserts the subjects of a key table with one multi-row INSERT IGNORE and resolves all their ids
+int insertSubjectKeys(MYSQL *connection, KeyIdTable *subjects) {
+    SqlBatch batch = {0};
+    int status = EXIT_FAILURE;
+    int i;
+
+    batch.connection = connection;
+    batch.prefix = "INSERT IGNORE INTO subjects (subject_name) VALUES ";
+    batch.kind = QUERY_INGEST_WRITE;
+    for (i = 0; i < subjects->count; i++) {
+        if (sqlBatchBeginRow(&batch) || sqlBufferAppend(&batch.buffer, "(") ||
+            sqlBufferAppendEscaped(&batch.buffer, connection, subjects->entries[i].key) ||
+            sqlBufferAppend(&batch.buffer, ")") || sqlBatchEndRow(&batch)) {
+            goto cleanup;
+        }
+    }
+    if (sqlBatchFlush(&batch) || selectKeyIds(connection, subjects, 1)) goto cleanup;
+
+    for (i = 0; i < subjects->count; i++) {
+        if (subjects->entries[i].id == 0) {
+            fprintf(stderr, "Could not retrieve subject ID for %s.\n", subjects->entries[i].key);
+            goto cleanup;
+        }
+    }
+    status = EXIT_SUCCESS;
+
+cleanup:
+    sqlBufferFree(&batch.buffer);
+    return status;
+}
+
+// Multi-row INSERT of (student_id, subject_id) pairs, kept in the given order
+int insertEnrollmentPairs(MYSQL *connection, const int *pairs, int count) {
+    SqlBatch batch = {0};
+    int status = EXIT_FAILURE;
+    int i;
+
+    batch.connection = connection;
+    batch.prefix = "INSERT INTO student_subjects (student_id, subject_id) VALUES ";
+    batch.kind = QUERY_INGEST_WRITE;
+    for (i = 0; i < count; i++) {
+        char values[64];
+        snprintf(values, sizeof(values), "(%d,%d)", pairs[2 * i], pairs[2 * i + 1]);
+        if (sqlBatchBeginRow(&batch) || sqlBufferAppend(&batch.buffer, values) || sqlBatchEndRow(&batch)) {
+            goto cleanup;
+        }
+    }
+    if (sqlBatchFlush(&batch)) goto cleanup;
+    status = EXIT_SUCCESS;
+
+cleanup:
+    sqlBufferFree(&batch.buffer);
+    return status;
+}
+
+// Writes one staged batch: multi-row INSERT IGNOREs and id lookups for keys the dictionary
+// has not seen yet, then one multi-row INSERT of the enrollments that are not already present
+int flushBulkBatch(MYSQL *connection, IngestDictionary *dict, const StagedEnrollment *rows, int count,
+                   long *insertedRows) {
+    KeyIdTable students = {0}, subjects = {0};
+    int *pairs = NULL;
+    int pairCount = 0;
+    int status = EXIT_FAILURE;
+    int i;
+
+    if (buildKeyIdTable(&students, rows, count, 0, &dict->students) == EXIT_FAILURE ||
+        buildKeyIdTable(&subjects, rows, count, 1, &dict->subjects) == EXIT_FAILURE ||
+        insertStudentKeys(connection, &students) == EXIT_FAILURE ||
+        insertSubjectKeys(connection, &subjects) == EXIT_FAILURE) {
+        goto cleanup;
+    }
+
+    for (i = 0; i < students.count; i++) {
+        if (idDictionaryPut(&dict->students, students.entries[i].key, strlen(students.entries[i].key),
+                            students.entries[i].id) == EXIT_FAILURE) {
+            goto cleanup;
+        }
+    }
+    for (i = 0; i < subjects.count; i++) {
+        if (idDictionaryPut(&dict->subjects, subjects.entries[i].key, strlen(subjects.entries[i].key),
+                            subjects.entries[i].id) == EXIT_FAILURE) {
+            goto cleanup;
+        }
+    }
+
+    // Enrollment rows keep CSV order so per-student subject ordering is preserved
+    pairs = malloc(sizeof(int) * 2 * (count > 0 ? count : 1));
+    if (pairs == NULL) {
+        fprintf(stderr, "Memory allocation failed for enrollment rows.\n");
+        goto cleanup;
+    }
+    for (i = 0; i < count; i++) {
+        int student_id = idDictionaryFind(&dict->students, rows[i].symbol_number, strlen(rows[i].symbol_number));
+        int subject_id = idDictionaryFind(&dict->subjects, rows[i].subject, strlen(rows[i].subject));
+
+        int added = pairSetInsert(&dict->enrollments, student_id, subject_id);
+        if (added < 0) {
+            goto cleanup;
+        }
+        if (added == 0) {
+            continue; // Already enrolled, either in the database or earlier in this file
+        }
+        pairs[2 * pairCount] = student_id;
+        pairs[2 * pairCount + 1] = subject_id;
+        pairCount++;
+    }
+    if (insertEnrollmentPairs(connection, pairs, pairCount) == EXIT_FAILURE) {
+        goto cleanup;
+    }
+    *insertedRows += pairCount;
+    status = EXIT_SUCCESS;
+
+cleanup:
+    free(pairs);
+    free(students.entries);
+    free(subjects.entries);
+    return status;
+}
+
+// Lets the admin pick how the CSV file is ingested
+void ingestMenu(const char *filename) {
+    printf("\nIngest Mode:\n");
+    printf("1. Row by Row\n");
+    printf("2. Bulk (Batched Transactions)\n");
+    printf("3. Parallel (Multiple Connections)\n");
+    printf("4. Delta (Only Changed Rows)\n");
+    printf("5. Back\n");
+    int choice = getValidatedChoice("\nEnter your choice: ");
+
+    switch (choice) {
+        case 1:
+            parseAndInsertCSV(filename);
+            break;
+        case 2: {
+            int batchSize = getValidatedChoice("Enter batch size (lines per transaction, 0 for default): ");
+            bulkInsertCSV(filename, batchSize > 0 ? batchSize : DEFAULT_BULK_BATCH_SIZE);
+            break;
+        }
+        case 3: {
+            int writers = getValidatedChoice("Enter number of writer connections (0 for default): ");
+            int batchSize = getValidatedChoice("Enter rows per statement (0 for default): ");
+            parallelInsertCSV(filename, writers > 0 ? writers : DEFAULT_INGEST_WRITERS,
+                              batchSize > 0 ? batchSize : DEFAULT_BULK_BATCH_SIZE);
+            break;
+        }
+        case 4:
+            deltaInsertCSV(filename);
+            break;
+        case 5:
+            break;
+        default:
+            printf("Invalid choice.\n");
+    }
+}
+
+// Bulk ingest: stages batchSize CSV lines and writes each batch in a single transaction
+int bulkInsertCSV(const char *filename, int batchSize) {
+    CsvReader reader;
+    if (csvReaderOpen(&reader, filename) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not open CSV file\n");
+        return EXIT_FAILURE;
+    }
+
+    int capacity = batchSize * 4;
+    StagedEnrollment *rows = malloc(sizeof(StagedEnrollment) * capacity);
+    if (rows == NULL) {
+        fprintf(stderr, "Memory allocation failed for staged rows.\n");
+        csvReaderClose(&reader);
+        return EXIT_FAILURE;
+    }
+
+    IngestDictionary dict;
+    if (loadIngestDictionary(conn, &dict) == EXIT_FAILURE) {
+        free(rows);
+        csvReaderClose(&reader);
+        return EXIT_FAILURE;
+    }
+
+    StringPool pool = {0};
+    int count = 0, linesInBatch = 0, batches = 0;
+    long totalRows = 0, insertedRows = 0;
+    int status = EXIT_SUCCESS;
+    double startTime = getCurrentTimeSeconds();
+
+    mysql_autocommit(conn, 0);
+
+    CsvField fields[4];
+    int moreInput = 1;
+    while (moreInput) {
+        int fieldCount = csvReaderNextRecord(&reader, fields, 4);
+        moreInput = fieldCount > 0;
+
+        if (moreInput) {
+            if (fieldCount < 4) {
+                fprintf(stderr, "Skipping malformed CSV line %ld.\n", reader.line);
+                continue;
+            }
+
+            const char *symbol_number = stringPoolCopyField(&pool, &fields[0]);
+            const char *name = stringPoolCopyField(&pool, &fields[1]);
+            const char *college_name = stringPoolCopyField(&pool, &fields[2]);
+
+            size_t subjectOffset = 0;
+            CsvField subject;
+            while (csvNextSubfield(&fields[3], ';', &subjectOffset, &subject)) {
+                if (count == capacity) {
+                    StagedEnrollment *grown = realloc(rows, sizeof(StagedEnrollment) * capacity * 2);
+                    if (grown == NULL) {
+                        fprintf(stderr, "Memory allocation failed for staged rows.\n");
+                        status = EXIT_FAILURE;
+                        break;
+                    }
+                    rows = grown;
+                    capacity *= 2;
+                }
+                rows[count].symbol_number = symbol_number;
+                rows[count].name = name;
+                rows[count].college_name = college_name;
+                rows[count].subject = stringPoolCopyField(&pool, &subject);
+                if (symbol_number == NULL || name == NULL || college_name == NULL || rows[count].subject == NULL) {
+                    status = EXIT_FAILURE;
+                    break;
+                }
+                count++;
+            }
+            if (status == EXIT_FAILURE) {
+                break;
+            }
+            linesInBatch++;
+        }
+
+        if ((linesInBatch >= batchSize || !moreInput) && count > 0) {
+            if (flushBulkBatch(conn, &dict, rows, count, &insertedRows) == EXIT_FAILURE || dbCommit(conn, QUERY_INGEST_WRITE)) {
+                fprintf(stderr, "Bulk batch %d failed, rolling back: %s\n", batches + 1, mysql_error(conn));
+                mysql_rollback(conn);
+                status = EXIT_FAILURE;
+                break;
+            }
+            batches++;
+            totalRows += count;
+            count = 0;
+            linesInBatch = 0;
+            stringPoolFree(&pool);
+        }
+    }
+
+    mysql_autocommit(conn, 1);
+    stringPoolFree(&pool);
+    freeIngestDictionary(&dict);
+    free(rows);
+    csvReaderClose(&reader);
+
+    double elapsed = getCurrentTimeSeconds() - startTime;
+    if (status == EXIT_SUCCESS) {
+        metricsRecordPhase(PHASE_INGEST, elapsed);
+        printf("\nCSV data bulk inserted successfully.\n");
+    }
+    printf("Processed %ld CSV rows in %d batches in %.2f s (%.0f rows/s, batch size %d).\n",
+           totalRows, batches, elapsed, elapsed > 0 ? totalRows / elapsed : 0.0, batchSize);
+    printf("Inserted %ld new enrollments, skipped %ld already enrolled.\n", insertedRows, totalRows - insertedRows);
+    return status;
+}
+
+
+void configureRooms() {
+    char queryStr[256];
+    int id, twoSeaterCount, threeSeaterCount;
+    char choice;
+
+    printf("\nConfiguring Rooms:\n");
+    printf("===================\n");
+
+    // Fetch existing room configurations
+    if (dbQuery(conn, "SELECT id, room_number, two_seater_count, three_seater_count FROM rooms", QUERY_OTHER)) {
+        fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
+        return;
+    }
+
+    MYSQL_RES *result = mysql_store_result(conn);
+    if (result == NULL) {
+        fprintf(stderr, "Could not retrieve rooms data: %s\n", mysql_error(conn));
+        return;
+    }
+
+    printf("\nCurrent Room Configurations:\n");
+    printf("ID | Room Number | Two-Seater Count | Three-Seater Count\n");
+    printf("-------------------------------------------------------\n");
+    MYSQL_ROW row;
+    while ((row = dbFetchRow(result, QUERY_OTHER))) {
+        printf("%-2s | %-11s | %-16s | %-18s\n", row[0], row[1], row[2], row[3]);
+    }
+    mysql_free_result(result);
+
+    while (1) {
+        printf("\nDo you want to (A)dd, (E)dit, or (D)elete a room? (Enter Q to quit): ");
+        scanf(" %c", &choice);
+
+        if (choice == 'Q' || choice == 'q') {
+            break;
+        }
+
+        switch (choice) {
+            case 'A':
+            case 'a': {
+                int roomNumber;
+                printf("\nEnter Room Number: ");
+                scanf("%d", &roomNumber);
+                printf("Enter Two-Seater Count: ");
+                scanf("%d", &twoSeaterCount);
+                printf("Enter Three-Seater Count: ");
+                scanf("%d", &threeSeaterCount);
+
+                snprintf(queryStr, sizeof(queryStr),
+                         "INSERT INTO rooms (room_number, two_seater_count, three_seater_count) "
+                         "VALUES (%d, %d, %d)", roomNumber, twoSeaterCount, threeSeaterCount);
+
+                if (dbQuery(conn, queryStr, QUERY_OTHER)) {
+                    fprintf(stderr, "Error adding room: %s\n", mysql_error(conn));
+                } else {
+                    printf("Room added successfully.\n");
+                }
+                break;
+            }
+
+            case 'E':
+            case 'e': {
+                printf("\nEnter Room ID to Edit: ");
+                scanf("%d", &id);
+
+                printf("Enter New Two-Seater Count: ");
+                scanf("%d", &twoSeaterCount);
+                printf("Enter New Three-Seater Count: ");
+                scanf("%d", &threeSeaterCount);
+
+                snprintf(queryStr, sizeof(queryStr),
+                         "UPDATE rooms SET two_seater_count = %d, three_seater_count = %d "
+                         "WHERE id = %d", twoSeaterCount, threeSeaterCount, id);
+
+                if (dbQuery(conn, queryStr, QUERY_OTHER)) {
+                    fprintf(stderr, "Error updating room: %s\n", mysql_error(conn));
+                } else {
+                    printf("Room updated successfully.\n");
+                }
+                break;
+            }
+
+            case 'D':
+            case 'd': {
+                printf("\nEnter Room ID to Delete: ");
+                scanf("%d", &id);
+
+                snprintf(queryStr, sizeof(queryStr), "DELETE FROM rooms WHERE id = %d", id);
+
+                if (dbQuery(conn, queryStr, QUERY_OTHER)) {
+                    fprintf(stderr, "Error deleting room: %s\n", mysql_error(conn));
+                } else {
+                    printf("\nRoom deleted successfully.\n");
+                }
+                break;
+            }
+
+            default:
+                printf("\nInvalid choice. Please try again.\n");
+        }
+    }
+
+    printf("\nExiting Room Configuration.\n");
+}
+
+
+int resetTables() {
+    const char *queries[] = {
+        "SET FOREIGN_KEY_CHECKS = 0",
+        "TRUNCATE TABLE seat_allocation",
+        "TRUNCATE TABLE student_subjects",
+        "TRUNCATE TABLE students",
+        "TRUNCATE TABLE subjects",
+        "TRUNCATE TABLE rooms",
+        "SET FOREIGN_KEY_CHECKS = 1"
+    };
+    int numQueries = sizeof(queries) / sizeof(queries[0]);
+    int i;
+
+    for (i = 0; i < numQueries; i++) {
+        if (dbQuery(conn, queries[i], QUERY_OTHER)) {
+            fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("\nAll tables have been reset successfully.\n");
+    return EXIT_SUCCESS;
+}
+
+// Seats on a bench: the first two_seater_count benches of a room are two-seaters
+int benchSeatCount(const Room *room, int bench) {
+    return bench < room->two_seater_count ? 2 : 3;
+}
+
+// Offset of a bench's first seat in its room's seat block: two-seaters first, then three-seaters
+int benchSeatOffset(const Room *room, int bench) {
+    return bench < room->two_seater_count ? bench * 2
+                                          : room->two_seater_count * 2 + (bench - room->two_seater_count) * 3;
+}
+
+int seatArenaInit(SeatArena *arena, size_t size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->block = malloc(size + CACHE_LINE_SIZE);
+    if (arena->block == NULL) {
+        return EXIT_FAILURE;
+    }
+    arena->base = (char *)(((uintptr_t)arena->block + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1));
+    arena->size = size;
+    return EXIT_SUCCESS;
+}
+
+// Carves a cache-line-aligned block; returns NULL when the arena is exhausted
+void *seatArenaAlloc(SeatArena *arena, size_t bytes) {
+    size_t start = (arena->used + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+    if (start + bytes > arena->size) {
+        return NULL;
+    }
+    arena->used = start + bytes;
+    return arena->base + start;
+}
+
+void seatArenaFree(SeatArena *arena) {
+    free(arena->block);
+    memset(arena, 0, sizeof(*arena));
+}
+
+// Builds a worker's private copy of the rooms, with seat blocks, bitsets for subjectCapacity
+// subjects and the subject cursors all carved from one arena
+int seatWorkspaceInit(SeatWorkspace *workspace, const Room *rooms, int roomCount, int subjectCapacity) {
+    size_t bytes = sizeof(SubjectCursor) * subjectCapacity + CACHE_LINE_SIZE;
+    int i;
+
+    memset(workspace, 0, sizeof(*workspace));
+    workspace->rooms = malloc(sizeof(Room) * (roomCount > 0 ? roomCount : 1));
+    if (workspace->rooms == NULL) {
+        fprintf(stderr, "Memory allocation failed for rooms.\n");
+        return EXIT_FAILURE;
+    }
+    memcpy(workspace->rooms, rooms, sizeof(Room) * roomCount);
+    workspace->roomCount = roomCount;
+    workspace->subjectCapacity = subjectCapacity;
+
+    for (i = 0; i < roomCount; i++) {
+        Room *room = &workspace->rooms[i];
+        room->seats_per_bench = 3; // Widest bench; see benchSeatCount
+        room->seat_count = benchSeatOffset(room, room->total_benches);
+        room->seatWords = (room->seat_count + 63) / 64;
+        bytes += ((sizeof(int) * room->seat_count + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1)) +
+                 ((sizeof(uint64_t) * room->seatWords * (1 + subjectCapacity) + CACHE_LINE_SIZE - 1) &
+                  ~(size_t)(CACHE_LINE_SIZE - 1));
+    }
+
+    if (seatArenaInit(&workspace->arena, bytes) == EXIT_FAILURE) {
+        fprintf(stderr, "Memory allocation failed for seat matrix.\n");
+        seatWorkspaceFree(workspace);
+        return EXIT_FAILURE;
+    }
+    workspace->cursors = seatArenaAlloc(&workspace->arena, sizeof(SubjectCursor) * subjectCapacity);
+    for (i = 0; i < roomCount; i++) {
+        Room *room = &workspace->rooms[i];
+        room->seats = seatArenaAlloc(&workspace->arena, sizeof(int) * room->seat_count);
+        room->occupied = seatArenaAlloc(&workspace->arena, sizeof(uint64_t) * room->seatWords * (1 + subjectCapacity));
+        room->blocked = room->occupied + room->seatWords;
+    }
+    seatWorkspaceClear(workspace);
+    return EXIT_SUCCESS;
+}
+
+// Empties every room for a new day: the seat blocks and cursors are contiguous, so this is one memset
+void seatWorkspaceClear(SeatWorkspace *workspace) {
+    int i;
+    memset(workspace->arena.base, 0, workspace->arena.used);
+    for (i = 0; i < workspace->roomCount; i++) {
+        workspace->rooms[i].firstFreeWord = 0;
+    }
+}
+
+void seatWorkspaceFree(SeatWorkspace *workspace) {
+    seatArenaFree(&workspace->arena);
+    free(workspace->rooms);
+    memset(workspace, 0, sizeof(*workspace));
+}
+
+// Loads every room once
+int mysqlStorageLoadRooms(void *session, AllocationEngine *engine) {
+    MYSQL *connection = ((StatementCache *)session)->connection;
+    if (dbQuery(connection, "SELECT id, room_number, two_seater_count, three_seater_count FROM rooms ORDER BY id", QUERY_ALLOCATION_READ)) {
+        fprintf(stderr, "Room query failed: %s\n", mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+
+    MYSQL_RES *roomResult = mysql_store_result(connection);
+    if (roomResult == NULL) {
+        fprintf(stderr, "Could not retrieve room data: %s\n", mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+
+    int roomCount = mysql_num_rows(roomResult);
+    engine->rooms = calloc(roomCount > 0 ? roomCount : 1, sizeof(Room));
+    if (engine->rooms == NULL) {
+        fprintf(stderr, "Memory allocation failed for rooms.\n");
+        mysql_free_result(roomResult);
+        return EXIT_FAILURE;
+    }
+
+    if (intMapInit(&engine->roomSlots, roomCount * 2 + 16) == EXIT_FAILURE) {
+        mysql_free_result(roomResult);
+        return EXIT_FAILURE;
+    }
+
+    MYSQL_ROW roomRow;
+    while ((roomRow = dbFetchRow(roomResult, QUERY_ALLOCATION_READ))) {
+        Room *room = &engine->rooms[engine->roomCount];
+        room->room_id = atoi(roomRow[0]);
+        room->room_number = atoi(roomRow[1]);
+        room->two_seater_count = atoi(roomRow[2]);
+        room->total_benches = room->two_seater_count + atoi(roomRow[3]);
+        if (intMapPut(&engine->roomSlots, room->room_id, engine->roomCount++) == EXIT_FAILURE) {
+            mysql_free_result(roomResult);
+            return EXIT_FAILURE;
+        }
+    }
+    mysql_free_result(roomResult);
+    return EXIT_SUCCESS;
+}
+
+// Gives every sitting of a day a dense subject slot so per-subject bitsets can be indexed directly
+int mapDaySubjects(AllocationDay *day) {
+    int i;
+    intMapFree(&day->subjects);
+    day->subjectCount = 0;
+    if (intMapInit(&day->subjects, 64) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < day->count + day->existingCount; i++) {
+        SeatAssignment *assignment = i < day->count ? &day->assignments[i] : &day->existing[i - day->count].assignment;
+        assignment->subjectSlot = intMapFind(&day->subjects, assignment->subject_id);
+        if (assignment->subjectSlot < 0) {
+            assignment->subjectSlot = day->subjectCount++;
+            if (intMapPut(&day->subjects, assignment->subject_id, assignment->subjectSlot) == EXIT_FAILURE) {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int compareSeatAssignments(const void *a, const void *b) {
+    const SeatAssignment *x = a, *y = b;
+    if (x->student_id != y->student_id) return x->student_id < y->student_id ? -1 : 1;
+    return (x->subject_id > y->subject_id) - (x->subject_id < y->subject_id);
+}
+
+// Number of exam days to seat: the highest day with a sitting or a saved seat, capped at maxDays
+int mysqlStorageCountDays(void *session, int maxDays, int *dayCount) {
+    MYSQL *connection = ((StatementCache *)session)->connection;
+    char query[512];
+    snprintf(query, sizeof(query),
+             "SELECT COALESCE(MAX(day), 0) FROM ("
+             "SELECT subject_index AS day FROM student_subjects WHERE subject_index <= %d "
+             "UNION ALL SELECT day FROM seat_allocation WHERE day <= %d) days", maxDays, maxDays);
+
+    if (dbQuery(connection, query, QUERY_ALLOCATION_READ)) {
+        fprintf(stderr, "Query to fetch the number of exam days failed: %s\n", mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+    MYSQL_RES *result = mysql_store_result(connection);
+    if (result == NULL) {
+        fprintf(stderr, "Could not retrieve the number of exam days: %s\n", mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+    MYSQL_ROW row = dbFetchRow(result, QUERY_ALLOCATION_READ);
+    *dayCount = (row && row[0]) ? atoi(row[0]) : 0;
+    mysql_free_result(result);
+    return EXIT_SUCCESS;
+}
+
+// Streams the sittings of one day that have no seat yet, ordered by student and subject
+int mysqlStorageLoadDayEnrollments(void *session, AllocationDay *day) {
+    MYSQL_STMT *statement = statementCacheGet(session, dayEnrollmentsQuery);
+    if (statement == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    int dayNumber = day->day, student_id, subject_id;
+    MYSQL_BIND params[2], results[2];
+    bindInt(&params[0], &dayNumber);
+    bindInt(&params[1], &dayNumber);
+    bindInt(&results[0], &student_id);
+    bindInt(&results[1], &subject_id);
+    if (mysql_stmt_bind_param(statement, params) || dbStatementExecute(statement, QUERY_ALLOCATION_READ) ||
+        mysql_stmt_bind_result(statement, results)) {
+        fprintf(stderr, "Query failed: %s\n", mysql_stmt_error(statement));
+        mysql_stmt_free_result(statement);
+        return EXIT_FAILURE;
+    }
+
+    int capacity = 0, fetched;
+    while ((fetched = dbStatementFetch(statement, QUERY_ALLOCATION_READ)) == 0) {
+        if (day->count == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            SeatAssignment *grown = realloc(day->assignments, sizeof(SeatAssignment) * capacity);
+            if (grown == NULL) {
+                fprintf(stderr, "Memory allocation failed for enrollments.\n");
+                mysql_stmt_free_result(statement);
+                return EXIT_FAILURE;
+            }
+            day->assignments = grown;
+        }
+        SeatAssignment *assignment = &day->assignments[day->count++];
+        assignment->student_id = student_id;
+        assignment->subject_id = subject_id;
+        assignment->roomIndex = -1;
+        assignment->bench = assignment->seat = 0;
+    }
+    if (fetched != MYSQL_NO_DATA) {
+        fprintf(stderr, "Fetching enrollments for Day %d failed: %s\n", day->day, mysql_stmt_error(statement));
+        mysql_stmt_free_result(statement);
+        return EXIT_FAILURE;
+    }
+    mysql_stmt_free_result(statement);
+
+    // Sorting here keeps the ORDER BY work off the server
+    qsort(day->assignments, day->count, sizeof(SeatAssignment), compareSeatAssignments);
+    day->newCount = day->count;
+    return EXIT_SUCCESS;
+}
+
+// The text-protocol version of mysqlStorageLoadDayEnrollments, kept to benchmark against
+int loadDayEnrollmentsText(MYSQL *connection, AllocationDay *day) {
+    char query[1024];
+    snprintf(query, sizeof(query),
+             "SELECT ss.student_id, ss.subject_id "
+             "FROM student_subjects ss "
+             "JOIN students s ON s.id = ss.student_id "
+             "WHERE ss.subject_index = %d "
+             "AND NOT EXISTS (SELECT 1 FROM seat_allocation a "
+             "WHERE a.student_id = ss.student_id "
+             "AND a.subject_id = ss.subject_id "
+             "AND a.day = %d)", day->day, day->day);
+
+    if (dbQuery(connection, query, QUERY_ALLOCATION_READ)) {
+        fprintf(stderr, "Query failed: %s\n", mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+    MYSQL_RES *result = mysql_use_result(connection);
+    if (result == NULL) {
+        fprintf(stderr, "Could not retrieve result set: %s\n", mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+
+    int capacity = 0;
+    MYSQL_ROW row;
+    while ((row = dbFetchRow(result, QUERY_ALLOCATION_READ))) {
+        if (day->count == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            SeatAssignment *grown = realloc(day->assignments, sizeof(SeatAssignment) * capacity);
+            if (grown == NULL) {
+                fprintf(stderr, "Memory allocation failed for enrollments.\n");
+                mysql_free_result(result);
+                return EXIT_FAILURE;
+            }
+            day->assignments = grown;
+        }
+        SeatAssignment *assignment = &day->assignments[day->count++];
+        assignment->student_id = atoi(row[0]);
+        assignment->subject_id = atoi(row[1]);
+        assignment->roomIndex = -1;
+        assignment->bench = assignment->seat = 0;
+    }
+    int fetchFailed = mysql_errno(connection) != 0;
+    mysql_free_result(result);
+    if (fetchFailed) {
+        fprintf(stderr, "Fetching enrollments for Day %d failed: %s\n", day->day, mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+
+    // Sorting here keeps the ORDER BY work off the server
+    qsort(day->assignments, day->count, sizeof(SeatAssignment), compareSeatAssignments);
+    day->newCount = day->count;
+    return EXIT_SUCCESS;
+}
+
+// Streams the seats already saved for a day, flagging the ones whose sitting was dropped since
+int mysqlStorageLoadExistingSeats(void *session, const AllocationEngine *engine, AllocationDay *day) {
+    MYSQL_STMT *statement = statementCacheGet(session, savedSeatsQuery);
+    if (statement == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    int dayNumber = day->day, columns[6], i;
+    MYSQL_BIND param, results[6];
+    bindInt(&param, &dayNumber);
+    for (i = 0; i < 6; i++) {
+        bindInt(&results[i], &columns[i]);
+    }
+    if (mysql_stmt_bind_param(statement, &param) || dbStatementExecute(statement, QUERY_ALLOCATION_READ) ||
+        mysql_stmt_bind_result(statement, results)) {
+        fprintf(stderr, "Query for existing seats failed: %s\n", mysql_stmt_error(statement));
+        mysql_stmt_free_result(statement);
+        return EXIT_FAILURE;
+    }
+
+    int capacity = 0, fetched;
+    while ((fetched = dbStatementFetch(statement, QUERY_ALLOCATION_READ)) == 0) {
+        if (day->existingCount == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            ExistingSeat *grown = realloc(day->existing, sizeof(ExistingSeat) * capacity);
+            if (grown == NULL) {
+                fprintf(stderr, "Memory allocation failed for existing seats.\n");
+                mysql_stmt_free_result(statement);
+                return EXIT_FAILURE;
+            }
+            day->existing = grown;
+        }
+        ExistingSeat *existing = &day->existing[day->existingCount++];
+        existing->assignment.student_id = columns[0];
+        existing->assignment.subject_id = columns[1];
+        existing->assignment.roomIndex = intMapFind(&engine->roomSlots, columns[2]); // -1 if the room is gone
+        existing->assignment.bench = columns[3];
+        existing->assignment.seat = columns[4];
+        existing->enrolled = columns[5] != 0;
+        existing->kept = 0;
+    }
+    if (fetched != MYSQL_NO_DATA) {
+        fprintf(stderr, "Fetching existing seats for Day %d failed: %s\n", day->day, mysql_stmt_error(statement));
+        mysql_stmt_free_result(statement);
+        return EXIT_FAILURE;
+    }
+    mysql_stmt_free_result(statement);
+
+    return reserveDisplacedSeats(day);
+}
+
+// Orders a day's saved seats like its sittings and makes room to append every one of them to the
+// sittings to place, should it be displaced
+int reserveDisplacedSeats(AllocationDay *day) {
+    qsort(day->existing, day->existingCount, sizeof(ExistingSeat), compareSeatAssignments);
+    if (day->existingCount > 0) {
+        SeatAssignment *grown = realloc(day->assignments,
+                                        sizeof(SeatAssignment) * (day->newCount + day->existingCount));
+        if (grown == NULL) {
+            fprintf(stderr, "Memory allocation failed for enrollments.\n");
+            return EXIT_FAILURE;
+        }
+        day->assignments = grown;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Puts the saved seats that are still valid back into the rooms: the room still exists and still
+// has that bench and seat, the student still sits the subject that day, nobody else was given the
+// seat and no neighbour sits the same subject. The rest are displaced; those still enrolled are
+// appended to the sittings to place. Nothing valid moves, so printed hall tickets stay correct.
+void seatExistingSeats(SeatWorkspace *workspace, AllocationDay *day) {
+    int i;
+    day->count = day->newCount;
+    day->kept = day->displaced = 0;
+    for (i = 0; i < day->existingCount; i++) {
+        ExistingSeat *existing = &day->existing[i];
+        SeatAssignment *assignment = &existing->assignment;
+        int first = i == 0 || compareSeatAssignments(existing - 1, existing) != 0;
+        int duplicate = !first || (i + 1 < day->existingCount && compareSeatAssignments(existing, existing + 1) == 0);
+        int valid = !duplicate && existing->enrolled && assignment->roomIndex >= 0;
+
+        if (valid) {
+            const Room *room = &workspace->rooms[assignment->roomIndex];
+            int seatIndex = benchSeatOffset(room, assignment->bench) + assignment->seat;
+            const uint64_t *blocked = room->blocked + (size_t)assignment->subjectSlot * room->seatWords;
+            valid = assignment->bench >= 0 && assignment->bench < room->total_benches && assignment->seat >= 0 &&
+                    assignment->seat < benchSeatCount(room, assignment->bench) &&
+                    !(((room->occupied[seatIndex >> 6] | blocked[seatIndex >> 6]) >> (seatIndex & 63)) & 1);
+        }
+
+        existing->kept = valid;
+        if (valid) {
+            placeSeat(&workspace->rooms[assignment->roomIndex], assignment->bench, assignment->seat,
+                      assignment->subject_id, assignment->subjectSlot);
+            day->kept++;
+            continue;
+        }
+        day->displaced++;
+        if (existing->enrolled && first) {
+            day->assignments[day->count++] = *assignment; // The deleted row takes every copy with it
+        }
+    }
+}
+
+// Loads the rooms and works out which days need seating; sittings are loaded per day by the workers.
+// session is the calling thread's session on storage; workers open their own.
+int allocationEngineInit(AllocationEngine *engine, StorageBackend *storage, void *session, int maxDays) {
+    int i;
+    memset(engine, 0, sizeof(*engine));
+    engine->storage = storage;
+    engine->session = session;
+    if (storage->loadRooms(session, engine) == EXIT_FAILURE ||
+        storage->countDays(session, maxDays, &engine->dayCount) == EXIT_FAILURE) {
+        allocationEngineFree(engine);
+        return EXIT_FAILURE;
+    }
+
+    engine->days = calloc(engine->dayCount > 0 ? engine->dayCount : 1, sizeof(AllocationDay));
+    if (engine->days == NULL) {
+        fprintf(stderr, "Memory allocation failed for exam days.\n");
+        allocationEngineFree(engine);
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < engine->dayCount; i++) {
+        engine->days[i].day = i + 1;
+    }
+    return EXIT_SUCCESS;
+}
+
+void allocationEngineFree(AllocationEngine *engine) {
+    int i;
+    for (i = 0; engine->days && i < engine->dayCount; i++) {
+        free(engine->days[i].assignments);
+        free(engine->days[i].existing);
+        intMapFree(&engine->days[i].subjects);
+    }
+    free(engine->days);
+    free(engine->rooms);
+    intMapFree(&engine->roomSlots);
+    memset(engine, 0, sizeof(*engine));
+}
+
+void bitsetSetRange(uint64_t *words, int from, int to) {
+    while (from < to) {
+        int bit = from & 63;
+        int span = to - from < 64 - bit ? to - from : 64 - bit;
+        words[from >> 6] |= (span == 64 ? ~(uint64_t)0 : (((uint64_t)1 << span) - 1)) << bit;
+        from += span;
+    }
+}
+
+// Takes a seat and blocks it, its neighbours on the bench and the benches in front and
+// behind for the same subject
+void placeSeat(Room *room, int bench, int seat, int subject_id, int subjectSlot) {
+    int offset = benchSeatOffset(room, bench);
+    int seats_per_bench = benchSeatCount(room, bench);
+    uint64_t *blocked = room->blocked + (size_t)subjectSlot * room->seatWords;
+
+    room->seats[offset + seat] = subject_id;
+    room->occupied[(offset + seat) >> 6] |= (uint64_t)1 << ((offset + seat) & 63);
+
+    bitsetSetRange(blocked, offset + (seat > 0 ? seat - 1 : 0),
+                   offset + (seat + 2 < seats_per_bench ? seat + 2 : seats_per_bench));
+    if (bench > 0) {
+        bitsetSetRange(blocked, offset - benchSeatCount(room, bench - 1), offset);
+    }
+    if (bench < room->total_benches - 1) {
+        bitsetSetRange(blocked, offset + seats_per_bench, offset + seats_per_bench + benchSeatCount(room, bench + 1));
+    }
+}
+
+// Bits of a seat bitset word that correspond to real seats
+uint64_t seatWordMask(const Room *room, int word) {
+    if (word == room->seatWords - 1 && (room->seat_count & 63)) {
+        return ((uint64_t)1 << (room->seat_count & 63)) - 1;
+    }
+    return ~(uint64_t)0;
+}
+
+// Skips the words whose seats are all taken
+void advanceFirstFreeWord(Room *room) {
+    while (room->firstFreeWord < room->seatWords &&
+           room->occupied[room->firstFreeWord] == seatWordMask(room, room->firstFreeWord)) {
+        room->firstFreeWord++;
+    }
+}
+
+// First fit from startWord on: the lowest seat, in bench/seat order, that is neither taken nor
+// blocked for the subject. Same result as scanning with isAdjacentSeatConflict, 64 seats at a time.
+int findFreeSeat(const Room *room, int subjectSlot, int startWord, int *wordOut, int *benchOut, int *seatOut) {
+    const uint64_t *blocked = room->blocked + (size_t)subjectSlot * room->seatWords;
+    int word;
+    for (word = startWord; word < room->seatWords; word++) {
+        uint64_t candidates = ~(room->occupied[word] | blocked[word]) & seatWordMask(room, word);
+        if (candidates) {
+            int offset = word * 64 + csvCountTrailingZeros(candidates);
+            int twoSeats = room->two_seater_count * 2;
+            if (offset < twoSeats) {
+                *benchOut = offset / 2;
+                *seatOut = offset % 2;
+            } else {
+                *benchOut = room->two_seater_count + (offset - twoSeats) / 3;
+                *seatOut = (offset - twoSeats) % 3;
+            }
+            *wordOut = word;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// First fit: every sitting still without a seat, in student order, takes the lowest free seat its
+// subject may use
+int placeFirstFit(SeatWorkspace *workspace, AllocationDay *day) {
+    int i, r;
+    for (i = 0; i < day->count; i++) {
+        SeatAssignment *assignment = &day->assignments[i];
+        SubjectCursor *cursor = &workspace->cursors[assignment->subjectSlot];
+        long scanned = 0;
+        if (assignment->roomIndex >= 0) {
+            continue;
+        }
+
+        // Resume where this subject last found a seat, skipping words of the room that are full
+        for (r = cursor->room; r < workspace->roomCount; r++) {
+            Room *room = &workspace->rooms[r];
+            int word = r == cursor->room ? cursor->word : 0;
+            if (word < room->firstFreeWord) {
+                word = room->firstFreeWord;
+            }
+            int firstSeat = word * 64;
+            if (findFreeSeat(room, assignment->subjectSlot, word, &word, &assignment->bench, &assignment->seat)) {
+                placeSeat(room, assignment->bench, assignment->seat, assignment->subject_id, assignment->subjectSlot);
+                advanceFirstFreeWord(room);
+                assignment->roomIndex = r;
+                cursor->word = word;
+                scanned += benchSeatOffset(room, assignment->bench) + assignment->seat - firstSeat + 1;
+                break;
+            }
+            scanned += room->seat_count > firstSeat ? room->seat_count - firstSeat : 0;
+        }
+        cursor->room = r;
+        if (metrics.enabled) {
+            histogramRecord(&metrics.seatsScanned, (uint64_t)scanned);
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// Lane of a seat in the interleaving pattern. Outer seats of a bench share a lane, the middle seat
+// has its own, and even and odd benches use different lanes, so one subject per lane never conflicts.
+int interleaveLane(int bench, int seat) {
+    return (bench & 1) * 2 + (seat == 1);
+}
+
+// Subject for a lane that has to switch: the largest remaining bucket that may sit here, preferring
+// subjects no other lane is using so they keep their own seats. -1 if none fits and the seat stays empty.
+int pickInterleaveSubject(const Room *room, int seatIndex, const int *remaining, int subjectCount,
+                          const int *lanes, int lane) {
+    int best = -1, shared = -1;
+    int k, l;
+    for (k = 0; k < subjectCount; k++) {
+        const uint64_t *blocked = room->blocked + (size_t)k * room->seatWords;
+        if (remaining[k] == 0 || (blocked[seatIndex >> 6] >> (seatIndex & 63)) & 1) {
+            continue;
+        }
+        for (l = 0; l < INTERLEAVE_LANES && (l == lane || lanes[l] != k); l++) {
+        }
+        if (l == INTERLEAVE_LANES) {
+            if (best < 0 || remaining[k] > remaining[best]) best = k;
+        } else if (shared < 0 || remaining[k] > remaining[shared]) {
+            shared = k;
+        }
+    }
+    return best >= 0 ? best : shared;
+}
+
+// Subject interleaving: sittings are bucketed by subject and every room is filled seat by seat,
+// each lane of the pattern drawing from one bucket until it runs out. Lanes are handed the largest
+// buckets again at every room, so the buckets drain evenly. Linear in the number of seats and
+// sittings; with four or more subjects every seat of a room can be used. Whatever is left once fewer
+// subjects remain than lanes goes into the gaps by first fit.
+int placeInterleaved(SeatWorkspace *workspace, AllocationDay *day) {
+    int *start = calloc(day->subjectCount + 1, sizeof(int));
+    int *remaining = calloc(day->subjectCount + 1, sizeof(int));
+    int *order = malloc(sizeof(int) * (day->count > 0 ? day->count : 1));
+    int lanes[INTERLEAVE_LANES] = {-1, -1, -1, -1};
+    int placed = 0;
+    int i, r;
+
+    if (start == NULL || remaining == NULL || order == NULL) {
+        fprintf(stderr, "Memory allocation failed for subject buckets.\n");
+        free(start);
+        free(remaining);
+        free(order);
+        return EXIT_FAILURE;
+    }
+
+    // Counting sort by subject slot; each bucket stays in student order
+    for (i = 0; i < day->count; i++) {
+        remaining[day->assignments[i].subjectSlot]++;
+    }
+    for (i = 0; i < day->subjectCount; i++) {
+        start[i + 1] = start[i] + remaining[i];
+    }
+    for (i = 0; i < day->count; i++) {
+        order[start[day->assignments[i].subjectSlot]++] = i;
+    }
+    for (i = 0; i < day->subjectCount; i++) {
+        start[i] -= remaining[i];
+    }
+
+    for (r = 0; r < workspace->roomCount && placed < day->count; r++) {
+        Room *room = &workspace->rooms[r];
+        int bench, seat, offset = 0;
+        // Largest buckets to the outer-seat lanes, which hold the most seats
+        for (i = 0; i < INTERLEAVE_LANES; i++) {
+            lanes[i] = -1;
+        }
+        for (i = 0; i < INTERLEAVE_LANES; i++) {
+            int lane = (i & 1) * 2 + (i >> 1);
+            lanes[lane] = pickInterleaveSubject(room, 0, remaining, day->subjectCount, lanes, lane);
+        }
+        for (bench = 0; bench < room->total_benches && placed < day->count; bench++) {
+            int seats_per_bench = benchSeatCount(room, bench);
+            for (seat = 0; seat < seats_per_bench && placed < day->count; seat++) {
+                int lane = interleaveLane(bench, seat);
+                int subject = lanes[lane];
+                int seatIndex = offset + seat;
+                if ((room->occupied[seatIndex >> 6] >> (seatIndex & 63)) & 1) {
+                    continue; // Kept from an earlier run
+                }
+                if (subject < 0 || remaining[subject] == 0 ||
+                    ((room->blocked + (size_t)subject * room->seatWords)[seatIndex >> 6] >> (seatIndex & 63)) & 1) {
+                    subject = pickInterleaveSubject(room, seatIndex, remaining, day->subjectCount, lanes, lane);
+                    lanes[lane] = subject;
+                    if (subject < 0) {
+                        continue;
+                    }
+                }
+
+                SeatAssignment *assignment = &day->assignments[order[start[subject]++]];
+                remaining[subject]--;
+                assignment->roomIndex = r;
+                assignment->bench = bench;
+                assignment->seat = seat;
+                placeSeat(room, bench, seat, assignment->subject_id, subject);
+                placed++;
+            }
+            offset += seats_per_bench;
+        }
+    }
+
+    free(start);
+    free(remaining);
+    free(order);
+    return placed < day->count ? placeFirstFit(workspace, day) : EXIT_SUCCESS;
+}
+
+const PlacementStrategy placementStrategies[] = {
+    {"First Fit", "first-fit", placeFirstFit},
+    {"Subject Interleaving", "interleaved", placeInterleaved},
+};
+#define PLACEMENT_STRATEGY_COUNT ((int)(sizeof(placementStrategies) / sizeof(placementStrategies[0])))
+
+// Seats one day entirely in memory on a workspace, which is grown if the day has more subjects
+// than it was built for. Every day starts with empty rooms.
+int allocateDay(SeatWorkspace *workspace, const Room *rooms, int roomCount, const PlacementStrategy *strategy,
+                AllocationDay *day) {
+    int i, r;
+
+    if (workspace->arena.block == NULL || day->subjectCount > workspace->subjectCapacity) {
+        seatWorkspaceFree(workspace);
+        if (seatWorkspaceInit(workspace, rooms, roomCount, day->subjectCount) == EXIT_FAILURE) {
+            return EXIT_FAILURE;
+        }
+    } else {
+        seatWorkspaceClear(workspace);
+    }
+
+    if (day->existingCount > 0) {
+        seatExistingSeats(workspace, day);
+    }
+    for (i = 0; i < day->count; i++) {
+        day->assignments[i].roomIndex = -1;
+    }
+    if (strategy->place(workspace, day) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    day->allocated = day->failed = 0;
+    for (i = 0; i < day->count; i++) {
+        if (day->assignments[i].roomIndex < 0) {
+            day->failed++;
+        } else {
+            day->allocated++;
+        }
+    }
+
+    day->roomsUsed = day->usedCapacity = 0;
+    for (r = 0; r < workspace->roomCount; r++) {
+        const Room *room = &workspace->rooms[r];
+        for (i = 0; i < room->seatWords && room->occupied[i] == 0; i++) {
+        }
+        if (i < room->seatWords) {
+            day->roomsUsed++;
+            day->usedCapacity += room->seat_count;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// Loads one day's sittings, and in incremental runs its saved seats, on the given connection
+int loadAllocationDay(AllocationEngine *engine, void *session, AllocationDay *day) {
+    double start = getCurrentTimeSeconds();
+    if (engine->storage->loadDayEnrollments(session, day) == EXIT_FAILURE ||
+        (engine->incremental && engine->storage->loadExistingSeats(session, engine, day) == EXIT_FAILURE) ||
+        mapDaySubjects(day) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    day->loadSeconds = getCurrentTimeSeconds() - start;
+    metricsRecordPhase(PHASE_ALLOCATION_LOAD, day->loadSeconds);
+    return EXIT_SUCCESS;
+}
+
+void *dayPrefetchThread(void *arg) {
+    DayPrefetch *prefetch = arg;
+    mysql_thread_init();
+    prefetch->status = loadAllocationDay(prefetch->engine, prefetch->session, prefetch->day);
+    mysql_thread_end();
+    return NULL;
+}
+
+// Takes days off a shared counter until none are left. While one day is being placed, the next one
+// is already streaming in on the prefetch session, so the placement only waits for what is left
+// of that query. Without a prefetch session the next day is loaded after the placement.
+int runAllocationWorker(AllocationEngine *engine, void *session, void *prefetchSession,
+                        _Atomic int *nextDay, _Atomic int *failed) {
+    SeatWorkspace workspace = {0};
+    int status = EXIT_SUCCESS;
+    int index = atomic_fetch_add(nextDay, 1);
+
+    if (index < engine->dayCount) {
+        AllocationDay *day = &engine->days[index];
+        status = loadAllocationDay(engine, session, day);
+        day->waitSeconds = day->loadSeconds;
+    }
+    while (index < engine->dayCount && status == EXIT_SUCCESS && !atomic_load(failed)) {
+        AllocationDay *day = &engine->days[index];
+        int next = atomic_fetch_add(nextDay, 1);
+        int prefetching = 0;
+        DayPrefetch prefetch = {0};
+
+        if (next < engine->dayCount && prefetchSession != NULL) {
+            prefetch.engine = engine;
+            prefetch.session = prefetchSession;
+            prefetch.day = &engine->days[next];
+            prefetching = pthread_create(&prefetch.thread, NULL, dayPrefetchThread, &prefetch) == 0;
+        }
+
+        double start = getCurrentTimeSeconds();
+        status = allocateDay(&workspace, engine->rooms, engine->roomCount, engine->strategy, day);
+        double placed = getCurrentTimeSeconds();
+        day->allocateSeconds = placed - start;
+        metricsRecordPhase(PHASE_ALLOCATION_PLACE, day->allocateSeconds);
+
+        if (next < engine->dayCount) {
+            if (prefetching) {
+                pthread_join(prefetch.thread, NULL);
+                if (prefetch.status == EXIT_FAILURE) status = EXIT_FAILURE;
+            } else if (status == EXIT_SUCCESS) {
+                status = loadAllocationDay(engine, session, &engine->days[next]);
+            }
+            engine->days[next].waitSeconds = getCurrentTimeSeconds() - placed;
+        }
+        index = next;
+    }
+
+    if (status == EXIT_FAILURE) {
+        atomic_store(failed, 1);
+    }
+    seatWorkspaceFree(&workspace);
+    return status;
+}
+
+void *allocationWorkerThread(void *arg) {
+    AllocationWorker *worker = arg;
+    mysql_thread_init();
+    runAllocationWorker(worker->engine, worker->session, worker->prefetchSession, worker->nextDay, worker->failed);
+    mysql_thread_end();
+    return NULL;
+}
+
+// Loads and seats every day on up to workerCount threads, each with a second session to prefetch
+// its next day. Days share nothing but the read-only rooms, so the result does not depend on the
+// number of workers.
+int allocationEngineRun(AllocationEngine *engine, int workerCount) {
+    StorageBackend *storage = engine->storage;
+    _Atomic int nextDay = 0;
+    _Atomic int failed = 0;
+    int i, started = 0;
+
+    if (workerCount > engine->dayCount) {
+        workerCount = engine->dayCount;
+    }
+    if (workerCount <= 1) {
+        void *prefetchSession = engine->dayCount > 1 ? storage->openSession(storage) : NULL;
+        runAllocationWorker(engine, engine->session, prefetchSession, &nextDay, &failed);
+        if (prefetchSession != NULL) {
+            storage->closeSession(storage, prefetchSession);
+        }
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    AllocationWorker *workers = calloc(workerCount, sizeof(AllocationWorker));
+    if (workers == NULL) {
+        fprintf(stderr, "Memory allocation failed for allocation workers.\n");
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < workerCount; i++) {
+        workers[i].session = storage->openSession(storage);
+        workers[i].prefetchSession = workers[i].session ? storage->openSession(storage) : NULL;
+        if (workers[i].prefetchSession == NULL) {
+            atomic_store(&failed, 1);
+            break;
+        }
+    }
+
+    for (i = 0; i < workerCount && !atomic_load(&failed); i++) {
+        workers[i].engine = engine;
+        workers[i].nextDay = &nextDay;
+        workers[i].failed = &failed;
+        if (pthread_create(&workers[i].thread, NULL, allocationWorkerThread, &workers[i])) {
+            fprintf(stderr, "Could not start allocation worker %d.\n", i);
+            atomic_store(&failed, 1);
+            break;
+        }
+        started++;
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    for (i = 0; i < workerCount; i++) {
+        if (workers[i].session != NULL) {
+            storage->closeSession(storage, workers[i].session);
+        }
+        if (workers[i].prefetchSession != NULL) {
+            storage->closeSession(storage, workers[i].prefetchSession);
+        }
+    }
+    free(workers);
+    return atomic_load(&failed) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Deletes the displaced seats and saves every placed seat, all or nothing
+int allocationEngineFlush(AllocationEngine *engine, long *writtenRows, long *deletedRows) {
+    return engine->storage->saveSeats(engine->session, engine, writtenRows, deletedRows);
+}
+
+// Deletes the displaced seats and writes every placed seat of every day, in day order, with
+// multi-row prepared statements in a single transaction
+int mysqlStorageSaveSeats(void *session, const AllocationEngine *engine, long *writtenRows, long *deletedRows) {
+    StatementCache *cache = session;
+    MYSQL *connection = cache->connection;
+    StatementBatch deletes, inserts;
+    int status = EXIT_FAILURE;
+    int d, i;
+
+    if (statementBatchInit(&deletes, cache, "DELETE FROM seat_allocation WHERE (student_id, subject_id, day) IN (",
+                           ")", 3, QUERY_ALLOCATION_WRITE) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    if (statementBatchInit(&inserts, cache,
+                           "INSERT INTO seat_allocation (student_id, subject_id, room_id, bench_number, seat_number, "
+                           "day) VALUES ", NULL, 6, QUERY_ALLOCATION_WRITE) == EXIT_FAILURE) {
+        statementBatchFree(&deletes);
+        return EXIT_FAILURE;
+    }
+
+    if (mysql_autocommit(connection, 0)) {
+        fprintf(stderr, "Could not start transaction: %s\n", mysql_error(connection));
+        goto cleanup;
+    }
+
+    for (d = 0; d < engine->dayCount; d++) {
+        const AllocationDay *day = &engine->days[d];
+        for (i = 0; i < day->existingCount; i++) {
+            const ExistingSeat *existing = &day->existing[i];
+            if (existing->kept) {
+                continue;
+            }
+            int row[3] = {existing->assignment.student_id, existing->assignment.subject_id, day->day};
+            if (statementBatchAdd(&deletes, row)) {
+                goto rollback;
+            }
+            (*deletedRows)++;
+        }
+    }
+    if (statementBatchFlush(&deletes)) goto rollback;
+
+    for (d = 0; d < engine->dayCount; d++) {
+        const AllocationDay *day = &engine->days[d];
+        for (i = 0; i < day->count; i++) {
+            const SeatAssignment *assignment = &day->assignments[i];
+            if (assignment->roomIndex < 0) {
+                continue;
+            }
+            int row[6] = {assignment->student_id, assignment->subject_id, engine->rooms[assignment->roomIndex].room_id,
+                          assignment->bench, assignment->seat, day->day};
+            if (statementBatchAdd(&inserts, row)) {
+                goto rollback;
+            }
+            (*writtenRows)++;
+        }
+    }
+    if (statementBatchFlush(&inserts)) goto rollback;
+
+    if (dbCommit(connection, QUERY_ALLOCATION_WRITE)) {
+        fprintf(stderr, "Commit failed: %s\n", mysql_error(connection));
+        goto rollback;
+    }
+    status = EXIT_SUCCESS;
+    goto restore;
+
+rollback:
+    mysql_rollback(connection);
+    *writtenRows = *deletedRows = 0;
+restore:
+    mysql_autocommit(connection, 1);
+cleanup:
+    statementBatchFree(&deletes);
+    statementBatchFree(&inserts);
+    return status;
+}
+
+// A session is a connection of its own with its own prepared statements
+void *mysqlStorageOpenSession(StorageBackend *storage) {
+    (void)storage;
+    StatementCache *cache = malloc(sizeof(StatementCache));
+    if (cache == NULL) {
+        fprintf(stderr, "Memory allocation failed for statement cache.\n");
+        return NULL;
+    }
+    MYSQL *connection = openDatabaseConnection();
+    if (connection == NULL) {
+        free(cache);
+        return NULL;
+    }
+    statementCacheInit(cache, connection);
+    return cache;
+}
+
+void mysqlStorageCloseSession(StorageBackend *storage, void *session) {
+    StatementCache *cache = session;
+    (void)storage;
+    statementCacheClose(cache);
+    mysql_close(cache->connection);
+    free(cache);
+}
+
+int mysqlStorageCountSeats(void *session, int afterDay, long *count) {
+    MYSQL *connection = ((StatementCache *)session)->connection;
+    char query[128];
+    snprintf(query, sizeof(query), "SELECT COUNT(*) FROM seat_allocation WHERE day > %d", afterDay);
+    if (dbQuery(connection, query, QUERY_ALLOCATION_READ)) {
+        fprintf(stderr, "Query failed: %s\n", mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+    MYSQL_RES *result = mysql_store_result(connection);
+    if (result == NULL) {
+        fprintf(stderr, "Could not retrieve the seat count: %s\n", mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+    MYSQL_ROW row = dbFetchRow(result, QUERY_ALLOCATION_READ);
+    *count = (row && row[0]) ? atol(row[0]) : 0;
+    mysql_free_result(result);
+    return EXIT_SUCCESS;
+}
+
+int mysqlStorageLoadNames(void *session, NameDictionary *students, NameDictionary *subjects) {
+    return loadNameDictionaries(((StatementCache *)session)->connection, students, subjects);
+}
+
+int loadNameDictionaries(MYSQL *connection, NameDictionary *students, NameDictionary *subjects) {
+    if (loadNameDictionary(connection, "SELECT id, symbol_number FROM students", students) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    if (loadNameDictionary(connection, "SELECT id, subject_name FROM subjects", subjects) == EXIT_FAILURE) {
+        freeNameDictionary(students);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// The exam database; the main thread's session is mainStatements
+StorageBackend mysqlStorage = {
+    "MySQL", NULL, mysqlStorageOpenSession, mysqlStorageCloseSession, mysqlStorageLoadRooms,
+    mysqlStorageCountDays, mysqlStorageLoadDayEnrollments, mysqlStorageLoadExistingSeats, mysqlStorageCountSeats,
+    mysqlStorageSaveSeats, mysqlStorageLoadNames,
+};
+
+// ==== In-memory storage ====
+
+// Grows *items to hold at least needed elements, doubling so appends stay amortised O(1)
+int growArray(void **items, size_t *capacity, size_t needed, size_t itemSize) {
+    if (needed <= *capacity) {
+        return EXIT_SUCCESS;
+    }
+    size_t grown = *capacity ? *capacity : 1024;
+    while (grown < needed) {
+        grown *= 2;
+    }
+    void *resized = realloc(*items, grown * itemSize);
+    if (resized == NULL) {
+        fprintf(stderr, "Memory allocation failed for in-memory storage.\n");
+        return EXIT_FAILURE;
+    }
+    *items = resized;
+    *capacity = grown;
+    return EXIT_SUCCESS;
+}
+
+int memoryStorageInit(MemoryStorage *store) {
+    memset(store, 0, sizeof(*store));
+    if (nameDictionaryInit(&store->students) == EXIT_FAILURE || nameDictionaryInit(&store->subjects) == EXIT_FAILURE ||
+        idDictionaryInit(&store->studentIds, 0) == EXIT_FAILURE ||
+        idDictionaryInit(&store->subjectIds, 0) == EXIT_FAILURE || pairSetInit(&store->enrolled, 0) == EXIT_FAILURE ||
+        intMapInit(&store->subjectCounts, 0) == EXIT_FAILURE) {
+        memoryStorageFree(store);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+void memoryStorageFree(MemoryStorage *store) {
+    freeNameDictionary(&store->students);
+    freeNameDictionary(&store->subjects);
+    idDictionaryFree(&store->studentIds);
+    idDictionaryFree(&store->subjectIds);
+    pairSetFree(&store->enrolled);
+    intMapFree(&store->subjectCounts);
+    free(store->enrollments);
+    free(store->rooms);
+    free(store->seats);
+    memset(store, 0, sizeof(*store));
+}
+
+StorageBackend memoryStorageBackend(MemoryStorage *store) {
+    StorageBackend storage = {
+        "In-memory", store, memoryStorageOpenSession, memoryStorageCloseSession, memoryStorageLoadRooms,
+        memoryStorageCountDays, memoryStorageLoadDayEnrollments, memoryStorageLoadExistingSeats,
+        memoryStorageCountSeats, memoryStorageSaveSeats, memoryStorageLoadNames,
+    };
+    return storage;
+}
+
+// Returns the id of a student or subject key, adding it under id (or the next free id when id is 0);
+// 0 on failure
+int memoryStorageIntern(IdDictionary *ids, NameDictionary *names, int *lastId, const char *key, size_t length,
+                        int id) {
+    int known = idDictionaryFind(ids, key, length);
+    if (known != 0) {
+        return known;
+    }
+    if (id == 0) {
+        id = *lastId + 1;
+    }
+    if (idDictionaryPut(ids, key, length, id) == EXIT_FAILURE || nameDictionaryAdd(names, id, key) == EXIT_FAILURE) {
+        return 0;
+    }
+    if (id > *lastId) {
+        *lastId = id;
+    }
+    return id;
+}
+
+// Adds an enrollment; subject_index 0 numbers it after the student's other subjects, as the database
+// does. Returns 1 if it was added, 0 if the student already takes the subject, -1 on failure.
+int memoryStorageEnroll(MemoryStorage *store, int student_id, int subject_id, int subject_index) {
+    int added = pairSetInsert(&store->enrolled, student_id, subject_id);
+    if (added <= 0) {
+        return added;
+    }
+    int taken = intMapFind(&store->subjectCounts, student_id);
+    taken = taken < 0 ? 1 : taken + 1;
+    if (intMapPut(&store->subjectCounts, student_id, taken) == EXIT_FAILURE ||
+        growArray((void **)&store->enrollments, &store->enrollmentCapacity, store->enrollmentCount + 1,
+                  sizeof(MemoryEnrollment)) == EXIT_FAILURE) {
+        return -1;
+    }
+    MemoryEnrollment *enrollment = &store->enrollments[store->enrollmentCount++];
+    enrollment->student_id = student_id;
+    enrollment->subject_id = subject_id;
+    enrollment->subject_index = subject_index ? subject_index : taken;
+    return 1;
+}
+
+// Rooms must be added in increasing room_id order; room_id 0 takes the next one
+int memoryStorageAddRoom(MemoryStorage *store, int room_id, int room_number, int twoSeaters, int threeSeaters) {
+    if (growArray((void **)&store->rooms, &store->roomCapacity, store->roomCount + 1, sizeof(Room)) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    Room *room = &store->rooms[store->roomCount];
+    memset(room, 0, sizeof(*room));
+    room->room_id = room_id ? room_id : (store->roomCount ? store->rooms[store->roomCount - 1].room_id + 1 : 1);
+    room->room_number = room_number;
+    room->two_seater_count = twoSeaters;
+    room->total_benches = twoSeaters + threeSeaters;
+    store->roomCount++;
+    return EXIT_SUCCESS;
+}
+
+// Reads students.csv rows (symbol_number, name, college_name, subjects separated by ';') into the store
+int memoryStorageIngestCSV(MemoryStorage *store, const char *filename, long *rowsOut) {
+    CsvReader reader;
+    if (csvReaderOpen(&reader, filename) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not open CSV file\n");
+        return EXIT_FAILURE;
+    }
+
+    CsvField fields[4];
+    int fieldCount;
+    long rows = 0;
+    char *key = NULL; // Sized from each field, so long symbols and subjects are interned whole
+    size_t keyCapacity = 0;
+    int status = EXIT_FAILURE;
+    while ((fieldCount = csvReaderNextRecord(&reader, fields, 4)) > 0) {
+        if (fieldCount < 4) {
+            fprintf(stderr, "Skipping malformed CSV line %ld.\n", reader.line);
+            continue;
+        }
+
+        if (growArray((void **)&key, &keyCapacity, fields[0].length + 1, 1) == EXIT_FAILURE) {
+            goto cleanup;
+        }
+        size_t length = csvFieldCopy(&fields[0], key, keyCapacity);
+        int student_id = memoryStorageIntern(&store->studentIds, &store->students, &store->lastStudentId,
+                                             key, length, 0);
+        if (student_id == 0) {
+            goto cleanup;
+        }
+
+        size_t subjectOffset = 0;
+        CsvField subjectField;
+        while (csvNextSubfield(&fields[3], ';', &subjectOffset, &subjectField)) {
+            if (growArray((void **)&key, &keyCapacity, subjectField.length + 1, 1) == EXIT_FAILURE) {
+                goto cleanup;
+            }
+            length = csvFieldCopy(&subjectField, key, keyCapacity);
+            int subject_id = memoryStorageIntern(&store->subjectIds, &store->subjects, &store->lastSubjectId,
+                                                 key, length, 0);
+            int added = subject_id ? memoryStorageEnroll(store, student_id, subject_id, 0) : -1;
+            if (added < 0) {
+                goto cleanup;
+            }
+            rows += added;
+        }
+    }
+    *rowsOut = rows;
+    status = EXIT_SUCCESS;
+
+cleanup:
+    free(key);
+    csvReaderClose(&reader);
+    return status;
+}
+
+// Reads room_number, two_seater_count, three_seater_count rows
+int memoryStorageLoadRoomsCSV(MemoryStorage *store, const char *filename) {
+    CsvReader reader;
+    if (csvReaderOpen(&reader, filename) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not open %s\n", filename);
+        return EXIT_FAILURE;
+    }
+
+    CsvField fields[3];
+    int fieldCount;
+    while ((fieldCount = csvReaderNextRecord(&reader, fields, 3)) > 0) {
+        char values[3][32];
+        int i;
+        if (fieldCount < 3) {
+            fprintf(stderr, "Skipping malformed room on line %ld.\n", reader.line);
+            continue;
+        }
+        for (i = 0; i < 3; i++) {
+            csvFieldCopy(&fields[i], values[i], sizeof(values[i]));
+        }
+        if (atoi(values[1]) < 0 || atoi(values[2]) < 0) {
+            fprintf(stderr, "Skipping room with negative bench counts on line %ld.\n", reader.line);
+            continue;
+        }
+        if (memoryStorageAddRoom(store, 0, atoi(values[0]), atoi(values[1]), atoi(values[2])) == EXIT_FAILURE) {
+            csvReaderClose(&reader);
+            return EXIT_FAILURE;
+        }
+    }
+    csvReaderClose(&reader);
+    return EXIT_SUCCESS;
+}
+
+// Copies the allocation tables out of the database, keeping their ids, so runs on the copy place
+// exactly what a run on the database would
+int memoryStorageCopyDatabase(MemoryStorage *store, MYSQL *connection) {
+    NameDictionary students, subjects;
+    size_t i;
+    int slot;
+
+    if (loadNameDictionaries(connection, &students, &subjects) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    int status = EXIT_SUCCESS;
+    for (slot = 0; slot < (int)students.ids.capacity && status == EXIT_SUCCESS; slot++) {
+        if (students.ids.keys[slot]) {
+            const char *symbol = students.names[students.ids.values[slot]];
+            if (memoryStorageIntern(&store->studentIds, &store->students, &store->lastStudentId, symbol,
+                                    strlen(symbol), students.ids.keys[slot]) == 0) {
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+    for (slot = 0; slot < (int)subjects.ids.capacity && status == EXIT_SUCCESS; slot++) {
+        if (subjects.ids.keys[slot]) {
+            const char *name = subjects.names[subjects.ids.values[slot]];
+            if (memoryStorageIntern(&store->subjectIds, &store->subjects, &store->lastSubjectId, name, strlen(name),
+                                    subjects.ids.keys[slot]) == 0) {
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+    freeNameDictionary(&students);
+    freeNameDictionary(&subjects);
+    if (status == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    const char *queries[] = {
+        "SELECT id, room_number, two_seater_count, three_seater_count FROM rooms ORDER BY id",
+        "SELECT student_id, subject_id, subject_index FROM student_subjects",
+        "SELECT student_id, subject_id, room_id, bench_number, seat_number, day FROM seat_allocation",
+    };
+    for (i = 0; i < sizeof(queries) / sizeof(queries[0]) && status == EXIT_SUCCESS; i++) {
+        if (dbQuery(connection, queries[i], QUERY_ALLOCATION_READ)) {
+            fprintf(stderr, "Query failed: %s\n", mysql_error(connection));
+            return EXIT_FAILURE;
+        }
+        MYSQL_RES *result = mysql_use_result(connection);
+        if (result == NULL) {
+            fprintf(stderr, "Could not retrieve result set: %s\n", mysql_error(connection));
+            return EXIT_FAILURE;
+        }
+        MYSQL_ROW tableRow;
+        while ((tableRow = dbFetchRow(result, QUERY_ALLOCATION_READ))) {
+            if (status == EXIT_FAILURE) {
+                continue; // Drain the stream before bailing out
+            }
+            if (i == 0) {
+                status = memoryStorageAddRoom(store, atoi(tableRow[0]), atoi(tableRow[1]), atoi(tableRow[2]),
+                                              atoi(tableRow[3]));
+            } else if (i == 1) {
+                int subject_index = tableRow[2] ? atoi(tableRow[2]) : -1; // NULL never matches a day
+                status = memoryStorageEnroll(store, atoi(tableRow[0]), atoi(tableRow[1]), subject_index) < 0
+                         ? EXIT_FAILURE : EXIT_SUCCESS;
+            } else if (growArray((void **)&store->seats, &store->seatCapacity, store->seatCount + 1,
+                                 sizeof(MemorySeat)) == EXIT_FAILURE) {
+                status = EXIT_FAILURE;
+            } else {
+                MemorySeat *seat = &store->seats[store->seatCount++];
+                seat->student_id = atoi(tableRow[0]);
+                seat->subject_id = atoi(tableRow[1]);
+                seat->room_id = atoi(tableRow[2]);
+                seat->bench_number = atoi(tableRow[3]);
+                seat->seat_number = atoi(tableRow[4]);
+                seat->day = atoi(tableRow[5]);
+            }
+        }
+        if (mysql_errno(connection)) {
+            fprintf(stderr, "Copy stopped early: %s\n", mysql_error(connection));
+            status = EXIT_FAILURE;
+        }
+        mysql_free_result(result);
+    }
+    return status;
+}
+
+// Every thread reads the same tables; only saveSeats writes, and nothing reads while it runs
+void *memoryStorageOpenSession(StorageBackend *storage) {
+    return storage->state;
+}
+
+void memoryStorageCloseSession(StorageBackend *storage, void *session) {
+    (void)storage;
+    (void)session;
+}
+
+int memoryStorageLoadRooms(void *session, AllocationEngine *engine) {
+    MemoryStorage *store = session;
+    size_t i;
+
+    engine->rooms = calloc(store->roomCount > 0 ? store->roomCount : 1, sizeof(Room));
+    if (engine->rooms == NULL) {
+        fprintf(stderr, "Memory allocation failed for rooms.\n");
+        return EXIT_FAILURE;
+    }
+    if (intMapInit(&engine->roomSlots, store->roomCount * 2 + 16) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < store->roomCount; i++) {
+        engine->rooms[engine->roomCount] = store->rooms[i];
+        if (intMapPut(&engine->roomSlots, store->rooms[i].room_id, engine->roomCount++) == EXIT_FAILURE) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int memoryStorageCountDays(void *session, int maxDays, int *dayCount) {
+    MemoryStorage *store = session;
+    size_t i;
+    *dayCount = 0;
+    for (i = 0; i < store->enrollmentCount; i++) {
+        int day = store->enrollments[i].subject_index;
+        if (day <= maxDays && day > *dayCount) {
+            *dayCount = day;
+        }
+    }
+    for (i = 0; i < store->seatCount; i++) {
+        if (store->seats[i].day <= maxDays && store->seats[i].day > *dayCount) {
+            *dayCount = store->seats[i].day;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int memoryStorageLoadDayEnrollments(void *session, AllocationDay *day) {
+    MemoryStorage *store = session;
+    PairSet seated;
+    size_t i, capacity = 0;
+
+    if (pairSetInit(&seated, 0) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < store->seatCount; i++) {
+        if (store->seats[i].day == day->day &&
+            pairSetInsert(&seated, store->seats[i].student_id, store->seats[i].subject_id) < 0) {
+            pairSetFree(&seated);
+            return EXIT_FAILURE;
+        }
+    }
+    for (i = 0; i < store->enrollmentCount; i++) {
+        const MemoryEnrollment *enrollment = &store->enrollments[i];
+        if (enrollment->subject_index != day->day ||
+            pairSetContains(&seated, enrollment->student_id, enrollment->subject_id)) {
+            continue;
+        }
+        if (growArray((void **)&day->assignments, &capacity, (size_t)day->count + 1, sizeof(SeatAssignment)) ==
+            EXIT_FAILURE) {
+            pairSetFree(&seated);
+            return EXIT_FAILURE;
+        }
+        SeatAssignment *assignment = &day->assignments[day->count++];
+        assignment->student_id = enrollment->student_id;
+        assignment->subject_id = enrollment->subject_id;
+        assignment->roomIndex = -1;
+        assignment->bench = assignment->seat = 0;
+    }
+    pairSetFree(&seated);
+
+    qsort(day->assignments, day->count, sizeof(SeatAssignment), compareSeatAssignments);
+    day->newCount = day->count;
+    return EXIT_SUCCESS;
+}
+
+int memoryStorageLoadExistingSeats(void *session, const AllocationEngine *engine, AllocationDay *day) {
+    MemoryStorage *store = session;
+    PairSet enrolled;
+    size_t i, capacity = 0;
+
+    if (pairSetInit(&enrolled, 0) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < store->enrollmentCount; i++) {
+        const MemoryEnrollment *enrollment = &store->enrollments[i];
+        if (enrollment->subject_index == day->day &&
+            pairSetInsert(&enrolled, enrollment->student_id, enrollment->subject_id) < 0) {
+            pairSetFree(&enrolled);
+            return EXIT_FAILURE;
+        }
+    }
+    for (i = 0; i < store->seatCount; i++) {
+        const MemorySeat *seat = &store->seats[i];
+        if (seat->day != day->day) {
+            continue;
+        }
+        if (growArray((void **)&day->existing, &capacity, (size_t)day->existingCount + 1, sizeof(ExistingSeat)) ==
+            EXIT_FAILURE) {
+            pairSetFree(&enrolled);
+            return EXIT_FAILURE;
+        }
+        ExistingSeat *existing = &day->existing[day->existingCount++];
+        existing->assignment.student_id = seat->student_id;
+        existing->assignment.subject_id = seat->subject_id;
+        existing->assignment.roomIndex = intMapFind(&engine->roomSlots, seat->room_id); // -1 if the room is gone
+        existing->assignment.bench = seat->bench_number;
+        existing->assignment.seat = seat->seat_number;
+        existing->enrolled = pairSetContains(&enrolled, seat->student_id, seat->subject_id);
+        existing->kept = 0;
+    }
+    pairSetFree(&enrolled);
+    return reserveDisplacedSeats(day);
+}
+
+int memoryStorageCountSeats(void *session, int afterDay, long *count) {
+    MemoryStorage *store = session;
+    size_t i;
+    *count = 0;
+    for (i = 0; i < store->seatCount; i++) {
+        if (store->seats[i].day > afterDay) {
+            (*count)++;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// Builds the new seat table aside and swaps it in, so a failure leaves the saved seats as they were
+int memoryStorageSaveSeats(void *session, const AllocationEngine *engine, long *writtenRows, long *deletedRows) {
+    MemoryStorage *store = session;
+    PairSet *displaced = calloc(engine->dayCount > 0 ? engine->dayCount : 1, sizeof(PairSet));
+    MemorySeat *seats = NULL;
+    size_t placed = 0, count = 0, i;
+    int status = EXIT_FAILURE;
+    int d;
+
+    if (displaced == NULL) {
+        fprintf(stderr, "Memory allocation failed for in-memory storage.\n");
+        return EXIT_FAILURE;
+    }
+    for (d = 0; d < engine->dayCount; d++) {
+        const AllocationDay *day = &engine->days[d];
+        if (pairSetInit(&displaced[d], 0) == EXIT_FAILURE) {
+            goto cleanup;
+        }
+        for (i = 0; i < (size_t)day->existingCount; i++) {
+            const ExistingSeat *existing = &day->existing[i];
+            if (!existing->kept &&
+                pairSetInsert(&displaced[d], existing->assignment.student_id, existing->assignment.subject_id) < 0) {
+                goto cleanup;
+            }
+        }
+        for (i = 0; i < (size_t)day->count; i++) {
+            placed += day->assignments[i].roomIndex >= 0;
+        }
+    }
+
+    size_t capacity = store->seatCount + placed + 1;
+    seats = malloc(sizeof(MemorySeat) * capacity);
+    if (seats == NULL) {
+        fprintf(stderr, "Memory allocation failed for in-memory storage.\n");
+        goto cleanup;
+    }
+    for (i = 0; i < store->seatCount; i++) {
+        const MemorySeat *seat = &store->seats[i];
+        if (seat->day >= 1 && seat->day <= engine->dayCount &&
+            pairSetContains(&displaced[seat->day - 1], seat->student_id, seat->subject_id)) {
+            continue;
+        }
+        seats[count++] = *seat;
+    }
+    *deletedRows += (long)(store->seatCount - count);
+    for (d = 0; d < engine->dayCount; d++) {
+        const AllocationDay *day = &engine->days[d];
+        for (i = 0; i < (size_t)day->count; i++) {
+            const SeatAssignment *assignment = &day->assignments[i];
+            if (assignment->roomIndex < 0) {
+                continue;
+            }
+            MemorySeat *seat = &seats[count++];
+            seat->student_id = assignment->student_id;
+            seat->subject_id = assignment->subject_id;
+            seat->room_id = engine->rooms[assignment->roomIndex].room_id;
+            seat->bench_number = assignment->bench;
+            seat->seat_number = assignment->seat;
+            seat->day = day->day;
+        }
+    }
+    *writtenRows += (long)placed;
+
+    free(store->seats);
+    store->seats = seats;
+    store->seatCount = count;
+    store->seatCapacity = capacity;
+    status = EXIT_SUCCESS;
+
+cleanup:
+    for (d = 0; d < engine->dayCount; d++) {
+        pairSetFree(&displaced[d]);
+    }
+    free(displaced);
+    return status;
+}
+
+int memoryStorageLoadNames(void *session, NameDictionary *students, NameDictionary *subjects) {
+    MemoryStorage *store = session;
+    if (nameDictionaryCopy(students, &store->students) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    if (nameDictionaryCopy(subjects, &store->subjects) == EXIT_FAILURE) {
+        freeNameDictionary(students);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// eccs offline <students.csv> <rooms.csv> [days]: seats the students in memory, with rooms given as
+// room_number, two_seater_count, three_seater_count rows, and writes the seat matrix and seat plan.
+// Nothing connects to a database.
+int offlineCommand(int argc, char *argv[]) {
+    MemoryStorage store;
+    long rows = 0;
+
+    if (argc < 4 || argc > 5) {
+        fprintf(stderr, "Usage: %s offline <students.csv> <rooms.csv> [days]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int maxDays = argc == 5 ? atoi(argv[4]) : DEFAULT_EXAM_DAYS;
+    if (maxDays <= 0) {
+        fprintf(stderr, "Days must be a positive number.\n");
+        return EXIT_FAILURE;
+    }
+    if (memoryStorageInit(&store) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    double start = getCurrentTimeSeconds();
+    if (memoryStorageIngestCSV(&store, argv[2], &rows) == EXIT_FAILURE ||
+        memoryStorageLoadRoomsCSV(&store, argv[3]) == EXIT_FAILURE) {
+        memoryStorageFree(&store);
+        return EXIT_FAILURE;
+    }
+    double elapsed = getCurrentTimeSeconds() - start;
+    metricsRecordPhase(PHASE_INGEST, elapsed);
+    printf("Read %ld enrollments of %d students and %zu rooms in %.2f s.\n", rows, store.students.count,
+           store.roomCount, elapsed);
+
+    StorageBackend storage = memoryStorageBackend(&store);
+    int status = unifiedSeatAllocation(&storage, &store, maxDays, &placementStrategies[0], 0, "seat_allocation.csv");
+    memoryStorageFree(&store);
+    return status;
+}
+
+// ==== Batch commands ====
+
+void printUsage(const char *program) {
+    fprintf(stderr, "Usage: %s                  (interactive menu)\n", program);
+    fprintf(stderr, "       %s ingest [--mode row|bulk|parallel|delta] [--batch N] [--workers N] [students.csv]\n",
+            program);
+    fprintf(stderr, "       %s allocate [--days N] [--strategy first-fit|interleaved] [--incremental] "
+            "[--export FILE]\n", program);
+    fprintf(stderr, "       %s export [--format matrix|sheets|plan] [--output PATH] [--workers N]\n", program);
+    fprintf(stderr, "       %s reset --yes\n", program);
+    fprintf(stderr, "       %s serve [--listen PORT | --unix PATH]   (seat lookups over HTTP, default port %d)\n",
+            program, SEAT_SERVICE_PORT);
+    fprintf(stderr, "       %s offline <students.csv> <rooms.csv> [days]\n", program);
+    fprintf(stderr, "       %s lookup <seat plan> <symbol_number> [day]\n", program);
+    fprintf(stderr, "       %s verify <seat plan>\n", program);
+    fprintf(stderr, "\nDatabase commands also take --host, --user, --database, --port and --socket, or the\n");
+    fprintf(stderr, "ECCS_DB_HOST, ECCS_DB_USER, ECCS_DB_NAME, ECCS_DB_PORT and ECCS_DB_SOCKET variables.\n");
+    fprintf(stderr, "The password is only read from ECCS_DB_PASSWORD, so it does not show up in ps.\n");
+}
+
+int loadDatabaseSettings() {
+    const char *value;
+    if ((value = getenv("ECCS_DB_HOST")) != NULL) {
+        dbSettings.host = value;
+    }
+    if ((value = getenv("ECCS_DB_USER")) != NULL) {
+        dbSettings.user = value;
+    }
+    if ((value = getenv("ECCS_DB_PASSWORD")) != NULL) {
+        dbSettings.password = value;
+    }
+    if ((value = getenv("ECCS_DB_NAME")) != NULL) {
+        dbSettings.database = value;
+    }
+    if ((value = getenv("ECCS_DB_PORT")) != NULL) {
+        int port;
+        if (parseCount(value, &port) == EXIT_FAILURE) {
+            fprintf(stderr, "Invalid ECCS_DB_PORT: %s\n", value);
+            return EXIT_FAILURE;
+        }
+        dbSettings.port = (unsigned int)port;
+    }
+    if ((value = getenv("ECCS_DB_SOCKET")) != NULL) {
+        dbSettings.socket = value;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Whole positive numbers only, so a typo in a cron line fails instead of running with 0
+int parseCount(const char *text, int *value) {
+    char *end;
+    errno = 0;
+    long number = strtol(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || number <= 0 || number > INT32_MAX) {
+        return EXIT_FAILURE;
+    }
+    *value = (int)number;
+    return EXIT_SUCCESS;
+}
+
+int parseBatchOptions(int argc, char *argv[], BatchOptions *options) {
+    int i, s;
+    memset(options, 0, sizeof(*options));
+    options->command = argv[1];
+    options->mode = "row";
+    options->maxDays = DEFAULT_EXAM_DAYS;
+    options->strategy = &placementStrategies[0];
+    options->format = "matrix";
+
+    for (i = 2; i < argc; i++) {
+        const char *flag = argv[i];
+        if (strcmp(flag, "--incremental") == 0) {
+            options->incremental = 1;
+            continue;
+        }
+        if (strcmp(flag, "--yes") == 0) {
+            options->confirmed = 1;
+            continue;
+        }
+        if (strncmp(flag, "--", 2) != 0) {
+            if (options->input != NULL) {
+                fprintf(stderr, "Unexpected argument: %s\n", flag);
+                return EXIT_FAILURE;
+            }
+            options->input = flag;
+            continue;
+        }
+
+        // Every other flag takes a value
+        if (i + 1 == argc) {
+            fprintf(stderr, "%s needs a value.\n", flag);
+            return EXIT_FAILURE;
+        }
+        const char *value = argv[++i];
+        if (strcmp(flag, "--host") == 0) {
+            dbSettings.host = value;
+        } else if (strcmp(flag, "--user") == 0) {
+            dbSettings.user = value;
+        } else if (strcmp(flag, "--database") == 0) {
+            dbSettings.database = value;
+        } else if (strcmp(flag, "--socket") == 0) {
+            dbSettings.socket = value;
+        } else if (strcmp(flag, "--port") == 0) {
+            int port;
+            if (parseCount(value, &port) == EXIT_FAILURE) {
+                fprintf(stderr, "Invalid port: %s\n", value);
+                return EXIT_FAILURE;
+            }
+            dbSettings.port = (unsigned int)port;
+        } else if (strcmp(flag, "--listen") == 0) {
+            if (parseCount(value, &options->port) == EXIT_FAILURE || options->port > 65535) {
+                fprintf(stderr, "Invalid port: %s\n", value);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(flag, "--unix") == 0) {
+            options->unixPath = value;
+        } else if (strcmp(flag, "--days") == 0) {
+            if (parseCount(value, &options->maxDays) == EXIT_FAILURE) {
+                fprintf(stderr, "Days must be a positive number.\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(flag, "--batch") == 0) {
+            if (parseCount(value, &options->batchSize) == EXIT_FAILURE) {
+                fprintf(stderr, "Batch size must be a positive number.\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(flag, "--workers") == 0) {
+            if (parseCount(value, &options->workers) == EXIT_FAILURE) {
+                fprintf(stderr, "Workers must be a positive number.\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(flag, "--strategy") == 0) {
+            options->strategy = NULL;
+            for (s = 0; s < PLACEMENT_STRATEGY_COUNT; s++) {
+                if (strcmp(value, placementStrategies[s].option) == 0) {
+                    options->strategy = &placementStrategies[s];
+                }
+            }
+            if (options->strategy == NULL) {
+                fprintf(stderr, "Unknown placement strategy: %s\n", value);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(flag, "--mode") == 0) {
+            if (strcmp(value, "row") != 0 && strcmp(value, "bulk") != 0 && strcmp(value, "parallel") != 0 &&
+                strcmp(value, "delta") != 0) {
+                fprintf(stderr, "Unknown ingest mode: %s\n", value);
+                return EXIT_FAILURE;
+            }
+            options->mode = value;
+        } else if (strcmp(flag, "--export") == 0) {
+            options->exportFile = value;
+        } else if (strcmp(flag, "--format") == 0) {
+            if (strcmp(value, "matrix") != 0 && strcmp(value, "sheets") != 0 && strcmp(value, "plan") != 0) {
+                fprintf(stderr, "Unknown export format: %s\n", value);
+                return EXIT_FAILURE;
+            }
+            options->format = value;
+        } else if (strcmp(flag, "--output") == 0) {
+            options->output = value;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", flag);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// Runs one step of the ingest, allocate and export pipeline without prompts, pauses or screen clears.
+// The exit status says whether it worked, so the steps can be chained in a script.
+int batchCommand(int argc, char *argv[]) {
+    BatchOptions options;
+    const char *command = argv[1];
+    int known = strcmp(command, "ingest") == 0 || strcmp(command, "allocate") == 0 ||
+                strcmp(command, "export") == 0 || strcmp(command, "reset") == 0 || strcmp(command, "serve") == 0;
+
+    if (!known) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (parseBatchOptions(argc, argv, &options) == EXIT_FAILURE) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (options.input != NULL && strcmp(command, "ingest") != 0) {
+        fprintf(stderr, "Unexpected argument: %s\n", options.input);
+        return EXIT_FAILURE;
+    }
+    if (strcmp(command, "reset") == 0 && !options.confirmed) {
+        fprintf(stderr, "reset empties every table; pass --yes to confirm.\n");
+        return EXIT_FAILURE;
+    }
+    if (connectDatabase() == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_FAILURE;
+    if (strcmp(command, "ingest") == 0) {
+        const char *filename = options.input != NULL ? options.input : "students.csv";
+        int batchSize = options.batchSize > 0 ? options.batchSize : DEFAULT_BULK_BATCH_SIZE;
+        if (strcmp(options.mode, "row") == 0) {
+            status = parseAndInsertCSV(filename);
+        } else if (strcmp(options.mode, "bulk") == 0) {
+            status = bulkInsertCSV(filename, batchSize);
+        } else if (strcmp(options.mode, "parallel") == 0) {
+            status = parallelInsertCSV(filename, options.workers > 0 ? options.workers : DEFAULT_INGEST_WRITERS,
+                                       batchSize);
+        } else {
+            status = deltaInsertCSV(filename);
+        }
+    } else if (strcmp(command, "allocate") == 0) {
+        status = unifiedSeatAllocation(&mysqlStorage, &mainStatements, options.maxDays, options.strategy,
+                                       options.incremental, options.exportFile);
+    } else if (strcmp(command, "export") == 0) {
+        if (strcmp(options.format, "matrix") == 0) {
+            status = exportAllocatedSeatsMatrix(options.output != NULL ? options.output : "seat_allocation.csv");
+        } else if (strcmp(options.format, "sheets") == 0) {
+            status = exportSeatSheets(options.output != NULL ? options.output : SHEET_DIRECTORY,
+                                      options.workers > 0 ? options.workers : DEFAULT_EXPORT_WORKERS);
+        } else {
+            status = exportSeatPlan(options.output != NULL ? options.output : SEAT_PLAN_FILE);
+        }
+    } else if (strcmp(command, "serve") == 0) {
+        status = serveCommand(&options);
+    } else {
+        status = resetTables();
+    }
+
+    disconnectDatabase();
+    return status;
+}
+
+// Lets the user pick a placement strategy, re-check the saved seats and place only what they no
+// longer cover, or compare the strategies on the current enrollments without saving
+void allocationMenu(int maxDays) {
+    int i;
+    printf("\nPlacement Strategy:\n");
+    for (i = 0; i < PLACEMENT_STRATEGY_COUNT; i++) {
+        printf("%d. %s\n", i + 1, placementStrategies[i].name);
+    }
+    printf("%d. Incremental (re-checks every saved seat, places and writes only changes)\n",
+           PLACEMENT_STRATEGY_COUNT + 1);
+    printf("%d. Compare Fill Rates (nothing is saved)\n", PLACEMENT_STRATEGY_COUNT + 2);
+    printf("%d. Back\n", PLACEMENT_STRATEGY_COUNT + 3);
+    int choice = getValidatedChoice("\nEnter your choice: ");
+
+    if (choice >= 1 && choice <= PLACEMENT_STRATEGY_COUNT + 1) {
+        const char *exportFile =
+            getValidatedChoice("Enter 1 to also export the seat matrix and seat plan from this run, 0 to skip: ") == 1
+            ? "seat_allocation.csv" : NULL;
+        if (choice <= PLACEMENT_STRATEGY_COUNT) {
+            unifiedSeatAllocation(&mysqlStorage, &mainStatements, maxDays, &placementStrategies[choice - 1], 0,
+                                  exportFile);
+        } else {
+            // Gaps are best filled in place
+            unifiedSeatAllocation(&mysqlStorage, &mainStatements, maxDays, &placementStrategies[0], 1, exportFile);
+        }
+    } else if (choice == PLACEMENT_STRATEGY_COUNT + 2) {
+        AllocationEngine engine;
+        if (allocationEngineInit(&engine, &mysqlStorage, &mainStatements, maxDays) == EXIT_FAILURE) {
+            return;
+        }
+        engine.strategy = &placementStrategies[0];
+        if (allocationEngineRun(&engine, DEFAULT_ALLOCATION_WORKERS) == EXIT_SUCCESS) {
+            compareFillRates(&engine);
+        }
+        allocationEngineFree(&engine);
+    } else if (choice != PLACEMENT_STRATEGY_COUNT + 3) {
+        printf("Invalid choice.\n");
+    }
+}
+
+// Loads the rooms once, loads and seats the days in parallel in memory, then persists all days in one
+// transaction. An incremental run reads and re-checks every saved seat, so its load still grows with the
+// exam; it keeps the seats that are still valid and only its placement and writes grow with the change.
+// With an exportFile the seat matrix and the binary seat plan are then written from the run's own state
+// instead of re-queried. session is the calling thread's session on storage.
+int unifiedSeatAllocation(StorageBackend *storage, void *session, int maxDays, const PlacementStrategy *strategy,
+                          int incremental, const char *exportFile) {
+    double startTime = getCurrentTimeSeconds();
+    AllocationEngine engine;
+    if (allocationEngineInit(&engine, storage, session, maxDays) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    if (engine.dayCount == 0) {
+        printf("No subjects found for any student.\n");
+        allocationEngineFree(&engine);
+        return EXIT_SUCCESS;
+    }
+    engine.strategy = strategy;
+    engine.incremental = incremental;
+
+    // The in-memory export only knows this run's seats: saved seats on other days, or on any day when
+    // the run is not incremental, send it back to the database export
+    long unknownSeats = 0;
+    if (exportFile != NULL && storage->countSeats(session, incremental ? engine.dayCount : 0, &unknownSeats)) {
+        unknownSeats = -1;
+    }
+
+    printf("\n%s seats for %d days (%s)...\n", incremental ? "Re-allocating" : "Allocating", engine.dayCount,
+           strategy->name);
+    if (allocationEngineRun(&engine, DEFAULT_ALLOCATION_WORKERS) == EXIT_FAILURE) {
+        printf("\nSeat allocation failed; no seats were saved.\n");
+        allocationEngineFree(&engine);
+        return EXIT_FAILURE;
+    }
+    double allocatedTime = getCurrentTimeSeconds();
+
+    double loadSeconds = 0, waitSeconds = 0, allocateSeconds = 0;
+    int d, i;
+    for (d = 0; d < engine.dayCount; d++) {
+        const AllocationDay *day = &engine.days[d];
+        for (i = 0; i < day->count; i++) {
+            if (day->assignments[i].roomIndex < 0) {
+                printf("Failed to allocate seat for student %d (Subject: %d) on Day %d.\n",
+                       day->assignments[i].student_id, day->assignments[i].subject_id, day->day);
+            }
+        }
+
+        printf("\nDay %d Allocation Summary:\n", day->day);
+        printf("Total Allocated: %d\n", day->allocated);
+        printf("Total Failed: %d\n", day->failed);
+        if (incremental) {
+            printf("Re-checked %d saved seats: kept %d, displaced %d\n", day->existingCount, day->kept,
+                   day->displaced);
+        }
+        printf("Rooms used: %d, fill rate: %.1f%%\n", day->roomsUsed,
+               day->usedCapacity > 0 ? 100.0 * (day->allocated + day->kept) / day->usedCapacity : 0.0);
+        printf("Load: %.3f s (%.3f s hidden by prefetch), allocate: %.3f s\n", day->loadSeconds,
+               day->loadSeconds > day->waitSeconds ? day->loadSeconds - day->waitSeconds : 0.0,
+               day->allocateSeconds);
+        loadSeconds += day->loadSeconds;
+        waitSeconds += day->waitSeconds < day->loadSeconds ? day->waitSeconds : day->loadSeconds;
+        allocateSeconds += day->allocateSeconds;
+    }
+    printf("\nAll days: load %.3f s, of which %.3f s overlapped placement; allocate %.3f s.\n", loadSeconds,
+           loadSeconds - waitSeconds, allocateSeconds);
+
+    long writtenRows = 0, deletedRows = 0;
+    int status = EXIT_FAILURE;
+    double flushTime = getCurrentTimeSeconds();
+    if (allocationEngineFlush(&engine, &writtenRows, &deletedRows) == EXIT_FAILURE) {
+        printf("\nSeat allocation was rolled back; no seats were saved.\n");
+    } else {
+        double endTime = getCurrentTimeSeconds();
+        metricsRecordPhase(PHASE_ALLOCATION_SAVE, endTime - flushTime);
+        if (incremental) {
+            printf("\nRemoved %ld displaced seats.\n", deletedRows);
+        }
+        printf("\nSaved %ld seats for %d days.\n", writtenRows, engine.dayCount);
+        printf("Load and allocate: %.2f s, save: %.2f s, total: %.2f s.\n",
+               allocatedTime - startTime, endTime - allocatedTime, endTime - startTime);
+        status = EXIT_SUCCESS;
+
+        if (exportFile != NULL && unknownSeats != 0 && storage != &mysqlStorage) {
+            printf("\nSeats saved before this run are not in memory; nothing was exported.\n");
+        } else if (exportFile != NULL && unknownSeats != 0) {
+            printf("\nSeats saved before this run are not in memory; exporting from the database.\n");
+            if (exportAllocatedSeatsMatrix(exportFile) == EXIT_FAILURE ||
+                exportSeatPlan(SEAT_PLAN_FILE) == EXIT_FAILURE) {
+                status = EXIT_FAILURE;
+            }
+        } else if (exportFile != NULL) {
+            SeatPlanBuilder plan;
+            long exportedSeats = 0;
+            double exportStart = getCurrentTimeSeconds();
+            status = EXIT_FAILURE;
+            if (seatPlanBuilderInit(&plan) == EXIT_SUCCESS &&
+                exportEngineSeatMatrix(&engine, exportFile, &plan, &exportedSeats) == EXIT_SUCCESS &&
+                seatPlanBuilderWrite(&plan, SEAT_PLAN_FILE) == EXIT_SUCCESS) {
+                double elapsed = getCurrentTimeSeconds() - exportStart;
+                metricsRecordPhase(PHASE_EXPORT, elapsed);
+                printf("\nSeat matrix exported from memory to %s, seat plan to %s.\n", exportFile, SEAT_PLAN_FILE);
+                printf("Exported %ld seats in %.2f s (%.0f rows/s).\n", exportedSeats, elapsed,
+                       elapsed > 0 ? exportedSeats / elapsed : 0.0);
+                status = EXIT_SUCCESS;
+            }
+            seatPlanBuilderFree(&plan);
+        }
+    }
+    allocationEngineFree(&engine);
+    return status;
+}
+
+// Seats the loaded days with every strategy and prints how full each one gets the rooms. Fill rate
+// is seated sittings over the seats of the rooms a strategy had to use; the days keep the last run.
+void compareFillRates(AllocationEngine *engine) {
+    int s, d;
+
+    printf("\nFill rate by placement strategy (%d rooms, %d days)\n", engine->roomCount, engine->dayCount);
+    printf("%-22s | %8s | %8s | %10s | %9s | %9s\n", "Strategy", "Seated", "Failed", "Rooms used", "Fill rate",
+           "Seconds");
+    printf("-------------------------------------------------------------------------------\n");
+    for (s = 0; s < PLACEMENT_STRATEGY_COUNT; s++) {
+        SeatWorkspace workspace = {0};
+        long seated = 0, failed = 0, capacity = 0;
+        int roomsNeeded = 0;
+        double start = getCurrentTimeSeconds();
+        for (d = 0; d < engine->dayCount; d++) {
+            AllocationDay *day = &engine->days[d];
+            if (allocateDay(&workspace, engine->rooms, engine->roomCount, &placementStrategies[s], day) ==
+                EXIT_FAILURE) {
+                seatWorkspaceFree(&workspace);
+                return;
+            }
+            seated += day->allocated;
+            failed += day->failed;
+            capacity += day->usedCapacity;
+            if (day->roomsUsed > roomsNeeded) roomsNeeded = day->roomsUsed;
+        }
+        double elapsed = getCurrentTimeSeconds() - start;
+        seatWorkspaceFree(&workspace);
+
+        printf("%-22s | %8ld | %8ld | %10d | %8.1f%% | %9.3f\n", placementStrategies[s].name, seated, failed,
+               roomsNeeded, capacity > 0 ? 100.0 * seated / capacity : 0.0, elapsed);
+    }
+    printf("Rooms used is the most rooms any single day needed.\n");
+}
+
+// A seat conflicts when a neighbour on the same bench, or any seat on the bench in front or
+// behind, already sits the same subject. Neighbouring benches use their own seat count.
+int isAdjacentSeatConflict(const Room *room, int bench, int seat, int subject_id) {
+    int i;
+    int seats_per_bench = benchSeatCount(room, bench);
+    int offset = benchSeatOffset(room, bench);
+    const int *benchSeats = room->seats + offset;
+    for (i = -1; i <= 1; i++) {  // Check adjacent seats: -1 (left), 0 (current), 1 (right)
+        int adjacentSeat = seat + i;
+        if (adjacentSeat >= 0 && adjacentSeat < seats_per_bench && benchSeats[adjacentSeat] == subject_id) {
+            return 1;  // Conflict detected
+        }
+    }
+
+    // Every seat on the bench in front and the bench behind; they sit right before and after this one
+    if (bench > 0) {
+        for (i = offset - benchSeatCount(room, bench - 1); i < offset; i++) {
+            if (room->seats[i] == subject_id) {
+                return 1;
+            }
+        }
+    }
+    if (bench < room->total_benches - 1) {
+        int next = offset + seats_per_bench;
+        for (i = next; i < next + benchSeatCount(room, bench + 1); i++) {
+            if (room->seats[i] == subject_id) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;  // No conflict
+}
+
+int seatMatrixWriterOpen(SeatMatrixWriter *writer, const char *filename, size_t capacity) {
+    return seatMatrixWriterOpenMode(writer, filename, "w", capacity);
+}
+
+int seatMatrixWriterOpenMode(SeatMatrixWriter *writer, const char *filename, const char *mode, size_t capacity) {
+    memset(writer, 0, sizeof(*writer));
+    writer->data = malloc(capacity);
+    if (writer->data == NULL) {
+        return EXIT_FAILURE;
+    }
+    writer->file = fopen(filename, mode);
+    if (writer->file == NULL) {
+        free(writer->data);
+        return EXIT_FAILURE;
+    }
+    writer->capacity = capacity;
+    return EXIT_SUCCESS;
+}
+
+void seatMatrixWriterFlush(SeatMatrixWriter *writer) {
+    if (writer->length > 0 && !writer->failed &&
+        fwrite(writer->data, 1, writer->length, writer->file) != writer->length) {
+        writer->failed = 1;
+    }
+    writer->length = 0;
+}
+
+void seatMatrixWriterAppend(SeatMatrixWriter *writer, const char *text, size_t length) {
+    if (length > writer->capacity - writer->length) {
+        seatMatrixWriterFlush(writer);
+        if (length > writer->capacity) {
+            if (!writer->failed && fwrite(text, 1, length, writer->file) != length) {
+                writer->failed = 1;
+            }
+            return;
+        }
+    }
+    memcpy(writer->data + writer->length, text, length);
+    writer->length += length;
+}
+
+void seatMatrixWriterText(SeatMatrixWriter *writer, const char *text) {
+    seatMatrixWriterAppend(writer, text, strlen(text));
+}
+
+void seatMatrixWriterInt(SeatMatrixWriter *writer, long value) {
+    char digits[24];
+    int length = snprintf(digits, sizeof(digits), "%ld", value);
+    seatMatrixWriterAppend(writer, digits, (size_t)length);
+}
+
+// Flushes what is left and closes the file; fails if any write did
+int seatMatrixWriterClose(SeatMatrixWriter *writer) {
+    seatMatrixWriterFlush(writer);
+    if (fclose(writer->file) != 0) {
+        writer->failed = 1;
+    }
+    free(writer->data);
+    return writer->failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Writes one seat as "symbol (subject), "
+void seatMatrixWriterSeat(SeatMatrixWriter *writer, const char *symbol, size_t symbolLength, const char *subject,
+                          size_t subjectLength) {
+    seatMatrixWriterAppend(writer, symbol, symbolLength);
+    seatMatrixWriterText(writer, " (");
+    seatMatrixWriterAppend(writer, subject, subjectLength);
+    seatMatrixWriterText(writer, "), ");
+}
+
+// Adds one seat to a seat matrix, opening day, room and bench sections as they change. Seats must
+// come ordered by day, room number, bench and seat.
+void seatMatrixWriteSeat(SeatMatrixWriter *writer, SeatMatrixCursor *cursor, int day, int room_number,
+                         int bench_number, const char *symbol, size_t symbolLength, const char *subject,
+                         size_t subjectLength) {
+    if (cursor->seats++ == 0) {
+        seatMatrixWriterText(writer, "Allocated Seats Matrix\n");
+        seatMatrixWriterText(writer, "=======================\n\n");
+    }
+
+    // Section for a new day
+    if (day != cursor->day) {
+        if (cursor->day != -1) seatMatrixWriterText(writer, "\n\n\n"); // Add spacing between days
+        seatMatrixWriterText(writer, "Day ");
+        seatMatrixWriterInt(writer, day);
+        seatMatrixWriterText(writer, "\n-------\n");
+        cursor->day = day;
+        cursor->room_number = -1; // Reset room tracking
+    }
+
+    // Section for a new room
+    if (room_number != cursor->room_number) {
+        if (cursor->room_number != -1) seatMatrixWriterText(writer, "\n\n"); // Add spacing between rooms
+        seatMatrixWriterText(writer, "Room ");
+        seatMatrixWriterInt(writer, room_number);
+        seatMatrixWriterText(writer, "\n-------\n");
+        cursor->room_number = room_number;
+        cursor->bench_number = -1; // Bench numbers start over in every room
+    }
+
+    // Section for a new bench
+    if (bench_number != cursor->bench_number) {
+        if (cursor->seats > 1) seatMatrixWriterText(writer, "\n"); // Add spacing between benches
+        seatMatrixWriterText(writer, "Bench ");
+        seatMatrixWriterInt(writer, bench_number);
+        seatMatrixWriterText(writer, ": ");
+        cursor->bench_number = bench_number;
+    }
+
+    // Display seat allocation
+    seatMatrixWriterSeat(writer, symbol, symbolLength, subject, subjectLength);
+}
+
+void seatMatrixFinish(SeatMatrixWriter *writer, const SeatMatrixCursor *cursor) {
+    if (cursor->seats == 0) {
+        seatMatrixWriterText(writer, "No seat allocations available.\n");
+    } else {
+        seatMatrixWriterText(writer, "\n\nMatrix export complete.\n");
+    }
+}
+
+void exportMenu() {
+    printf("\nExport:\n");
+    printf("1. Seat Matrix (single file)\n");
+    printf("2. Room Sheets (one file per day and room)\n");
+    printf("3. Regenerate One Room Sheet\n");
+    printf("4. Seat Plan File (for lookups without the database)\n");
+    printf("5. Back\n");
+    int choice = getValidatedChoice("\nEnter your choice: ");
+
+    switch (choice) {
+        case 1:
+            exportAllocatedSeatsMatrix("seat_allocation.csv");
+            break;
+        case 2:
+            exportSeatSheets(SHEET_DIRECTORY, DEFAULT_EXPORT_WORKERS);
+            break;
+        case 3:
+            regenerateSeatSheet(SHEET_DIRECTORY);
+            break;
+        case 4:
+            exportSeatPlan(SEAT_PLAN_FILE);
+            break;
+        case 5:
+            break;
+        default:
+            printf("Invalid choice.\n");
+    }
+}
+
+// Streams the seat matrix with mysql_use_result, so client memory stays the same however many
+// seats the exam has, and writes it through one large buffer
+int exportAllocatedSeatsMatrix(const char *filename) {
+    double startTime = getCurrentTimeSeconds();
+    SeatMatrixWriter writer;
+    if (seatMatrixWriterOpen(&writer, filename, EXPORT_BUFFER_SIZE) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not open file for writing.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Query to fetch seat allocation details
+    char queryStr[1024];
+    snprintf(queryStr, sizeof(queryStr),
+             "SELECT a.day, r.room_number, a.bench_number, a.seat_number, s.symbol_number, sub.subject_name "
+             "FROM seat_allocation a "
+             "JOIN rooms r ON a.room_id = r.id "
+             "JOIN students s ON a.student_id = s.id "
+             "JOIN subjects sub ON a.subject_id = sub.id "
+             "ORDER BY a.day, r.room_number, a.bench_number, a.seat_number");
+
+    if (dbQuery(conn, queryStr, QUERY_EXPORT)) {
+        fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
+        seatMatrixWriterClose(&writer);
+        return EXIT_FAILURE;
+    }
+
+    res = mysql_use_result(conn);
+    if (res == NULL) {
+        fprintf(stderr, "Could not retrieve data: %s\n", mysql_error(conn));
+        seatMatrixWriterClose(&writer);
+        return EXIT_FAILURE;
+    }
+
+    SeatMatrixCursor cursor = {-1, -1, -1, 0};
+    while (!writer.failed && (row = dbFetchRow(res, QUERY_EXPORT))) {
+        unsigned long *lengths = mysql_fetch_lengths(res);
+        seatMatrixWriteSeat(&writer, &cursor, atoi(row[0]), atoi(row[1]), atoi(row[2]), row[4], lengths[4], row[5],
+                            lengths[5]);
+    }
+    long rows = cursor.seats;
+
+    // A lost connection ends the stream early; don't report a truncated matrix as complete
+    int streamFailed = mysql_errno(conn) != 0;
+    if (streamFailed) {
+        fprintf(stderr, "Export stopped after %ld seats: %s\n", rows, mysql_error(conn));
+    }
+    mysql_free_result(res);
+
+    if (streamFailed) {
+        // No trailer: a partial matrix must not look finished, so it is removed altogether
+        seatMatrixWriterClose(&writer);
+        remove(filename);
+        fprintf(stderr, "Removed the incomplete %s.\n", filename);
+        return EXIT_FAILURE;
+    }
+    seatMatrixFinish(&writer, &cursor);
+    if (rows == 0) {
+        printf("Query returned no results.\n");
+    }
+    if (seatMatrixWriterClose(&writer) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not write %s.\n", filename);
+        return EXIT_FAILURE;
+    }
+
+    double elapsed = getCurrentTimeSeconds() - startTime;
+    metricsRecordPhase(PHASE_EXPORT, elapsed);
+    printf("\nSeat matrix exported successfully to %s.\n", filename);
+    printf("Exported %ld seats in %.2f s (%.0f rows/s).\n", rows, elapsed, elapsed > 0 ? rows / elapsed : 0.0);
+    return EXIT_SUCCESS;
+}
+
+
+int nameDictionaryInit(NameDictionary *dict) {
+    memset(dict, 0, sizeof(*dict));
+    return intMapInit(&dict->ids, 0);
+}
+
+int nameDictionaryAdd(NameDictionary *dict, int id, const char *name) {
+    if (dict->count == dict->capacity) {
+        int capacity = dict->capacity ? dict->capacity * 2 : 1024;
+        const char **names = realloc(dict->names, sizeof(const char *) * capacity);
+        if (names == NULL) {
+            return EXIT_FAILURE;
+        }
+        dict->names = names;
+        dict->capacity = capacity;
+    }
+    const char *copy = stringPoolCopy(&dict->pool, name);
+    if (copy == NULL || intMapPut(&dict->ids, id, dict->count) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    dict->names[dict->count++] = copy;
+    return EXIT_SUCCESS;
+}
+
+// Fills dict with the entries of source; dict is freed on failure
+int nameDictionaryCopy(NameDictionary *dict, const NameDictionary *source) {
+    size_t slot;
+    if (nameDictionaryInit(dict) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    for (slot = 0; slot < source->ids.capacity; slot++) {
+        if (source->ids.keys[slot] &&
+            nameDictionaryAdd(dict, source->ids.keys[slot], source->names[source->ids.values[slot]]) == EXIT_FAILURE) {
+            fprintf(stderr, "Could not copy names.\n");
+            freeNameDictionary(dict);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// Loads id, name rows from query into dict, streaming them since the students table can be large
+int loadNameDictionary(MYSQL *connection, const char *query, NameDictionary *dict) {
+    if (nameDictionaryInit(dict) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    if (dbQuery(connection, query, QUERY_EXPORT)) {
+        fprintf(stderr, "Name query failed: %s\n", mysql_error(connection));
+        freeNameDictionary(dict);
+        return EXIT_FAILURE;
+    }
+    MYSQL_RES *result = mysql_use_result(connection);
+    if (result == NULL) {
+        fprintf(stderr, "Could not retrieve names: %s\n", mysql_error(connection));
+        freeNameDictionary(dict);
+        return EXIT_FAILURE;
+    }
+
+    MYSQL_ROW nameRow;
+    int status = EXIT_SUCCESS;
+    while ((nameRow = dbFetchRow(result, QUERY_EXPORT))) {
+        if (status == EXIT_SUCCESS && nameDictionaryAdd(dict, atoi(nameRow[0]), nameRow[1] ? nameRow[1] : "") ==
+            EXIT_FAILURE) {
+            status = EXIT_FAILURE; // Drain the stream before bailing out
+        }
+    }
+    if (mysql_errno(connection)) {
+        fprintf(stderr, "Name query stopped early: %s\n", mysql_error(connection));
+        status = EXIT_FAILURE;
+    }
+    mysql_free_result(result);
+
+    if (status == EXIT_FAILURE) {
+        fprintf(stderr, "Could not load names.\n");
+        freeNameDictionary(dict);
+    }
+    return status;
+}
+
+const char *nameDictionaryFind(const NameDictionary *dict, int id) {
+    int index = intMapFind(&dict->ids, id);
+    return index >= 0 ? dict->names[index] : "?";
+}
+
+void freeNameDictionary(NameDictionary *dict) {
+    intMapFree(&dict->ids);
+    free(dict->names);
+    stringPoolFree(&dict->pool);
+    memset(dict, 0, sizeof(*dict));
+}
+
+// Orders Room pointers the way the seat matrix lists rooms
+int compareRoomNumbers(const void *a, const void *b) {
+    const Room *x = *(const Room *const *)a;
+    const Room *y = *(const Room *const *)b;
+    if (x->room_number != y->room_number) {
+        return x->room_number < y->room_number ? -1 : 1;
+    }
+    return (x->room_id > y->room_id) - (x->room_id < y->room_id);
+}
+
+// Writes the same file as exportAllocatedSeatsMatrix straight from an allocation run, so the engine must
+// hold every seat: all kept and placed ones of its days. Each day's seats are dropped into a grid laid
+// out like the rooms' seat blocks and read back in room order, which yields the matrix order without
+// sorting. Only the symbol numbers and subject names come from storage, as two plain scans.
+// plan, when given, collects the same seats for the binary seat plan
+int exportEngineSeatMatrix(const AllocationEngine *engine, const char *filename, SeatPlanBuilder *plan,
+                           long *seatsOut) {
+    NameDictionary students, subjects;
+    const Room **order = NULL;
+    int *roomBase = NULL;
+    const SeatAssignment **grid = NULL;
+    SeatMatrixWriter writer;
+    SeatMatrixCursor cursor = {-1, -1, -1, 0};
+    int status = EXIT_FAILURE;
+    int totalSeats = 0;
+    int d, i, r, s;
+
+    if (engine->storage->loadNames(engine->session, &students, &subjects) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    order = malloc(sizeof(const Room *) * (engine->roomCount + 1));
+    roomBase = malloc(sizeof(int) * (engine->roomCount + 1));
+    if (order == NULL || roomBase == NULL) {
+        fprintf(stderr, "Memory allocation failed for export.\n");
+        goto cleanup;
+    }
+    for (r = 0; r < engine->roomCount; r++) {
+        order[r] = &engine->rooms[r];
+        roomBase[r] = totalSeats;
+        totalSeats += benchSeatOffset(&engine->rooms[r], engine->rooms[r].total_benches);
+    }
+    qsort(order, engine->roomCount, sizeof(const Room *), compareRoomNumbers);
+    grid = malloc(sizeof(const SeatAssignment *) * (totalSeats + 1));
+    if (grid == NULL) {
+        fprintf(stderr, "Memory allocation failed for export.\n");
+        goto cleanup;
+    }
+    if (seatMatrixWriterOpen(&writer, filename, EXPORT_BUFFER_SIZE) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not open file for writing.\n");
+        goto cleanup;
+    }
+
+    for (d = 0; d < engine->dayCount && !writer.failed; d++) {
+        const AllocationDay *day = &engine->days[d];
+        memset(grid, 0, sizeof(const SeatAssignment *) * totalSeats);
+        for (i = 0; i < day->count; i++) {
+            const SeatAssignment *assignment = &day->assignments[i];
+            if (assignment->roomIndex >= 0) {
+                const Room *room = &engine->rooms[assignment->roomIndex];
+                grid[roomBase[assignment->roomIndex] + benchSeatOffset(room, assignment->bench) + assignment->seat] =
+                    assignment;
+            }
+        }
+        for (i = 0; i < day->existingCount; i++) {
+            const SeatAssignment *assignment = &day->existing[i].assignment;
+            if (day->existing[i].kept) {
+                const Room *room = &engine->rooms[assignment->roomIndex];
+                grid[roomBase[assignment->roomIndex] + benchSeatOffset(room, assignment->bench) + assignment->seat] =
+                    assignment;
+            }
+        }
+
+        for (r = 0; r < engine->roomCount; r++) {
+            const Room *room = order[r];
+            const SeatAssignment **seats = grid + roomBase[room - engine->rooms];
+            int seatCount = benchSeatOffset(room, room->total_benches);
+            for (s = 0; s < seatCount; s++) {
+                if (seats[s] == NULL) {
+                    continue;
+                }
+                const char *symbol = nameDictionaryFind(&students, seats[s]->student_id);
+                const char *subject = nameDictionaryFind(&subjects, seats[s]->subject_id);
+                seatMatrixWriteSeat(&writer, &cursor, day->day, room->room_number, seats[s]->bench, symbol,
+                                    strlen(symbol), subject, strlen(subject));
+                if (plan != NULL &&
+                    seatPlanBuilderAdd(plan, day->day, room->room_number, seats[s]->bench, seats[s]->seat, symbol,
+                                       strlen(symbol), subject, strlen(subject)) == EXIT_FAILURE) {
+                    seatMatrixWriterClose(&writer);
+                    goto cleanup;
+                }
+            }
+        }
+    }
+    seatMatrixFinish(&writer, &cursor);
+    if (seatMatrixWriterClose(&writer) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not write %s.\n", filename);
+        goto cleanup;
+    }
+    *seatsOut = cursor.seats;
+    status = EXIT_SUCCESS;
+
+cleanup:
+    free(grid);
+    free(roomBase);
+    free(order);
+    freeNameDictionary(&subjects);
+    freeNameDictionary(&students);
+    return status;
+}
+
+int seatPlanBuilderInit(SeatPlanBuilder *builder) {
+    memset(builder, 0, sizeof(*builder));
+    return idDictionaryInit(&builder->subjects, 0);
+}
+
+void seatPlanBuilderFree(SeatPlanBuilder *builder) {
+    free(builder->entries);
+    free(builder->subjectNames);
+    stringPoolFree(&builder->symbols);
+    idDictionaryFree(&builder->subjects);
+    memset(builder, 0, sizeof(*builder));
+}
+
+// Seats must be added in seat matrix order; the records keep that order
+int seatPlanBuilderAdd(SeatPlanBuilder *builder, int day, int room_number, int bench_number, int seat_number,
+                       const char *symbol, size_t symbolLength, const char *subject, size_t subjectLength) {
+    if (builder->count == builder->capacity) {
+        size_t capacity = builder->capacity ? builder->capacity * 2 : 4096;
+        SeatPlanEntry *entries = realloc(builder->entries, sizeof(SeatPlanEntry) * capacity);
+        if (entries == NULL) {
+            fprintf(stderr, "Memory allocation failed for seat plan.\n");
+            return EXIT_FAILURE;
+        }
+        builder->entries = entries;
+        builder->capacity = capacity;
+    }
+
+    int subjectIndex = idDictionaryFind(&builder->subjects, subject, subjectLength) - 1; // Stored as index + 1
+    if (subjectIndex < 0) {
+        if (builder->subjectCount == builder->subjectCapacity) {
+            int capacity = builder->subjectCapacity ? builder->subjectCapacity * 2 : 64;
+            const char **names = realloc(builder->subjectNames, sizeof(const char *) * capacity);
+            if (names == NULL) {
+                fprintf(stderr, "Memory allocation failed for seat plan.\n");
+                return EXIT_FAILURE;
+            }
+            builder->subjectNames = names;
+            builder->subjectCapacity = capacity;
+        }
+        subjectIndex = builder->subjectCount;
+        if (idDictionaryPut(&builder->subjects, subject, subjectLength, subjectIndex + 1) == EXIT_FAILURE) {
+            return EXIT_FAILURE;
+        }
+        builder->subjectNames[builder->subjectCount++] =
+            idDictionaryProbe(&builder->subjects, subject, subjectLength, hashKey(subject, subjectLength))->key;
+        if (subjectLength > builder->longestSubject) {
+            builder->longestSubject = subjectLength;
+        }
+    }
+
+    char *copy = stringPoolAlloc(&builder->symbols, symbolLength + 1);
+    if (copy == NULL) {
+        return EXIT_FAILURE;
+    }
+    memcpy(copy, symbol, symbolLength);
+    copy[symbolLength] = '\0';
+    if (symbolLength > builder->longestSymbol) {
+        builder->longestSymbol = symbolLength;
+    }
+
+    SeatPlanEntry *entry = &builder->entries[builder->count++];
+    entry->day = day;
+    entry->room_number = room_number;
+    entry->bench_number = bench_number;
+    entry->seat_number = seat_number;
+    entry->subject = subjectIndex;
+    entry->symbol = copy;
+    entry->symbolLength = symbolLength;
+    return EXIT_SUCCESS;
+}
+
+// Orders SeatPlanEntry pointers by symbol number, then by position, which is seat matrix order
+int compareSeatPlanEntries(const void *a, const void *b) {
+    const SeatPlanEntry *x = *(const SeatPlanEntry *const *)a;
+    const SeatPlanEntry *y = *(const SeatPlanEntry *const *)b;
+    int order = strcmp(x->symbol, y->symbol);
+    if (order != 0) {
+        return order;
+    }
+    return (x > y) - (x < y);
+}
+
+// FNV-1a continued from hash, so a checksum can be built up as the file is written
+uint64_t hashBytes(uint64_t hash, const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    size_t i;
+    for (i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void seatPlanAppend(SeatMatrixWriter *writer, uint64_t *checksum, const void *data, size_t length) {
+    *checksum = hashBytes(*checksum, data, length);
+    seatMatrixWriterAppend(writer, (const char *)data, length);
+}
+
+// Writes the plan to filename.tmp and renames it over filename, so readers never see half a file
+int seatPlanBuilderWrite(const SeatPlanBuilder *builder, const char *filename) {
+    SeatPlanHeader header;
+    SeatMatrixWriter writer;
+    char tmpName[512];
+    const SeatPlanEntry **order = NULL;
+    char *record = NULL;
+    char *subject = NULL;
+    uint64_t checksum = hashKey("", 0);
+    int status = EXIT_FAILURE;
+    size_t i;
+
+    if (builder->count > UINT32_MAX) {
+        fprintf(stderr, "Too many seats for one seat plan.\n");
+        return EXIT_FAILURE;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SEAT_PLAN_MAGIC, sizeof(header.magic));
+    header.version = SEAT_PLAN_VERSION;
+    header.byteOrder = SEAT_PLAN_BYTE_ORDER;
+    header.symbolWidth = (uint32_t)((builder->longestSymbol + 1 + 7) & ~(size_t)7);
+    header.subjectWidth = (uint32_t)((builder->longestSubject + 1 + 7) & ~(size_t)7);
+    header.recordSize = (uint32_t)sizeof(SeatPlanRecord) + header.symbolWidth;
+    header.recordCount = (uint32_t)builder->count;
+    header.subjectCount = (uint32_t)builder->subjectCount;
+    header.recordsOffset = sizeof(SeatPlanHeader);
+    header.subjectsOffset = header.recordsOffset + (uint64_t)header.recordSize * header.recordCount;
+    header.indexOffset = header.subjectsOffset + (uint64_t)header.subjectWidth * header.subjectCount;
+
+    order = malloc(sizeof(const SeatPlanEntry *) * (builder->count + 1));
+    record = calloc(1, header.recordSize);
+    subject = malloc(header.subjectWidth);
+    if (order == NULL || record == NULL || subject == NULL) {
+        fprintf(stderr, "Memory allocation failed for seat plan.\n");
+        goto cleanup;
+    }
+    for (i = 0; i < builder->count; i++) {
+        order[i] = &builder->entries[i];
+    }
+    qsort(order, builder->count, sizeof(const SeatPlanEntry *), compareSeatPlanEntries);
+
+    snprintf(tmpName, sizeof(tmpName), "%s.tmp", filename);
+    if (seatMatrixWriterOpenMode(&writer, tmpName, "wb", EXPORT_BUFFER_SIZE) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not open %s for writing.\n", tmpName);
+        goto cleanup;
+    }
+    seatMatrixWriterAppend(&writer, (const char *)&header, sizeof(header)); // Rewritten with the checksum below
+
+    SeatPlanRecord *fixed = (SeatPlanRecord *)record;
+    for (i = 0; i < builder->count; i++) {
+        const SeatPlanEntry *entry = &builder->entries[i];
+        fixed->day = entry->day;
+        fixed->room_number = entry->room_number;
+        fixed->bench_number = entry->bench_number;
+        fixed->seat_number = entry->seat_number;
+        fixed->subject = (uint32_t)entry->subject;
+        memset(fixed->symbol_number, 0, header.symbolWidth);
+        memcpy(fixed->symbol_number, entry->symbol, entry->symbolLength);
+        seatPlanAppend(&writer, &checksum, record, header.recordSize);
+    }
+    for (i = 0; i < (size_t)builder->subjectCount; i++) {
+        memset(subject, 0, header.subjectWidth);
+        memcpy(subject, builder->subjectNames[i], strlen(builder->subjectNames[i]));
+        seatPlanAppend(&writer, &checksum, subject, header.subjectWidth);
+    }
+    for (i = 0; i < builder->count; i++) {
+        uint32_t index = (uint32_t)(order[i] - builder->entries);
+        seatPlanAppend(&writer, &checksum, &index, sizeof(index));
+    }
+
+    header.checksum = checksum;
+    seatMatrixWriterFlush(&writer);
+    if (!writer.failed &&
+        (fseek(writer.file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, writer.file) != 1)) {
+        writer.failed = 1;
+    }
+    if (seatMatrixWriterClose(&writer) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not write %s.\n", tmpName);
+        remove(tmpName);
+        goto cleanup;
+    }
+#ifdef _WIN32
+    remove(filename); // rename does not replace an existing file on Windows
+#endif
+    if (rename(tmpName, filename) != 0) {
+        fprintf(stderr, "Could not move %s to %s.\n", tmpName, filename);
+        remove(tmpName);
+        goto cleanup;
+    }
+    status = EXIT_SUCCESS;
+
+cleanup:
+    free(subject);
+    free(record);
+    free(order);
+    return status;
+}
+
+// Builds the seat plan from what is saved, for runs whose seats are not all in memory
+int writeSeatPlanFromDatabase(MYSQL *connection, const char *filename, long *seatsOut) {
+    SeatPlanBuilder builder;
+
+    if (seatPlanBuilderInit(&builder) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    int status = seatPlanBuilderLoad(&builder, connection);
+    if (status == EXIT_SUCCESS) {
+        status = seatPlanBuilderWrite(&builder, filename);
+    }
+    *seatsOut = (long)builder.count;
+    seatPlanBuilderFree(&builder);
+    return status;
+}
+
+// Adds every saved seat in seat matrix order
+int seatPlanBuilderLoad(SeatPlanBuilder *builder, MYSQL *connection) {
+    int status = EXIT_SUCCESS;
+    if (dbQuery(connection,
+                "SELECT a.day, r.room_number, a.bench_number, a.seat_number, s.symbol_number, sub.subject_name "
+                "FROM seat_allocation a "
+                "JOIN rooms r ON a.room_id = r.id "
+                "JOIN students s ON a.student_id = s.id "
+                "JOIN subjects sub ON a.subject_id = sub.id "
+                "ORDER BY a.day, r.room_number, a.bench_number, a.seat_number", QUERY_EXPORT)) {
+        fprintf(stderr, "Query failed: %s\n", mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+    MYSQL_RES *result = mysql_use_result(connection);
+    if (result == NULL) {
+        fprintf(stderr, "Could not retrieve data: %s\n", mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+    MYSQL_ROW seatRow;
+    while ((seatRow = dbFetchRow(result, QUERY_EXPORT))) {
+        unsigned long *lengths = mysql_fetch_lengths(result);
+        if (status == EXIT_SUCCESS &&
+            seatPlanBuilderAdd(builder, atoi(seatRow[0]), atoi(seatRow[1]), atoi(seatRow[2]), atoi(seatRow[3]),
+                               seatRow[4], lengths[4], seatRow[5], lengths[5]) == EXIT_FAILURE) {
+            status = EXIT_FAILURE; // Drain the stream before bailing out
+        }
+    }
+    if (mysql_errno(connection)) {
+        fprintf(stderr, "Seat plan query stopped early: %s\n", mysql_error(connection));
+        status = EXIT_FAILURE;
+    }
+    mysql_free_result(result);
+    return status;
+}
+
+int exportSeatPlan(const char *filename) {
+    double startTime = getCurrentTimeSeconds();
+    long seats = 0;
+    if (writeSeatPlanFromDatabase(conn, filename, &seats) == EXIT_FAILURE) {
+        printf("Seat plan was not written.\n");
+        return EXIT_FAILURE;
+    }
+    double elapsed = getCurrentTimeSeconds() - startTime;
+    printf("\nSeat plan with %ld seats written to %s in %.2f s.\n", seats, filename, elapsed);
+    printf("Look seats up offline with: eccs lookup %s <symbol_number> [day]\n", filename);
+    return EXIT_SUCCESS;
+}
+
+// Maps the file and checks that the header and every section fit in it, that every index entry
+// names a record and that every subject name ends inside its slot; the checksum over the records
+// is left to seatPlanVerify so that a lookup does not read the whole file
+int seatPlanOpen(SeatPlan *plan, const char *filename) {
+    memset(plan, 0, sizeof(*plan));
+
+#ifdef _WIN32
+    // No mmap on Windows: read the whole file into memory instead
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open %s.\n", filename);
+        return EXIT_FAILURE;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = malloc(size > 0 ? size : 1);
+    if (data == NULL || fread(data, 1, size, file) != (size_t)size) {
+        fprintf(stderr, "Could not read %s.\n", filename);
+        free(data);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+    fclose(file);
+    plan->data = data;
+    plan->size = size;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open %s.\n", filename);
+        return EXIT_FAILURE;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(SeatPlanHeader)) {
+        fprintf(stderr, "%s is not a seat plan.\n", filename);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Could not map %s.\n", filename);
+        return EXIT_FAILURE;
+    }
+    madvise(data, info.st_size, MADV_RANDOM);
+    plan->data = data;
+    plan->size = info.st_size;
+    plan->mapped = 1;
+#endif
+
+    const SeatPlanHeader *header = (const SeatPlanHeader *)plan->data;
+    plan->header = header;
+    if (plan->size < sizeof(SeatPlanHeader) || memcmp(header->magic, SEAT_PLAN_MAGIC, sizeof(header->magic)) != 0) {
+        fprintf(stderr, "%s is not a seat plan.\n", filename);
+    } else if (header->byteOrder != SEAT_PLAN_BYTE_ORDER) {
+        fprintf(stderr, "%s was written on a machine with the other byte order.\n", filename);
+    } else if (header->version != SEAT_PLAN_VERSION) {
+        fprintf(stderr, "%s is seat plan version %u; this program reads version %d.\n", filename,
+                header->version, SEAT_PLAN_VERSION);
+    } else if (header->recordSize != sizeof(SeatPlanRecord) + header->symbolWidth || header->symbolWidth == 0 ||
+               header->subjectWidth == 0 || header->recordsOffset != sizeof(SeatPlanHeader) ||
+               header->subjectsOffset != header->recordsOffset + (uint64_t)header->recordSize * header->recordCount ||
+               header->indexOffset != header->subjectsOffset + (uint64_t)header->subjectWidth * header->subjectCount ||
+               header->indexOffset + sizeof(uint32_t) * (uint64_t)header->recordCount != plan->size) {
+        fprintf(stderr, "%s is truncated or damaged.\n", filename);
+    } else if (seatPlanCheckSections(plan) == EXIT_FAILURE) {
+        fprintf(stderr, "%s is damaged.\n", filename);
+    } else {
+        return EXIT_SUCCESS;
+    }
+    seatPlanClose(plan);
+    return EXIT_FAILURE;
+}
+
+// Lookups follow index entries and print subject names without further checks, so both are
+// validated once on open
+int seatPlanCheckSections(const SeatPlan *plan) {
+    const uint32_t *index = (const uint32_t *)(plan->data + plan->header->indexOffset);
+    uint32_t i;
+
+    for (i = 0; i < plan->header->recordCount; i++) {
+        if (index[i] >= plan->header->recordCount) {
+            return EXIT_FAILURE;
+        }
+    }
+    for (i = 0; i < plan->header->subjectCount; i++) {
+        const char *subject = plan->data + plan->header->subjectsOffset + (uint64_t)plan->header->subjectWidth * i;
+        if (memchr(subject, '\0', plan->header->subjectWidth) == NULL) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+void seatPlanClose(SeatPlan *plan) {
+#ifdef _WIN32
+    free((void *)plan->data);
+#else
+    if (plan->mapped) {
+        munmap((void *)plan->data, plan->size);
+    }
+#endif
+    memset(plan, 0, sizeof(*plan));
+}
+
+int seatPlanVerify(const SeatPlan *plan) {
+    uint64_t checksum = hashBytes(hashKey("", 0), plan->data + sizeof(SeatPlanHeader),
+                                  plan->size - sizeof(SeatPlanHeader));
+    return checksum == plan->header->checksum ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+const SeatPlanRecord *seatPlanRecord(const SeatPlan *plan, uint32_t index) {
+    return (const SeatPlanRecord *)(plan->data + plan->header->recordsOffset +
+                                    (uint64_t)plan->header->recordSize * index);
+}
+
+const char *seatPlanSubject(const SeatPlan *plan, uint32_t subject) {
+    if (subject >= plan->header->subjectCount) {
+        return "?";
+    }
+    return plan->data + plan->header->subjectsOffset + (uint64_t)plan->header->subjectWidth * subject;
+}
+
+// Binary search of the symbol index; sets [*first, *last) to the index positions of the symbol's seats
+int seatPlanFind(const SeatPlan *plan, const char *symbol, uint32_t *first, uint32_t *last) {
+    const uint32_t *index = (const uint32_t *)(plan->data + plan->header->indexOffset);
+    size_t length = strlen(symbol);
+    uint32_t low = 0, high = plan->header->recordCount;
+
+    if (length >= plan->header->symbolWidth) {
+        *first = *last = 0;
+        return 0; // Longer than any symbol in the plan
+    }
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (strncmp(seatPlanRecord(plan, index[middle])->symbol_number, symbol, plan->header->symbolWidth) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *first = low;
+    while (low < plan->header->recordCount &&
+           strncmp(seatPlanRecord(plan, index[low])->symbol_number, symbol, plan->header->symbolWidth) == 0) {
+        low++;
+    }
+    *last = low;
+    return *last > *first;
+}
+
+// eccs lookup <plan> <symbol_number> [day] and eccs verify <plan>; neither needs the database
+int seatPlanCommand(int argc, char *argv[]) {
+    SeatPlan plan;
+    int verify = argc == 3 && strcmp(argv[1], "verify") == 0;
+    int lookup = (argc == 4 || argc == 5) && strcmp(argv[1], "lookup") == 0;
+
+    if (!verify && !lookup) {
+        fprintf(stderr, "Usage: %s lookup <seat plan> <symbol_number> [day]\n", argv[0]);
+        fprintf(stderr, "       %s verify <seat plan>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (seatPlanOpen(&plan, argv[2]) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    if (verify) {
+        int status = seatPlanVerify(&plan);
+        printf("%s: %u seats, %u subjects, checksum %s\n", argv[2], plan.header->recordCount,
+               plan.header->subjectCount, status == EXIT_SUCCESS ? "OK" : "MISMATCH");
+        seatPlanClose(&plan);
+        return status;
+    }
+
+    int day = argc == 5 ? atoi(argv[4]) : 0;
+    uint32_t first, last, i;
+    int found = 0;
+    double start = getCurrentTimeSeconds();
+    seatPlanFind(&plan, argv[3], &first, &last);
+    double elapsed = getCurrentTimeSeconds() - start;
+
+    const uint32_t *index = (const uint32_t *)(plan.data + plan.header->indexOffset);
+    for (i = first; i < last; i++) {
+        const SeatPlanRecord *record = seatPlanRecord(&plan, index[i]);
+        if (day == 0 || record->day == day) {
+            printf("Day %d: room %d, bench %d, seat %d (%s)\n", record->day, record->room_number,
+                   record->bench_number, record->seat_number, seatPlanSubject(&plan, record->subject));
+            found++;
+        }
+    }
+    if (found == 0) {
+        printf("No seat for %s%s.\n", argv[3], day ? " on that day" : "");
+    }
+    printf("Looked up in %.1f us.\n", elapsed * 1e6);
+    seatPlanClose(&plan);
+    return found ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// ==== Seat lookup service ====
+
+uint64_t seatIndexKey(const char *symbol, int day) {
+    return mixHash(hashKey(symbol, strlen(symbol)) ^ (uint64_t)day);
+}
+
+// Loads every saved seat and chains it under (symbol_number, day); NULL on failure
+SeatIndex *seatIndexBuild(MYSQL *connection) {
+    SeatIndex *index = calloc(1, sizeof(SeatIndex));
+    size_t i, buckets = 16;
+    if (index == NULL) {
+        fprintf(stderr, "Memory allocation failed for seat index.\n");
+        return NULL;
+    }
+    if (seatPlanBuilderInit(&index->seats) == EXIT_FAILURE) {
+        free(index);
+        return NULL;
+    }
+    if (seatPlanBuilderLoad(&index->seats, connection) == EXIT_FAILURE) {
+        seatIndexFree(index);
+        return NULL;
+    }
+
+    while (buckets < index->seats.count * 2) {
+        buckets *= 2;
+    }
+    index->mask = buckets - 1;
+    index->buckets = malloc(sizeof(int32_t) * buckets);
+    index->next = malloc(sizeof(int32_t) * (index->seats.count + 1));
+    if (index->buckets == NULL || index->next == NULL) {
+        fprintf(stderr, "Memory allocation failed for seat index.\n");
+        seatIndexFree(index);
+        return NULL;
+    }
+    memset(index->buckets, 0xff, sizeof(int32_t) * buckets);
+
+    // Pushed from the back so every chain lists its seats in seat matrix order
+    for (i = index->seats.count; i-- > 0;) {
+        const SeatPlanEntry *entry = &index->seats.entries[i];
+        size_t bucket = seatIndexKey(entry->symbol, entry->day) & index->mask;
+        index->next[i] = index->buckets[bucket];
+        index->buckets[bucket] = (int32_t)i;
+        if (entry->day > index->maxDay) {
+            index->maxDay = entry->day;
+        }
+    }
+    return index;
+}
+
+void seatIndexFree(SeatIndex *index) {
+    if (index == NULL) {
+        return;
+    }
+    seatPlanBuilderFree(&index->seats);
+    free(index->buckets);
+    free(index->next);
+    free(index);
+}
+
+// Collects a student's seats on one day, or on every day when day is 0, and returns how many there are
+int seatIndexFind(const SeatIndex *index, const char *symbol, int day, const SeatPlanEntry **seats, int maxSeats) {
+    int found = 0, d;
+
+    if (day > 0) {
+        return seatIndexProbe(index, symbol, day, seats, maxSeats, 0);
+    }
+    // maxDay comes from the loaded seats, so this walks at most one bucket per exam day
+    for (d = 1; d <= index->maxDay; d++) {
+        found = seatIndexProbe(index, symbol, d, seats, maxSeats, found);
+        if (d == index->maxDay) {
+            break;
+        }
+    }
+    return found;
+}
+
+// Appends the seats chained in one (symbol, day) bucket after the first found entries
+int seatIndexProbe(const SeatIndex *index, const char *symbol, int day, const SeatPlanEntry **seats, int maxSeats,
+                   int found) {
+    int32_t i = index->buckets[seatIndexKey(symbol, day) & index->mask];
+    for (; i >= 0; i = index->next[i]) {
+        const SeatPlanEntry *entry = &index->seats.entries[i];
+        if (entry->day == day && strcmp(entry->symbol, symbol) == 0) {
+            if (found < maxSeats) {
+                seats[found] = entry;
+            }
+            found++;
+        }
+    }
+    return found;
+}
+
+// Appends text as a JSON string literal; fails when out is full
+int appendJsonString(char *out, size_t size, size_t *length, const char *text) {
+    size_t at = *length;
+    if (at + 2 > size) {
+        return EXIT_FAILURE;
+    }
+    out[at++] = '"';
+    for (; *text; text++) {
+        unsigned char ch = (unsigned char)*text;
+        if (ch == '"' || ch == '\\') {
+            if (at + 2 >= size) {
+                return EXIT_FAILURE;
+            }
+            out[at++] = '\\';
+            out[at++] = (char)ch;
+        } else if (ch < 0x20) {
+            if (at + 6 >= size) {
+                return EXIT_FAILURE;
+            }
+            at += snprintf(out + at, size - at, "\\u%04x", ch);
+        } else {
+            if (at + 1 >= size) {
+                return EXIT_FAILURE;
+            }
+            out[at++] = (char)ch;
+        }
+    }
+    if (at + 1 >= size) {
+        return EXIT_FAILURE;
+    }
+    out[at++] = '"';
+    out[at] = '\0';
+    *length = at;
+    return EXIT_SUCCESS;
+}
+
+// Decodes %XX escapes and '+' of a query string value; returns the decoded length
+size_t urlDecode(char *out, size_t size, const char *text, size_t length) {
+    size_t i, at = 0;
+    for (i = 0; i < length && at + 1 < size; i++) {
+        if (text[i] == '%' && i + 2 < length && isxdigit((unsigned char)text[i + 1]) &&
+            isxdigit((unsigned char)text[i + 2])) {
+            char hex[3] = {text[i + 1], text[i + 2], '\0'};
+            out[at++] = (char)strtol(hex, NULL, 16);
+            i += 2;
+        } else {
+            out[at++] = text[i] == '+' ? ' ' : text[i];
+        }
+    }
+    out[at] = '\0';
+    return at;
+}
+
+size_t urlEncode(char *out, size_t size, const char *text) {
+    size_t at = 0;
+    for (; *text && at + 4 < size; text++) {
+        unsigned char ch = (unsigned char)*text;
+        if (isalnum(ch) || ch == '-' || ch == '_' || ch == '.' || ch == '~') {
+            out[at++] = (char)ch;
+        } else {
+            at += snprintf(out + at, size - at, "%%%02X", ch);
+        }
+    }
+    out[at] = '\0';
+    return at;
+}
+
+#ifdef __linux__
+// Write end of the running service's wake pipe, for the signal handler
+int seatServiceWakeFd = -1;
+
+void seatServiceSignal(int number) {
+    char command = number == SIGHUP ? 'h' : 's';
+    if (seatServiceWakeFd >= 0) {
+        ssize_t ignored = write(seatServiceWakeFd, &command, 1);
+        (void)ignored;
+    }
+}
+
+// Listens on 127.0.0.1:port (0 picks a free port) or on a Unix socket, and builds the first index
+int seatServiceOpen(SeatService *service, MYSQL *connection, int port, const char *unixPath) {
+    struct epoll_event event;
+    memset(service, 0, sizeof(*service));
+    service->listenFd = service->epollFd = service->wakeFds[0] = service->wakeFds[1] = -1;
+
+    service->index = seatIndexBuild(connection);
+    if (service->index == NULL) {
+        return EXIT_FAILURE;
+    }
+    service->index->generation = service->generation = 1;
+
+    if (unixPath != NULL) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (strlen(unixPath) >= sizeof(address.sun_path)) {
+            fprintf(stderr, "Socket path is too long: %s\n", unixPath);
+            seatServiceClose(service);
+            return EXIT_FAILURE;
+        }
+        strcpy(address.sun_path, unixPath);
+        struct stat existing;
+        if (lstat(unixPath, &existing) == 0) {
+            // Only a socket left behind by a previous run may be replaced
+            if (!S_ISSOCK(existing.st_mode)) {
+                fprintf(stderr, "Refusing to replace %s: it exists and is not a socket\n", unixPath);
+                seatServiceClose(service);
+                return EXIT_FAILURE;
+            }
+            unlink(unixPath);
+        }
+        service->listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (service->listenFd < 0 || bind(service->listenFd, (struct sockaddr *)&address, sizeof(address)) ||
+            listen(service->listenFd, SOMAXCONN)) {
+            fprintf(stderr, "Could not listen on %s: %s\n", unixPath, strerror(errno));
+            seatServiceClose(service);
+            return EXIT_FAILURE;
+        }
+        service->unixPath = unixPath; // Bound by us, so removed again on close
+    } else {
+        struct sockaddr_in address;
+        socklen_t addressLength = sizeof(address);
+        int reuse = 1;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons((uint16_t)port);
+        service->listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (service->listenFd >= 0) {
+            setsockopt(service->listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        if (service->listenFd < 0 || bind(service->listenFd, (struct sockaddr *)&address, sizeof(address)) ||
+            listen(service->listenFd, SOMAXCONN) ||
+            getsockname(service->listenFd, (struct sockaddr *)&address, &addressLength)) {
+            fprintf(stderr, "Could not listen on port %d: %s\n", port, strerror(errno));
+            seatServiceClose(service);
+            return EXIT_FAILURE;
+        }
+        service->port = ntohs(address.sin_port);
+    }
+
+    service->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (service->epollFd < 0 || pipe(service->wakeFds) || fcntl(service->wakeFds[0], F_SETFL, O_NONBLOCK) ||
+        fcntl(service->wakeFds[1], F_SETFL, O_NONBLOCK)) {
+        perror("Could not set up the event loop");
+        seatServiceClose(service);
+        return EXIT_FAILURE;
+    }
+    event.events = EPOLLIN;
+    event.data.ptr = &service->listenFd;
+    if (epoll_ctl(service->epollFd, EPOLL_CTL_ADD, service->listenFd, &event) == 0) {
+        event.data.ptr = &service->wakeFds[0];
+        if (epoll_ctl(service->epollFd, EPOLL_CTL_ADD, service->wakeFds[0], &event) == 0) {
+            return EXIT_SUCCESS;
+        }
+    }
+    perror("epoll_ctl");
+    seatServiceClose(service);
+    return EXIT_FAILURE;
+}
+
+// Serves requests until seatServiceStop; the index is only ever touched from this thread
+int seatServiceRun(SeatService *service) {
+    struct epoll_event events[SEAT_SERVICE_EVENTS];
+    int i;
+
+    while (!atomic_load(&service->stop)) {
+        int ready = epoll_wait(service->epollFd, events, SEAT_SERVICE_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            return EXIT_FAILURE;
+        }
+
+        for (i = 0; i < ready; i++) {
+            void *source = events[i].data.ptr;
+            if (source == &service->listenFd) {
+                seatServiceAccept(service);
+            } else if (source == &service->wakeFds[0]) {
+                char commands[64];
+                ssize_t count, c;
+                while ((count = read(service->wakeFds[0], commands, sizeof(commands))) > 0) {
+                    for (c = 0; c < count; c++) {
+                        if (commands[c] == 'h') {
+                            seatServiceRequestReload(service);
+                        } else if (commands[c] == 's') {
+                            atomic_store(&service->stop, 1);
+                        }
+                    }
+                }
+            } else {
+                ServiceClient *client = source;
+                if (events[i].events & EPOLLOUT) {
+                    seatServiceWrite(service, client);
+                } else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    seatServiceRead(service, client);
+                }
+            }
+        }
+
+        // No request is in progress here, so nothing still points into the old index
+        SeatIndex *fresh = atomic_exchange(&service->pending, NULL);
+        if (fresh != NULL) {
+            SeatIndex *old = service->index;
+            fresh->generation = ++service->generation;
+            service->index = fresh;
+            seatIndexFree(old);
+            printf("Reloaded %zu seats (generation %ld).\n", fresh->seats.count, fresh->generation);
+            fflush(stdout);
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+void *seatServiceThread(void *arg) {
+    seatServiceRun(arg);
+    return NULL;
+}
+
+// Safe from any thread
+void seatServiceStop(SeatService *service) {
+    char command = 's';
+    atomic_store(&service->stop, 1);
+    if (write(service->wakeFds[1], &command, 1) != 1) {
+        perror("Could not wake the seat service");
+    }
+}
+
+// Open connections are dropped without a reply
+void seatServiceClose(SeatService *service) {
+    // A reload still running holds the wake pipe and will publish into pending
+    while (atomic_load(&service->reloading)) {
+        sleepMicroseconds(1000);
+    }
+    while (service->clients != NULL) {
+        seatServiceDropClient(service, service->clients);
+    }
+    seatIndexFree(atomic_exchange(&service->pending, NULL));
+    seatIndexFree(service->index);
+    service->index = NULL;
+    if (service->listenFd >= 0) {
+        close(service->listenFd);
+        if (service->unixPath != NULL) {
+            unlink(service->unixPath);
+        }
+    }
+    if (service->epollFd >= 0) {
+        close(service->epollFd);
+    }
+    if (service->wakeFds[0] >= 0) {
+        close(service->wakeFds[0]);
+        close(service->wakeFds[1]);
+    }
+    service->listenFd = service->epollFd = service->wakeFds[0] = service->wakeFds[1] = -1;
+}
+
+// Starts a reload unless one is already running. Lookups go on against the current index meanwhile.
+void seatServiceRequestReload(SeatService *service) {
+    pthread_t thread;
+    if (atomic_exchange(&service->reloading, 1)) {
+        return;
+    }
+    if (pthread_create(&thread, NULL, seatServiceReloadThread, service)) {
+        fprintf(stderr, "Could not start the seat index reload.\n");
+        atomic_store(&service->reloading, 0);
+        return;
+    }
+    pthread_detach(thread);
+}
+
+// Builds the new index on its own connection and publishes it for the event loop to swap in
+void *seatServiceReloadThread(void *arg) {
+    SeatService *service = arg;
+    char command = 'r';
+
+    mysql_thread_init();
+    MYSQL *connection = openDatabaseConnection();
+    SeatIndex *fresh = connection ? seatIndexBuild(connection) : NULL;
+    if (connection != NULL) {
+        mysql_close(connection);
+    }
+    mysql_thread_end();
+
+    if (fresh == NULL) {
+        fprintf(stderr, "Seat index reload failed; still serving the previous seats.\n");
+    } else {
+        seatIndexFree(atomic_exchange(&service->pending, fresh)); // Never seen by a request if not swapped in yet
+    }
+    if (write(service->wakeFds[1], &command, 1) != 1) {
+        fprintf(stderr, "Could not wake the seat service; the reload is picked up after the next request.\n");
+    }
+    atomic_store(&service->reloading, 0);
+    return NULL;
+}
+
+void seatServiceAccept(SeatService *service) {
+    int fd;
+    while ((fd = accept(service->listenFd, NULL, NULL)) >= 0) {
+        ServiceClient *client = malloc(sizeof(ServiceClient));
+        struct epoll_event event;
+        int noDelay = 1;
+        if (client == NULL || fcntl(fd, F_SETFL, O_NONBLOCK)) {
+            free(client);
+            close(fd);
+            continue;
+        }
+        client->fd = fd;
+        client->received = 0;
+        client->responseLength = 0;
+        client->sent = 0;
+        client->closeAfterResponse = 0;
+        client->waitingToWrite = 0;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay)); // Fails harmlessly on Unix sockets
+        event.events = EPOLLIN;
+        event.data.ptr = client;
+        if (epoll_ctl(service->epollFd, EPOLL_CTL_ADD, fd, &event)) {
+            close(fd);
+            free(client);
+            continue;
+        }
+        client->previous = NULL;
+        client->next = service->clients;
+        if (service->clients != NULL) {
+            service->clients->previous = client;
+        }
+        service->clients = client;
+    }
+}
+
+void seatServiceDropClient(SeatService *service, ServiceClient *client) {
+    if (client->previous != NULL) {
+        client->previous->next = client->next;
+    } else {
+        service->clients = client->next;
+    }
+    if (client->next != NULL) {
+        client->next->previous = client->previous;
+    }
+    epoll_ctl(service->epollFd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    free(client);
+}
+
+// Answers every complete request in the buffer; keep-alive and pipelined requests share the connection
+void seatServiceRead(SeatService *service, ServiceClient *client) {
+    ssize_t count = recv(client->fd, client->request + client->received,
+                         sizeof(client->request) - 1 - client->received, 0);
+    if (count <= 0) {
+        if (count < 0 && (errno == EAGAIN || errno == EINTR)) {
+            return;
+        }
+        seatServiceDropClient(service, client);
+        return;
+    }
+    client->received += count;
+    client->request[client->received] = '\0';
+    seatServiceWrite(service, client);
+}
+
+// Sends what is pending, then moves on to the next buffered request
+void seatServiceWrite(SeatService *service, ServiceClient *client) {
+    while (1) {
+        while (client->sent < client->responseLength) {
+            ssize_t count = send(client->fd, client->response + client->sent, client->responseLength - client->sent,
+                                 MSG_NOSIGNAL);
+            if (count < 0 && (errno == EAGAIN || errno == EINTR)) {
+                // Stop reading until the client takes the response
+                if (!client->waitingToWrite) {
+                    struct epoll_event event;
+                    event.events = EPOLLOUT;
+                    event.data.ptr = client;
+                    epoll_ctl(service->epollFd, EPOLL_CTL_MOD, client->fd, &event);
+                    client->waitingToWrite = 1;
+                }
+                return;
+            }
+            if (count <= 0) {
+                seatServiceDropClient(service, client);
+                return;
+            }
+            client->sent += count;
+        }
+        if (client->responseLength > 0) {
+            client->responseLength = client->sent = 0;
+            if (client->closeAfterResponse) {
+                seatServiceDropClient(service, client);
+                return;
+            }
+            if (client->waitingToWrite) {
+                struct epoll_event event;
+                event.events = EPOLLIN;
+                event.data.ptr = client;
+                epoll_ctl(service->epollFd, EPOLL_CTL_MOD, client->fd, &event);
+                client->waitingToWrite = 0;
+            }
+        }
+
+        char *end = strstr(client->request, "\r\n\r\n");
+        if (end == NULL) {
+            if (client->received == sizeof(client->request) - 1) {
+                client->closeAfterResponse = 1;
+                seatServiceRespond(client, 431, "{\"error\":\"request too large\"}", 29);
+                continue;
+            }
+            return;
+        }
+        *end = '\0';
+        size_t consumed = end + 4 - client->request;
+        seatServiceHandle(service, client, client->request);
+        memmove(client->request, client->request + consumed, client->received - consumed + 1);
+        client->received -= consumed;
+    }
+}
+
+void seatServiceHandle(SeatService *service, ServiceClient *client, char *head) {
+    char method[8], target[512], version[16];
+    char body[128];
+    service->requests++;
+
+    if (sscanf(head, "%7s %511s %15s", method, target, version) != 3 || strncmp(version, "HTTP/1.", 7) != 0) {
+        client->closeAfterResponse = 1;
+        seatServiceRespond(client, 400, "{\"error\":\"bad request\"}", 23);
+        return;
+    }
+    client->closeAfterResponse = strcmp(version, "HTTP/1.1") != 0 || strstr(head, "\r\nConnection: close") != NULL;
+
+    if (strcmp(target, "/health") == 0) {
+        int length = snprintf(body, sizeof(body), "{\"seats\":%zu,\"generation\":%ld,\"requests\":%ld}",
+                              service->index->seats.count, service->index->generation, service->requests);
+        seatServiceRespond(client, 200, body, length);
+    } else if (strcmp(target, "/reload") == 0) {
+        if (strcmp(method, "POST") != 0) {
+            seatServiceRespond(client, 405, "{\"error\":\"use POST\"}", 20);
+            return;
+        }
+        seatServiceRequestReload(service);
+        seatServiceRespond(client, 202, "{\"reloading\":true}", 18);
+    } else if (strncmp(target, "/seat?", 6) == 0 && strcmp(method, "GET") == 0) {
+        seatServiceLookup(service, client, target + 6);
+    } else {
+        seatServiceRespond(client, 404, "{\"error\":\"not found\"}", 21);
+    }
+}
+
+// GET /seat?symbol=<symbol_number>[&day=<day>]
+void seatServiceLookup(SeatService *service, ServiceClient *client, char *query) {
+    char symbol[256] = "";
+    char body[SEAT_SERVICE_RESPONSE_BYTES - 256];
+    const SeatPlanEntry *seats[SEAT_LOOKUP_MAX_SEATS];
+    const SeatIndex *index = service->index;
+    size_t length = 0;
+    int day = 0, dayValid = 1, i;
+
+    while (*query) {
+        char *end = strchr(query, '&');
+        size_t fieldLength = end ? (size_t)(end - query) : strlen(query);
+        if (strncmp(query, "symbol=", 7) == 0) {
+            urlDecode(symbol, sizeof(symbol), query + 7, fieldLength - 7);
+        } else if (strncmp(query, "day=", 4) == 0) {
+            char dayText[16];
+            dayValid = fieldLength - 4 < sizeof(dayText);
+            if (dayValid) {
+                memcpy(dayText, query + 4, fieldLength - 4);
+                dayText[fieldLength - 4] = '\0';
+                dayValid = parseCount(dayText, &day) == EXIT_SUCCESS;
             }
-            res = mysql_store_result(conn);
-            if ((row = mysql_fetch_row(res)) == NULL) {
-                fprintf(stderr, "Could not retrieve subject ID.\n");
-                fclose(file);
-                return EXIT_FAILURE;
+        }
+        query += fieldLength + (end != NULL);
+    }
+    if (!dayValid) {
+        seatServiceRespond(client, 400, "{\"error\":\"day must be a positive integer\"}", 42);
+        return;
+    }
+    if (symbol[0] == '\0') {
+        seatServiceRespond(client, 400, "{\"error\":\"symbol is required\"}", 30);
+        return;
+    }
+
+    int found = seatIndexFind(index, symbol, day, seats, SEAT_LOOKUP_MAX_SEATS);
+    length = (size_t)snprintf(body, sizeof(body), "{\"symbol\":");
+    int failed = appendJsonString(body, sizeof(body), &length, symbol) == EXIT_FAILURE;
+    length += snprintf(body + length, sizeof(body) - length, ",\"seats\":[");
+    for (i = 0; i < found && i < SEAT_LOOKUP_MAX_SEATS && !failed; i++) {
+        length += snprintf(body + length, sizeof(body) - length,
+                           "%s{\"day\":%d,\"room\":%d,\"bench\":%d,\"seat\":%d,\"subject\":", i ? "," : "",
+                           seats[i]->day, seats[i]->room_number, seats[i]->bench_number, seats[i]->seat_number);
+        failed = length >= sizeof(body) ||
+                 appendJsonString(body, sizeof(body), &length, index->seats.subjectNames[seats[i]->subject]) ==
+                     EXIT_FAILURE ||
+                 length + 2 >= sizeof(body);
+        if (!failed) {
+            body[length++] = '}';
+        }
+    }
+    if (failed || length + 3 >= sizeof(body)) {
+        seatServiceRespond(client, 500, "{\"error\":\"too many seats\"}", 26);
+        return;
+    }
+    length += snprintf(body + length, sizeof(body) - length, "]}");
+    seatServiceRespond(client, found ? 200 : 404, body, length);
+}
+
+void seatServiceRespond(ServiceClient *client, int status, const char *body, size_t length) {
+    const char *reason = status == 200 ? "OK" : status == 202 ? "Accepted" : status == 400 ? "Bad Request"
+                       : status == 404 ? "Not Found" : status == 405 ? "Method Not Allowed"
+                       : status == 431 ? "Request Header Fields Too Large" : "Internal Server Error";
+    int header = snprintf(client->response, sizeof(client->response),
+                          "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n%s\r\n",
+                          status, reason, length, client->closeAfterResponse ? "Connection: close\r\n" : "");
+    memcpy(client->response + header, body, length); // Bodies are sized to leave room for the header
+    client->responseLength = header + length;
+    client->sent = 0;
+}
+#else
+int seatServiceOpen(SeatService *service, MYSQL *connection, int port, const char *unixPath) {
+    (void)service;
+    (void)connection;
+    (void)port;
+    (void)unixPath;
+    fprintf(stderr, "The seat lookup service needs Linux (epoll).\n");
+    return EXIT_FAILURE;
+}
+
+int seatServiceRun(SeatService *service) {
+    (void)service;
+    return EXIT_FAILURE;
+}
+
+void seatServiceStop(SeatService *service) {
+    (void)service;
+}
+
+void seatServiceClose(SeatService *service) {
+    (void)service;
+}
+#endif
+
+// Serves seat lookups until SIGINT or SIGTERM; SIGHUP reloads the seats after a re-allocation
+int serveCommand(const BatchOptions *options) {
+#ifdef __linux__
+    SeatService service;
+    struct sigaction action;
+    int port = options->port > 0 ? options->port : SEAT_SERVICE_PORT;
+
+    if (seatServiceOpen(&service, conn, port, options->unixPath) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = seatServiceSignal;
+    sigemptyset(&action.sa_mask);
+    seatServiceWakeFd = service.wakeFds[1];
+    sigaction(SIGHUP, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    if (options->unixPath != NULL) {
+        printf("Serving %zu seats on %s.\n", service.index->seats.count, options->unixPath);
+    } else {
+        printf("Serving %zu seats on http://127.0.0.1:%d.\n", service.index->seats.count, service.port);
+    }
+    printf("GET /seat?symbol=<symbol_number>[&day=<day>] or /health; POST /reload or SIGHUP reloads, "
+           "Ctrl+C stops.\n");
+    fflush(stdout);
+    int status = seatServiceRun(&service);
+
+    action.sa_handler = SIG_DFL;
+    sigaction(SIGHUP, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    seatServiceWakeFd = -1;
+    printf("\nServed %ld requests.\n", service.requests);
+    seatServiceClose(&service);
+    return status;
+#else
+    (void)options;
+    fprintf(stderr, "The seat lookup service needs Linux (epoll).\n");
+    return EXIT_FAILURE;
+#endif
+}
+
+int makeDirectory(const char *path) {
+    #ifdef _WIN32
+        if (!CreateDirectoryA(path, NULL) && GetLastError() != ERROR_ALREADY_EXISTS) {
+            return EXIT_FAILURE;
+        }
+    #else
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+            return EXIT_FAILURE;
+        }
+    #endif
+    return EXIT_SUCCESS;
+}
+
+void seatSheetPath(char *path, size_t size, const char *directory, int day, int room_number) {
+    snprintf(path, size, "%s/" SHEET_FILE_FORMAT, directory, day, room_number);
+}
+
+// Lists every day and room that has seats, in the order the seat matrix prints them
+int loadSeatSheets(MYSQL *connection, SeatSheet **sheetsOut, int *countOut) {
+    if (dbQuery(connection, "SELECT DISTINCT a.day, r.room_number FROM seat_allocation a "
+                            "JOIN rooms r ON a.room_id = r.id ORDER BY a.day, r.room_number", QUERY_EXPORT)) {
+        fprintf(stderr, "Could not list room sheets: %s\n", mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+    MYSQL_RES *result = mysql_store_result(connection);
+    if (result == NULL) {
+        fprintf(stderr, "Could not retrieve room sheets: %s\n", mysql_error(connection));
+        return EXIT_FAILURE;
+    }
+
+    int count = (int)mysql_num_rows(result);
+    SeatSheet *sheets = calloc(count > 0 ? count : 1, sizeof(SeatSheet));
+    if (sheets == NULL) {
+        fprintf(stderr, "Memory allocation failed for room sheets.\n");
+        mysql_free_result(result);
+        return EXIT_FAILURE;
+    }
+    MYSQL_ROW sheetRow;
+    int i = 0;
+    while ((sheetRow = dbFetchRow(result, QUERY_EXPORT)) && i < count) {
+        sheets[i].day = atoi(sheetRow[0]);
+        sheets[i].room_number = atoi(sheetRow[1]);
+        i++;
+    }
+    mysql_free_result(result);
+
+    *sheetsOut = sheets;
+    *countOut = i;
+    return EXIT_SUCCESS;
+}
+
+// Writes one room's seats for one day in the seat matrix layout. Each sheet is a query and a file of
+// its own, so sheets can be written in any order, concurrently, or one at a time to redo a single room.
+int writeSeatSheet(MYSQL *connection, const char *directory, SeatSheet *sheet) {
+    char path[512];
+    char query[512];
+    SeatMatrixWriter writer;
+
+    sheet->seats = 0;
+    seatSheetPath(path, sizeof(path), directory, sheet->day, sheet->room_number);
+    if (seatMatrixWriterOpen(&writer, path, SHEET_BUFFER_SIZE) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not open %s for writing.\n", path);
+        return EXIT_FAILURE;
+    }
+
+    snprintf(query, sizeof(query),
+             "SELECT a.bench_number, s.symbol_number, sub.subject_name "
+             "FROM seat_allocation a "
+             "JOIN rooms r ON a.room_id = r.id "
+             "JOIN students s ON a.student_id = s.id "
+             "JOIN subjects sub ON a.subject_id = sub.id "
+             "WHERE a.day = %d AND r.room_number = %d "
+             "ORDER BY a.bench_number, a.seat_number", sheet->day, sheet->room_number);
+    if (dbQuery(connection, query, QUERY_EXPORT)) {
+        fprintf(stderr, "Query failed for day %d, room %d: %s\n", sheet->day, sheet->room_number,
+                mysql_error(connection));
+        seatMatrixWriterClose(&writer);
+        return EXIT_FAILURE;
+    }
+    MYSQL_RES *result = mysql_use_result(connection);
+    if (result == NULL) {
+        fprintf(stderr, "Could not retrieve day %d, room %d: %s\n", sheet->day, sheet->room_number,
+                mysql_error(connection));
+        seatMatrixWriterClose(&writer);
+        return EXIT_FAILURE;
+    }
+
+    seatMatrixWriterText(&writer, "Day ");
+    seatMatrixWriterInt(&writer, sheet->day);
+    seatMatrixWriterText(&writer, "\n-------\nRoom ");
+    seatMatrixWriterInt(&writer, sheet->room_number);
+    seatMatrixWriterText(&writer, "\n-------\n");
+
+    MYSQL_ROW seatRow;
+    int current_bench = -1;
+    while (!writer.failed && (seatRow = dbFetchRow(result, QUERY_EXPORT))) {
+        unsigned long *lengths = mysql_fetch_lengths(result);
+        int bench_number = atoi(seatRow[0]);
+        if (bench_number != current_bench) {
+            if (current_bench != -1) seatMatrixWriterText(&writer, "\n");
+            seatMatrixWriterText(&writer, "Bench ");
+            seatMatrixWriterInt(&writer, bench_number);
+            seatMatrixWriterText(&writer, ": ");
+            current_bench = bench_number;
+        }
+        seatMatrixWriterSeat(&writer, seatRow[1], lengths[1], seatRow[2], lengths[2]);
+        sheet->seats++;
+    }
+    int streamFailed = mysql_errno(connection) != 0;
+    if (streamFailed) {
+        fprintf(stderr, "Sheet for day %d, room %d stopped early: %s\n", sheet->day, sheet->room_number,
+                mysql_error(connection));
+    }
+    mysql_free_result(result);
+
+    seatMatrixWriterText(&writer, "\n");
+    if (seatMatrixWriterClose(&writer) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not write %s.\n", path);
+        return EXIT_FAILURE;
+    }
+    return streamFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+void *exportWorkerThread(void *arg) {
+    ExportWorker *worker = arg;
+    int index;
+    mysql_thread_init();
+    while ((index = atomic_fetch_add(worker->nextSheet, 1)) < worker->sheetCount) {
+        SeatSheet *sheet = &worker->sheets[index];
+        sheet->status = writeSeatSheet(worker->connection, worker->directory, sheet);
+        if (sheet->status == EXIT_FAILURE) {
+            atomic_store(worker->failed, 1); // Keep going: the other sheets are still worth having
+        }
+    }
+    mysql_thread_end();
+    return NULL;
+}
+
+// Lists the sheets as day,room_number,file so they can be found without scanning the directory
+int writeSheetIndex(const char *directory, const SeatSheet *sheets, int count) {
+    char path[512];
+    int i;
+
+    snprintf(path, sizeof(path), "%s/%s", directory, SHEET_INDEX_FILE);
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open %s for writing.\n", path);
+        return EXIT_FAILURE;
+    }
+    fprintf(file, "day,room_number,file\n");
+    for (i = 0; i < count; i++) {
+        fprintf(file, "%d,%d," SHEET_FILE_FORMAT "\n", sheets[i].day, sheets[i].room_number, sheets[i].day,
+                sheets[i].room_number);
+    }
+    return fclose(file) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Writes one sheet per day and room into directory on up to workerCount threads, then the index
+int exportSeatSheets(const char *directory, int workerCount) {
+    double startTime = getCurrentTimeSeconds();
+    SeatSheet *sheets = NULL;
+    int sheetCount = 0;
+    int i, started = 0;
+
+    if (makeDirectory(directory) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not create directory %s.\n", directory);
+        return EXIT_FAILURE;
+    }
+    if (loadSeatSheets(conn, &sheets, &sheetCount) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    if (sheetCount == 0) {
+        // Nothing seated is not an error, just as allocate with nothing to seat is not
+        printf("No seat allocations available.\n");
+        free(sheets);
+        return EXIT_SUCCESS;
+    }
+    if (workerCount > sheetCount) {
+        workerCount = sheetCount;
+    }
+
+    ConnectionPool pool;
+    ExportWorker *workers = calloc(workerCount, sizeof(ExportWorker));
+    _Atomic int nextSheet = 0;
+    _Atomic int failed = 0;
+    if (workers == NULL) {
+        fprintf(stderr, "Memory allocation failed for export workers.\n");
+        free(sheets);
+        return EXIT_FAILURE;
+    }
+    if (connectionPoolOpen(&pool, workerCount) == EXIT_FAILURE) {
+        free(workers);
+        free(sheets);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < workerCount; i++) {
+        workers[i].sheets = sheets;
+        workers[i].sheetCount = sheetCount;
+        workers[i].directory = directory;
+        workers[i].connection = pool.connections[i];
+        workers[i].nextSheet = &nextSheet;
+        workers[i].failed = &failed;
+        if (pthread_create(&workers[i].thread, NULL, exportWorkerThread, &workers[i])) {
+            fprintf(stderr, "Could not start export worker %d.\n", i);
+            break;
+        }
+        started++;
+    }
+    if (started == 0) {
+        exportWorkerThread(&workers[0]); // Write them all from this thread instead
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    connectionPoolClose(&pool);
+    free(workers);
+
+    long seats = 0;
+    for (i = 0; i < sheetCount; i++) {
+        if (sheets[i].status == EXIT_FAILURE) {
+            printf("Sheet for day %d, room %d failed; regenerate it on its own.\n", sheets[i].day,
+                   sheets[i].room_number);
+        }
+        seats += sheets[i].seats;
+    }
+    int indexStatus = writeSheetIndex(directory, sheets, sheetCount);
+    free(sheets);
+
+    double elapsed = getCurrentTimeSeconds() - startTime;
+    metricsRecordPhase(PHASE_EXPORT, elapsed);
+    int workersUsed = started > 0 ? started : 1;
+    printf("\n%s %d room sheets to %s/ with %d worker%s%s.\n", atomic_load(&failed) ? "Attempted" : "Wrote",
+           sheetCount, directory, workersUsed, workersUsed == 1 ? "" : "s",
+           indexStatus == EXIT_FAILURE ? " (index not written)" : "");
+    printf("Exported %ld seats in %.2f s (%.0f rows/s).\n", seats, elapsed, elapsed > 0 ? seats / elapsed : 0.0);
+    return atomic_load(&failed) || indexStatus == EXIT_FAILURE ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Rewrites the sheet of one room for one day; the index is unchanged since it only names the files
+void regenerateSeatSheet(const char *directory) {
+    SeatSheet sheet = {0};
+    char path[512];
+
+    sheet.day = getValidatedChoice("\nEnter day: ");
+    sheet.room_number = getValidatedChoice("Enter room number: ");
+    if (makeDirectory(directory) == EXIT_FAILURE) {
+        fprintf(stderr, "Could not create directory %s.\n", directory);
+        return;
+    }
+    if (writeSeatSheet(conn, directory, &sheet) == EXIT_FAILURE) {
+        printf("Could not regenerate the sheet.\n");
+        return;
+    }
+    seatSheetPath(path, sizeof(path), directory, sheet.day, sheet.room_number);
+    if (sheet.seats == 0) {
+        printf("No seats are allocated in room %d on day %d.\n", sheet.room_number, sheet.day);
+    }
+    printf("Wrote %ld seats to %s.\n", sheet.seats, path);
+}
+
+
+void getPassword(char *password, size_t size) {
+    printf("Enter password: ");
+    fflush(stdout);
+
+    int ch;
+    size_t i = 0;
+
+    while (i < size - 1 && (ch = getch()) != '\r' && ch != EOF) {
+        if (ch == '\n') {
+            if (i == 0) {
+                continue; // Left behind by the username prompt
+            }
+            break;
+        }
+        if (ch == '\b' || ch == 127) { // Handle backspace (DEL on most terminals)
+            if (i > 0) {
+                printf("\b \b");
+                i--;
             }
-            int subject_id = atoi(row[0]);
-            mysql_free_result(res);
+        } else {
+            password[i++] = ch;
+            printf("*"); // Show asterisks for characters entered
+        }
+    }
+
+    password[i] = '\0'; // Null-terminate the password
+    printf("\n");
+}
+
+#ifndef _WIN32
+// conio's getch: one key, unbuffered and not echoed. Input that is not a terminal is read as is.
+int getch() {
+    struct termios saved, raw;
+    fflush(stdout);
+    if (tcgetattr(STDIN_FILENO, &saved) != 0) {
+        return getchar();
+    }
+    raw = saved;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    int ch = getchar();
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+    return ch;
+}
+#endif
+
+int registerUser() {
+    char username[50], password[50];
+    int role;
+
+    printf("\nEnter username: ");
+    scanf("%s", username);
+
+    // Check if the username already exists
+    char query[256];
+    snprintf(query, sizeof(query), "SELECT id FROM users WHERE username='%s'", username);
+
+    if (dbQuery(conn, query, QUERY_OTHER)) {
+        fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
+        return EXIT_FAILURE;
+    }
+
+    MYSQL_RES *res = mysql_store_result(conn);
+    if (res == NULL) {
+        fprintf(stderr, "mysql_store_result() failed: %s\n", mysql_error(conn));
+        return EXIT_FAILURE;
+    }
+
+    MYSQL_ROW row = dbFetchRow(res, QUERY_OTHER);
+    if (row != NULL) {
+        printf("Username already exists. Please choose another.\n");
+        mysql_free_result(res);
+        return EXIT_FAILURE;
+    }
+    mysql_free_result(res);
+
+    // Securely get the password
+    getPassword(password, sizeof(password));
+
+    printf("Enter role (1 for Admin, 2 for Exam Coordinator): ");
+    scanf("%d", &role);
+
+    // Insert new user with hashed password into the users table
+    snprintf(query, sizeof(query),
+             "INSERT INTO users (username, password, role) VALUES ('%s', MD5('%s'), %d)",
+             username, password, role);
+
+    if (dbQuery(conn, query, QUERY_OTHER)) {
+        fprintf(stderr, "Error registering user: %s\n", mysql_error(conn));
+        return EXIT_FAILURE;
+    }
+
+    printf("\nUser registered successfully.\n");
+    return EXIT_SUCCESS;
+}
+
+
+int login(char *username, int *role) {
+    char password[50];
+    char query[256];
+
+    // Securely get the password
+    getPassword(password, sizeof(password));
+
+    // Prepare the query with hashed password
+    snprintf(query, sizeof(query), 
+             "SELECT role FROM users WHERE username='%s' AND password=MD5('%s')", 
+             username, password);
+
+    // Execute the query
+    if (dbQuery(conn, query, QUERY_OTHER)) {
+        fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
+        return EXIT_FAILURE;
+    }
+
+    MYSQL_RES *res = mysql_store_result(conn);
+    if (res == NULL) {
+        fprintf(stderr, "Could not retrieve result: %s\n", mysql_error(conn));
+        return EXIT_FAILURE;
+    }
+
+    // Check if the user exists and password matches
+    MYSQL_ROW row;
+    if ((row = dbFetchRow(res, QUERY_OTHER)) == NULL) {
+        printf("Invalid username or password.\n");
+        mysql_free_result(res);
+        return EXIT_FAILURE;
+    }
+
+    // Fetch role
+    *role = atoi(row[0]);
+
+    // Clean up
+    mysql_free_result(res);
 
-            snprintf(queryStr, sizeof(queryStr),
-                     "INSERT INTO student_subjects (student_id, subject_id) VALUES (%d, %d)", student_id, subject_id);
-            if (mysql_query(conn, queryStr)) {
-                fprintf(stderr, "INSERT failed: %s\n", mysql_error(conn));
-                fclose(file);
-                return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+// ==== Benchmarks ====
+
+void runBenchmarks() {
+    while (1) {
+        printf("\nBenchmarks:\n");
+        printf("1. CSV Parser (fgets/strtok vs mmap/SIMD reader)\n");
+        printf("2. Seat Allocation (per-bench arrays vs arena + bitsets)\n");
+        printf("3. Placement Strategies (fill rate)\n");
+        printf("4. End-to-End (synthetic exam, JSON report)\n");
+        printf("5. Allocation Storage (MySQL vs in-memory)\n");
+        printf("6. Prepared Statements (text vs binary protocol)\n");
+        printf("7. Seat Lookup Service (p50/p99 under load)\n");
+        printf("8. Back\n");
+        int choice = getValidatedChoice("\nEnter your choice: ");
+
+        switch (choice) {
+            case 1: {
+                char filename[256];
+                printf("Enter CSV file to parse: ");
+                scanf("%255s", filename);
+                benchmarkCSVParsers(filename);
+                break;
             }
+            case 2:
+                benchmarkSeatLayouts();
+                break;
+            case 3:
+                benchmarkPlacementStrategies();
+                break;
+            case 4:
+                benchmarkEndToEnd();
+                break;
+            case 5:
+                benchmarkStorageBackends();
+                break;
+            case 6:
+                benchmarkPreparedStatements();
+                break;
+            case 7:
+                benchmarkSeatService();
+                break;
+            case 8:
+                return;
+            default:
+                printf("Invalid choice. Try again.\n");
+        }
+    }
+}
+
+// Parses the file the way the original ingest loop did, counting records and subjects
+int benchmarkFgetsStrtok(const char *filename, long *records, long *subjects, long *truncated) {
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        return EXIT_FAILURE;
+    }
 
+    char line[1024];
+    *records = *subjects = *truncated = 0;
+    while (fgets(line, sizeof(line), file)) {
+        if (strchr(line, '\n') == NULL && !feof(file)) {
+            (*truncated)++;
+        }
+        char *symbol_number = strtok(line, ",");
+        char *name = strtok(NULL, ",");
+        char *college_name = strtok(NULL, ",");
+        char *subjectList = strtok(NULL, "\n");
+        if (symbol_number == NULL || name == NULL || college_name == NULL || subjectList == NULL) {
+            continue;
+        }
+        (*records)++;
+        char *subject = strtok(subjectList, ";");
+        while (subject != NULL) {
+            (*subjects)++;
             subject = strtok(NULL, ";");
         }
     }
 
     fclose(file);
-    printf("\nCSV data parsed and inserted successfully.\n");
     return EXIT_SUCCESS;
 }
 
+int benchmarkCsvReader(const char *filename, long *records, long *subjects) {
+    CsvReader reader;
+    if (csvReaderOpen(&reader, filename) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
 
-void configureRooms() {
-    char queryStr[256];
-    int id, twoSeaterCount, threeSeaterCount;
-    char choice;
+    CsvField fields[4];
+    int fieldCount;
+    *records = *subjects = 0;
+    while ((fieldCount = csvReaderNextRecord(&reader, fields, 4)) > 0) {
+        if (fieldCount < 4) {
+            continue;
+        }
+        (*records)++;
+        size_t offset = 0;
+        CsvField subject;
+        while (csvNextSubfield(&fields[3], ';', &offset, &subject)) {
+            (*subjects)++;
+        }
+    }
 
-    printf("\nConfiguring Rooms:\n");
-    printf("===================\n");
+    csvReaderClose(&reader);
+    return EXIT_SUCCESS;
+}
 
-    // Fetch existing room configurations
-    if (mysql_query(conn, "SELECT id, room_number, two_seater_count, three_seater_count FROM rooms")) {
-        fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
+// Best of several runs for each parser; the first run also warms the page cache
+void benchmarkCSVParsers(const char *filename) {
+    const int runs = 3;
+    double bestBaseline = 0, bestReader = 0;
+    long baselineRecords = 0, baselineSubjects = 0, truncated = 0;
+    long readerRecords = 0, readerSubjects = 0;
+    int i;
+
+    struct stat info;
+    if (stat(filename, &info) != 0) {
+        fprintf(stderr, "Could not open %s\n", filename);
         return;
     }
+    double megabytes = info.st_size / (1024.0 * 1024.0);
 
-    MYSQL_RES *result = mysql_store_result(conn);
-    if (result == NULL) {
-        fprintf(stderr, "Could not retrieve rooms data: %s\n", mysql_error(conn));
-        return;
+    for (i = 0; i < runs; i++) {
+        double start = getCurrentTimeSeconds();
+        if (benchmarkFgetsStrtok(filename, &baselineRecords, &baselineSubjects, &truncated) == EXIT_FAILURE) {
+            fprintf(stderr, "Could not open %s\n", filename);
+            return;
+        }
+        double elapsed = getCurrentTimeSeconds() - start;
+        if (i == 0 || elapsed < bestBaseline) bestBaseline = elapsed;
+
+        start = getCurrentTimeSeconds();
+        if (benchmarkCsvReader(filename, &readerRecords, &readerSubjects) == EXIT_FAILURE) {
+            fprintf(stderr, "Could not map %s\n", filename);
+            return;
+        }
+        elapsed = getCurrentTimeSeconds() - start;
+        if (i == 0 || elapsed < bestReader) bestReader = elapsed;
     }
 
-    printf("\nCurrent Room Configurations:\n");
-    printf("ID | Room Number | Two-Seater Count | Three-Seater Count\n");
-    printf("-------------------------------------------------------\n");
-    MYSQL_ROW row;
-    while ((row = mysql_fetch_row(result))) {
-        printf("%-2s | %-11s | %-16s | %-18s\n", row[0], row[1], row[2], row[3]);
+    printf("\nCSV parser benchmark: %s (%.1f MB, best of %d runs)\n", filename, megabytes, runs);
+    printf("%-22s | %10s | %10s | %8s | %9s\n", "Parser", "Records", "Subjects", "Seconds", "MB/s");
+    printf("-----------------------------------------------------------------------\n");
+    printf("%-22s | %10ld | %10ld | %8.3f | %9.1f\n", "fgets/strtok",
+           baselineRecords, baselineSubjects, bestBaseline, bestBaseline > 0 ? megabytes / bestBaseline : 0.0);
+    printf("%-22s | %10ld | %10ld | %8.3f | %9.1f\n", "mmap/SIMD CsvReader",
+           readerRecords, readerSubjects, bestReader, bestReader > 0 ? megabytes / bestReader : 0.0);
+    if (bestReader > 0) {
+        printf("Speedup: %.2fx\n", bestBaseline / bestReader);
     }
-    mysql_free_result(result);
+    if (truncated > 0) {
+        printf("Note: fgets/strtok split %ld lines longer than its 1024-byte buffer.\n", truncated);
+    }
+}
 
-    while (1) {
-        printf("\nDo you want to (A)dd, (E)dit, or (D)elete a room? (Enter Q to quit): ");
-        scanf(" %c", &choice);
+// Opens a hardware cache-miss counter for this thread; -1 where unsupported or not permitted
+int perfCounterOpen() {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
 
-        if (choice == 'Q' || choice == 'q') {
-            break;
+void perfCounterStart(int fd) {
+#ifdef __linux__
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    (void)fd;
+#endif
+}
+
+// Returns the events counted since perfCounterStart, or -1 without a counter
+long long perfCounterStop(int fd) {
+    long long count = -1;
+#ifdef __linux__
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+            count = -1;
         }
+    }
+#else
+    (void)fd;
+#endif
+    return count;
+}
 
-        switch (choice) {
-            case 'A':
-            case 'a': {
-                int roomNumber;
-                printf("\nEnter Room Number: ");
-                scanf("%d", &roomNumber);
-                printf("Enter Two-Seater Count: ");
-                scanf("%d", &twoSeaterCount);
-                printf("Enter Three-Seater Count: ");
-                scanf("%d", &threeSeaterCount);
+// Fill rate of each placement strategy on a synthetic day, once with subjects mixed at random and
+// once with students arriving class by class, so each subject comes as one long run
+void benchmarkPlacementStrategies() {
+    const int roomCount = 24, twoSeaters = 40, threeSeaters = 40;
+    const int sittings = 4500, subjects[] = {24, 6};
+    AllocationEngine engine;
+    int run, i;
+
+    for (run = 0; run < 2; run++) {
+        if (buildSyntheticEngine(&engine, roomCount, twoSeaters, threeSeaters, 1, sittings, subjects[run]) ==
+            EXIT_FAILURE) {
+            return;
+        }
+        if (run == 1) {
+            AllocationDay *day = &engine.days[0];
+            for (i = 0; i < sittings; i++) {
+                day->assignments[i].subject_id = 1 + (int)((long)i * subjects[run] / sittings);
+            }
+            if (mapDaySubjects(day) == EXIT_FAILURE) {
+                allocationEngineFree(&engine);
+                return;
+            }
+        }
+        printf("\n%d sittings, %d subjects %s, %d seats:", sittings, subjects[run],
+               run == 0 ? "mixed at random" : "in class-sized runs", roomCount * (twoSeaters * 2 + threeSeaters * 3));
+        compareFillRates(&engine);
+        allocationEngineFree(&engine);
+    }
+}
 
-                snprintf(queryStr, sizeof(queryStr),
-                         "INSERT INTO rooms (room_number, two_seater_count, three_seater_count) "
-                         "VALUES (%d, %d, %d)", roomNumber, twoSeaterCount, threeSeaterCount);
+// The pre-arena conflict check over an int ** matrix, for the seat layout benchmark
+int legacySeatConflict(int **seats, int twoSeaterCount, int totalBenches, int bench, int seat, int subject_id) {
+    int i;
+    int seats_per_bench = bench < twoSeaterCount ? 2 : 3;
+    for (i = -1; i <= 1; i++) {
+        int adjacentSeat = seat + i;
+        if (adjacentSeat >= 0 && adjacentSeat < seats_per_bench && seats[bench][adjacentSeat] == subject_id) {
+            return 1;
+        }
+    }
+    if (bench > 0) {
+        for (i = 0; i < (bench - 1 < twoSeaterCount ? 2 : 3); i++) {
+            if (seats[bench - 1][i] == subject_id) return 1;
+        }
+    }
+    if (bench < totalBenches - 1) {
+        for (i = 0; i < (bench + 1 < twoSeaterCount ? 2 : 3); i++) {
+            if (seats[bench + 1][i] == subject_id) return 1;
+        }
+    }
+    return 0;
+}
 
-                if (mysql_query(conn, queryStr)) {
-                    fprintf(stderr, "Error adding room: %s\n", mysql_error(conn));
-                } else {
-                    printf("Room added successfully.\n");
+// Seats one day the way allocateSeatsForResult did: rooms rebuilt with a calloc per bench,
+// first fit, then every bench freed. Returns the number of malloc/calloc/free calls.
+long legacySeatDay(const Room *rooms, int roomCount, SeatAssignment *assignments, int count) {
+    long allocatorCalls = 0;
+    int ***seats = malloc(sizeof(int **) * roomCount);
+    int i, r, bench, seat;
+    allocatorCalls++;
+    for (r = 0; r < roomCount; r++) {
+        seats[r] = malloc(sizeof(int *) * rooms[r].total_benches);
+        allocatorCalls++;
+        for (bench = 0; bench < rooms[r].total_benches; bench++) {
+            seats[r][bench] = calloc(bench < rooms[r].two_seater_count ? 2 : 3, sizeof(int));
+            allocatorCalls++;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        SeatAssignment *assignment = &assignments[i];
+        assignment->roomIndex = -1;
+        for (r = 0; r < roomCount && assignment->roomIndex < 0; r++) {
+            for (bench = 0; bench < rooms[r].total_benches && assignment->roomIndex < 0; bench++) {
+                int seats_per_bench = bench < rooms[r].two_seater_count ? 2 : 3;
+                for (seat = 0; seat < seats_per_bench; seat++) {
+                    if (seats[r][bench][seat] == 0 &&
+                        !legacySeatConflict(seats[r], rooms[r].two_seater_count, rooms[r].total_benches,
+                                            bench, seat, assignment->subject_id)) {
+                        seats[r][bench][seat] = assignment->subject_id;
+                        assignment->roomIndex = r;
+                        assignment->bench = bench;
+                        assignment->seat = seat;
+                        break;
+                    }
                 }
-                break;
             }
+        }
+    }
 
-            case 'E':
-            case 'e': {
-                printf("\nEnter Room ID to Edit: ");
-                scanf("%d", &id);
-
-                printf("Enter New Two-Seater Count: ");
-                scanf("%d", &twoSeaterCount);
-                printf("Enter New Three-Seater Count: ");
-                scanf("%d", &threeSeaterCount);
+    for (r = 0; r < roomCount; r++) {
+        for (bench = 0; bench < rooms[r].total_benches; bench++) {
+            free(seats[r][bench]);
+            allocatorCalls++;
+        }
+        free(seats[r]);
+        allocatorCalls++;
+    }
+    free(seats);
+    allocatorCalls++;
+    return allocatorCalls;
+}
 
-                snprintf(queryStr, sizeof(queryStr),
-                         "UPDATE rooms SET two_seater_count = %d, three_seater_count = %d "
-                         "WHERE id = %d", twoSeaterCount, threeSeaterCount, id);
+// Synthetic rooms and days for the allocation benchmarks. Subjects are pseudo-random from a fixed
+// seed, so every run and every strategy sees the same input.
+int buildSyntheticEngine(AllocationEngine *engine, int roomCount, int twoSeaters, int threeSeaters,
+                         int days, int sittingsPerDay, int subjects) {
+    unsigned int seed = 12345;
+    int i, day;
+
+    memset(engine, 0, sizeof(*engine));
+    engine->rooms = calloc(roomCount, sizeof(Room));
+    engine->days = calloc(days, sizeof(AllocationDay));
+    if (engine->rooms == NULL || engine->days == NULL) {
+        fprintf(stderr, "Memory allocation failed for benchmark.\n");
+        allocationEngineFree(engine);
+        return EXIT_FAILURE;
+    }
 
-                if (mysql_query(conn, queryStr)) {
-                    fprintf(stderr, "Error updating room: %s\n", mysql_error(conn));
-                } else {
-                    printf("Room updated successfully.\n");
-                }
-                break;
-            }
+    engine->roomCount = roomCount;
+    engine->strategy = &placementStrategies[0];
+    for (i = 0; i < roomCount; i++) {
+        engine->rooms[i].room_id = i + 1;
+        engine->rooms[i].room_number = 101 + i;
+        engine->rooms[i].two_seater_count = twoSeaters;
+        engine->rooms[i].total_benches = twoSeaters + threeSeaters;
+    }
 
-            case 'D':
-            case 'd': {
-                printf("\nEnter Room ID to Delete: ");
-                scanf("%d", &id);
+    engine->dayCount = days;
+    for (day = 0; day < days; day++) {
+        AllocationDay *examDay = &engine->days[day];
+        examDay->day = day + 1;
+        examDay->count = sittingsPerDay;
+        examDay->assignments = malloc(sizeof(SeatAssignment) * sittingsPerDay);
+        if (examDay->assignments == NULL) {
+            fprintf(stderr, "Memory allocation failed for benchmark.\n");
+            allocationEngineFree(engine);
+            return EXIT_FAILURE;
+        }
+        for (i = 0; i < sittingsPerDay; i++) {
+            seed = seed * 1103515245u + 12345u;
+            examDay->assignments[i].student_id = i + 1;
+            examDay->assignments[i].subject_id = (int)((seed >> 16) % subjects) + 1;
+        }
+        if (mapDaySubjects(examDay) == EXIT_FAILURE) {
+            allocationEngineFree(engine);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
 
-                snprintf(queryStr, sizeof(queryStr), "DELETE FROM rooms WHERE id = %d", id);
+// Compares the per-bench int ** layout with the arena layout on the same synthetic exam
+void benchmarkSeatLayouts() {
+    const int roomCount = 24, twoSeaters = 40, threeSeaters = 40;
+    const int days = 4, sittingsPerDay = 4500, subjects = 24, runs = 3;
+    AllocationEngine engine;
+    SeatAssignment *legacy;
+    int i, day, run;
 
-                if (mysql_query(conn, queryStr)) {
-                    fprintf(stderr, "Error deleting room: %s\n", mysql_error(conn));
-                } else {
-                    printf("\nRoom deleted successfully.\n");
-                }
-                break;
-            }
+    if (buildSyntheticEngine(&engine, roomCount, twoSeaters, threeSeaters, days, sittingsPerDay, subjects) ==
+        EXIT_FAILURE) {
+        return;
+    }
+    legacy = malloc(sizeof(SeatAssignment) * days * sittingsPerDay);
+    if (legacy == NULL) {
+        fprintf(stderr, "Memory allocation failed for benchmark.\n");
+        allocationEngineFree(&engine);
+        return;
+    }
+    for (day = 0; day < days; day++) {
+        memcpy(legacy + day * sittingsPerDay, engine.days[day].assignments, sizeof(SeatAssignment) * sittingsPerDay);
+    }
 
-            default:
-                printf("\nInvalid choice. Please try again.\n");
+    int perfFd = perfCounterOpen();
+    double bestLegacy = 0, bestArena = 0;
+    long long legacyMisses = -1, arenaMisses = -1;
+    long legacyCalls = 0, arenaCalls = 0;
+
+    for (run = 0; run < runs; run++) {
+        long calls = 0;
+        perfCounterStart(perfFd);
+        double start = getCurrentTimeSeconds();
+        for (day = 0; day < days; day++) {
+            calls += legacySeatDay(engine.rooms, roomCount, legacy + day * sittingsPerDay, sittingsPerDay);
+        }
+        double elapsed = getCurrentTimeSeconds() - start;
+        long long misses = perfCounterStop(perfFd);
+        if (run == 0 || elapsed < bestLegacy) bestLegacy = elapsed;
+        if (run == 0 || misses < legacyMisses) legacyMisses = misses;
+        legacyCalls = calls;
+
+        SeatWorkspace workspace = {0};
+        perfCounterStart(perfFd);
+        start = getCurrentTimeSeconds();
+        for (day = 0; day < days; day++) {
+            allocateDay(&workspace, engine.rooms, roomCount, engine.strategy, &engine.days[day]);
         }
+        seatWorkspaceFree(&workspace);
+        elapsed = getCurrentTimeSeconds() - start;
+        misses = perfCounterStop(perfFd);
+        if (run == 0 || elapsed < bestArena) bestArena = elapsed;
+        if (run == 0 || misses < arenaMisses) arenaMisses = misses;
+        arenaCalls = 4; // Room copy and arena: one malloc and one free each for the whole run
     }
+#ifdef __linux__
+    if (perfFd >= 0) close(perfFd);
+#endif
 
-    printf("\nExiting Room Configuration.\n");
-}
+    int mismatches = 0;
+    for (i = 0; i < days * sittingsPerDay; i++) {
+        const SeatAssignment *assignment = &engine.days[i / sittingsPerDay].assignments[i % sittingsPerDay];
+        if (legacy[i].roomIndex != assignment->roomIndex ||
+            (legacy[i].roomIndex >= 0 && (legacy[i].bench != assignment->bench || legacy[i].seat != assignment->seat))) {
+            mismatches++;
+        }
+    }
 
+    printf("\nSeat allocation benchmark: %d rooms x %d benches, %d days x %d sittings (best of %d runs)\n",
+           roomCount, twoSeaters + threeSeaters, days, sittingsPerDay, runs);
+    printf("%-22s | %9s | %15s | %14s\n", "Layout", "Seconds", "Allocator calls", "Cache misses");
+    printf("-------------------------------------------------------------------------\n");
+    printf("%-22s | %9.3f | %15ld | ", "int ** per bench", bestLegacy, legacyCalls);
+    if (legacyMisses >= 0) printf("%14lld\n", legacyMisses); else printf("%14s\n", "n/a");
+    printf("%-22s | %9.3f | %15ld | ", "Arena + bitset index", bestArena, arenaCalls);
+    if (arenaMisses >= 0) printf("%14lld\n", arenaMisses); else printf("%14s\n", "n/a");
+    if (bestArena > 0) {
+        printf("Speedup: %.2fx\n", bestLegacy / bestArena);
+    }
+    if (perfFd < 0) {
+        printf("Note: hardware cache counters are unavailable here (perf_event_open).\n");
+    }
+    printf("Placements %s.\n", mismatches == 0 ? "identical" : "DIFFER");
 
-void resetTables() {
-    const char *queries[] = {
-        "SET FOREIGN_KEY_CHECKS = 0",
-        "TRUNCATE TABLE seat_allocation",
-        "TRUNCATE TABLE student_subjects",
-        "TRUNCATE TABLE students",
-        "TRUNCATE TABLE subjects",
-        "TRUNCATE TABLE rooms",
-        "SET FOREIGN_KEY_CHECKS = 1"
-    };
-    int numQueries = sizeof(queries) / sizeof(queries[0]);
-    int i;
+    free(legacy);
+    allocationEngineFree(&engine);
+}
 
-    for (i = 0; i < numQueries; i++) {
-        if (mysql_query(conn, queries[i])) {
-            fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
-            return;
+// Writes students x subjectsPerStudent enrollments in the students.csv layout. Each student takes a
+// run of consecutive subjects from a pseudo-random start, so subjects are distinct per student and
+// the same seed always produces the same file.
+int generateSyntheticCSV(const char *filename, const SyntheticConfig *config, long *rows) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Could not create %s\n", filename);
+        return EXIT_FAILURE;
+    }
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+    unsigned int seed = config->seed;
+    long student;
+    int k;
+    *rows = 0;
+    for (student = 1; student <= config->students; student++) {
+        seed = seed * 1103515245u + 12345u;
+        int first = (int)((seed >> 16) % config->subjects);
+        int college = (int)((student - 1) % config->colleges);
+        for (k = 0; k < config->subjectsPerStudent; k++) {
+            if (fprintf(file, "%ld,Student_%ld,College_Group_%d,Subject_%d\n", student, student, college,
+                        (first + k) % config->subjects + 1) < 0) {
+                fprintf(stderr, "Could not write %s\n", filename);
+                fclose(file);
+                return EXIT_FAILURE;
+            }
+            (*rows)++;
         }
     }
 
-    printf("\nAll tables have been reset successfully.\n");
-    clearScreenWithMessage("...");
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Could not write %s\n", filename);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
 }
 
-void unifiedSeatAllocation(int maxDays) {
-    char queryStr[512];
-    snprintf(queryStr, sizeof(queryStr),
-             "SELECT MAX(subject_count) FROM (SELECT COUNT(ss.subject_id) AS subject_count "
-             "FROM student_subjects ss GROUP BY ss.student_id) AS subject_counts");
+// Adds config->rooms rooms with the configured bench mix in one statement
+int addSyntheticRooms(const SyntheticConfig *config) {
+    SqlBatch batch = {0};
+    int status = EXIT_SUCCESS;
+    int i;
 
-    if (mysql_query(conn, queryStr)) {
-        fprintf(stderr, "Query to fetch maximum subject count failed: %s\n", mysql_error(conn));
-        return;
+    batch.connection = conn;
+    batch.prefix = "INSERT INTO rooms (room_number, two_seater_count, three_seater_count) VALUES ";
+    for (i = 0; i < config->rooms && status == EXIT_SUCCESS; i++) {
+        char values[64];
+        snprintf(values, sizeof(values), "(%d,%d,%d)", 101 + i, config->twoSeaters, config->threeSeaters);
+        if (sqlBatchBeginRow(&batch) || sqlBufferAppend(&batch.buffer, values) || sqlBatchEndRow(&batch)) {
+            status = EXIT_FAILURE;
+        }
+    }
+    if (status == EXIT_SUCCESS && sqlBatchFlush(&batch)) {
+        status = EXIT_FAILURE;
     }
+    sqlBufferFree(&batch.buffer);
+    return status;
+}
 
+// Single number from a COUNT(*) style query, -1 on error
+long queryCount(const char *query) {
+    if (dbQuery(conn, query, QUERY_OTHER)) {
+        fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
+        return -1;
+    }
     MYSQL_RES *result = mysql_store_result(conn);
     if (result == NULL) {
-        fprintf(stderr, "Could not retrieve subject count: %s\n", mysql_error(conn));
-        return;
+        return -1;
     }
-
-    MYSQL_ROW row = mysql_fetch_row(result);
-    int maxSubjects = row ? atoi(row[0]) : 0;
+    MYSQL_ROW row = dbFetchRow(result, QUERY_OTHER);
+    long count = (row && row[0]) ? atol(row[0]) : -1;
     mysql_free_result(result);
+    return count;
+}
 
-    if (maxSubjects == 0) {
-        printf("No subjects found for any student.\n");
-        return;
+// Peak resident set size of this process so far, in kilobytes; -1 where unavailable
+long peakRssKilobytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return (long)(counters.PeakWorkingSetSize / 1024);
+    }
+    return -1;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
     }
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // Bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
 
-    // Iterate through days up to the maximum allowed or required
-    int day;
-    for (day = 1; day <= maxDays && day <= maxSubjects; day++) {
-        printf("\nAllocating seats for Day %d...\n", day);
-        allocateSeatsForDay(day);
+// The part of a results file that says what was measured; runs are only comparable when it matches
+void formatBenchmarkConfig(char *text, size_t size, const SyntheticConfig *config, const char *ingestMode) {
+    snprintf(text, size,
+             "  \"backend\": \"mysql\",\n"
+             "  \"ingest_mode\": \"%s\",\n"
+             "  \"config\": {\"students\": %ld, \"subjects_per_student\": %d, \"subjects\": %d, "
+             "\"colleges\": %d, \"rooms\": %d, \"two_seaters\": %d, \"three_seaters\": %d, \"seed\": %u},\n",
+             ingestMode, config->students, config->subjectsPerStudent, config->subjects, config->colleges,
+             config->rooms, config->twoSeaters, config->threeSeaters, config->seed);
+}
+
+int writeBenchmarkJson(const char *filename, const char *configText, const BenchmarkPhase *phases, int phaseCount) {
+    FILE *file = fopen(filename, "w");
+    int i;
+    if (file == NULL) {
+        fprintf(stderr, "Could not create %s\n", filename);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(file, "{\n%s", configText);
+    fprintf(file, "  \"phases\": [\n");
+    for (i = 0; i < phaseCount; i++) {
+        const BenchmarkPhase *phase = &phases[i];
+        fprintf(file, "    {\"name\": \"%s\", \"seconds\": %.6f, \"items\": %ld, \"items_per_second\": %.1f, "
+                      "\"peak_rss_kb\": %ld}%s\n",
+                phase->name, phase->seconds, phase->items, phase->seconds > 0 ? phase->items / phase->seconds : 0.0,
+                phase->peakRssKb, i + 1 < phaseCount ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Could not write %s\n", filename);
+        return EXIT_FAILURE;
     }
+    return EXIT_SUCCESS;
 }
 
-// Function to allocate a seat
-void allocateSeat(int student_id, int subject_id, Room *room, int bench, int seat, int day) {
-    char query[1024];
+// Reads a results file written by writeBenchmarkJson; they are a few hundred bytes
+int loadBenchmarkJson(const char *filename, char *text, size_t size) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return EXIT_FAILURE;
+    }
+    size_t length = fread(text, 1, size - 1, file);
+    fclose(file);
+    text[length] = '\0';
+    return EXIT_SUCCESS;
+}
+
+// Seconds recorded for a phase in a results file
+int baselineSeconds(const char *text, const char *phaseName, double *seconds) {
+    char key[96];
+    snprintf(key, sizeof(key), "\"name\": \"%s\"", phaseName);
+    const char *phase = strstr(text, key);
+    const char *value = phase ? strstr(phase, "\"seconds\":") : NULL;
+    if (value == NULL) {
+        return EXIT_FAILURE;
+    }
+    *seconds = strtod(value + strlen("\"seconds\":"), NULL);
+    return EXIT_SUCCESS;
+}
 
-    // Insert the allocation into the seat_allocation table
-    snprintf(query, sizeof(query),
-             "INSERT INTO seat_allocation (student_id, subject_id, room_id, bench_number, seat_number, day) "
-             "VALUES (%d, %d, %d, %d, %d, %d)",
-             student_id, subject_id, room->room_id, bench, seat, day);
+// Prints every phase against the baseline; returns how many are slower than the tolerance allows
+int compareWithBaseline(const char *baselineFile, const char *configText, const BenchmarkPhase *phases,
+                        int phaseCount) {
+    char text[8192];
+    int regressions = 0;
+    int i;
+    double baseline;
 
-    if (mysql_query(conn, query)) {
-        fprintf(stderr, "Seat allocation failed for student_id=%d, subject_id=%d on Day %d: %s\n",
-                student_id, subject_id, day, mysql_error(conn));
-        return;
+    if (loadBenchmarkJson(baselineFile, text, sizeof(text)) == EXIT_FAILURE ||
+        baselineSeconds(text, phases[0].name, &baseline) == EXIT_FAILURE) {
+        printf("\nNo baseline in %s to compare against.\n", baselineFile);
+        return 0;
     }
 
-    // Mark the seat as allocated in the room's seat matrix
-    room->seats[bench][seat] = subject_id;
+    printf("\nAgainst baseline %s (regression above +%.0f%%):\n", baselineFile, BENCHMARK_REGRESSION_TOLERANCE * 100);
+    if (strstr(text, configText) == NULL) {
+        printf("Note: the baseline was recorded with a different configuration or ingest mode.\n");
+    }
+    printf("%-15s | %10s | %10s | %8s\n", "Phase", "Baseline", "Current", "Change");
+    printf("-------------------------------------------------------\n");
+    for (i = 0; i < phaseCount; i++) {
+        if (baselineSeconds(text, phases[i].name, &baseline) == EXIT_FAILURE || baseline <= 0) {
+            printf("%-15s | %10s | %9.3fs | %8s\n", phases[i].name, "n/a", phases[i].seconds, "");
+            continue;
+        }
+        double change = phases[i].seconds / baseline - 1;
+        int regressed = change > BENCHMARK_REGRESSION_TOLERANCE && phases[i].seconds - baseline > BENCHMARK_NOISE_SECONDS;
+        printf("%-15s | %9.3fs | %9.3fs | %+7.1f%%%s\n", phases[i].name, baseline, phases[i].seconds, change * 100,
+               regressed ? "  REGRESSION" : "");
+        regressions += regressed;
+    }
+    return regressions;
 }
 
-// Main allocation function
-void allocateSeatsForAllDays() {
-    char query[512];
-    MYSQL_RES *result;
-    MYSQL_ROW row;
-
-    // Query to determine the maximum number of subjects for any student
-    snprintf(query, sizeof(query),
-             "SELECT MAX(subject_count) FROM ("
-             "SELECT COUNT(subject_id) AS subject_count FROM student_subjects GROUP BY student_id"
-             ") AS subject_counts");
-
-    if (mysql_query(conn, query)) {
-        fprintf(stderr, "Query to fetch maximum subject count failed: %s\n", mysql_error(conn));
+// Generates a synthetic exam, then times ingest, allocation and export against the configured
+// database. Results go to BENCHMARK_RESULTS_FILE and are checked against BENCHMARK_BASELINE_FILE.
+void benchmarkEndToEnd() {
+    SyntheticConfig config;
+    BenchmarkPhase phases[6];
+    const char *ingestModes[] = {"row_by_row", "bulk", "parallel", "compare"};
+    const char *ingestPhases[] = {"ingest_row", "ingest_bulk", "ingest_parallel"};
+    int phaseCount = 0;
+
+    config.students = getValidatedChoice("Number of students: ");
+    config.subjectsPerStudent = getValidatedChoice("Subjects per student: ");
+    config.subjects = getValidatedChoice("Subjects in total: ");
+    config.colleges = getValidatedChoice("Colleges: ");
+    config.rooms = getValidatedChoice("Rooms: ");
+    config.twoSeaters = getValidatedChoice("Two-seater benches per room: ");
+    config.threeSeaters = getValidatedChoice("Three-seater benches per room: ");
+    config.seed = 12345;
+    if (config.students <= 0 || config.subjects <= 0 || config.colleges <= 0 || config.rooms < 0 ||
+        config.subjectsPerStudent <= 0 || config.subjectsPerStudent > config.subjects) {
+        printf("Invalid configuration.\n");
         return;
     }
-
-    result = mysql_store_result(conn);
-    if (result == NULL) {
-        fprintf(stderr, "Could not retrieve subject count: %s\n", mysql_error(conn));
+    int ingestMode = getValidatedChoice("Ingest mode (1 Row by Row, 2 Bulk, 3 Parallel, 4 Compare all three): ");
+    if (ingestMode < 1 || ingestMode > 4) {
+        printf("Invalid choice.\n");
         return;
     }
-
-    row = mysql_fetch_row(result);
-    int maxDays = row ? atoi(row[0]) : 0;  // Maximum number of subjects = Number of days
-    mysql_free_result(result);
-
-    if (maxDays == 0) {
-        printf("No subjects found for any student. No allocation needed.\n");
+    if (getValidatedChoice("This resets every table. Enter 1 to continue: ") != 1) {
         return;
     }
 
-    printf("Allocating seats for %d days based on the maximum number of subjects.\n", maxDays);
-
-    // Iterate over days and allocate seats
-    int day;
-    for (day = 1; day <= maxDays; day++) {
-        printf("\nAllocating seats for Day %d...\n", day);
-        allocateSeatsForDay(day);  // Allocate seats for the current day
-        printf("\nDay %d allocation completed.\n", day);
+    double start = getCurrentTimeSeconds();
+    long rows;
+    if (generateSyntheticCSV(SYNTHETIC_CSV_FILE, &config, &rows) == EXIT_FAILURE) {
+        return;
     }
+    phases[phaseCount++] = (BenchmarkPhase){"generate", getCurrentTimeSeconds() - start, rows, peakRssKilobytes()};
+
+    // Compare mode loads the same file into empty tables once per ingest path, so each path is
+    // timed on its own and the allocation below runs against the last load
+    int first = ingestMode == 4 ? 1 : ingestMode;
+    int last = ingestMode == 4 ? 3 : ingestMode;
+    int mode;
+    for (mode = first; mode <= last; mode++) {
+        if (resetTables() == EXIT_FAILURE || addSyntheticRooms(&config) == EXIT_FAILURE) {
+            return;
+        }
 
-    printf("\nAll %d days processed. Seat allocation completed.\n", maxDays);
-}
-
-
-void allocateSeatsForDay(int day) {
-    char query[2048];
-    MYSQL_RES *result;
-    MYSQL_ROW row;
-
-    // Fetch students and their subjects for the given day (subject_index = day)
-    snprintf(query, sizeof(query),
-             "SELECT s.id AS student_id, ss.subject_id "
-             "FROM students s "
-             "JOIN student_subjects ss ON s.id = ss.student_id "
-             "WHERE ss.subject_index = %d "
-             "AND NOT EXISTS (SELECT 1 FROM seat_allocation "
-             "WHERE seat_allocation.student_id = s.id "
-             "AND seat_allocation.subject_id = ss.subject_id "
-             "AND seat_allocation.day = %d) "
-             "ORDER BY s.id, ss.subject_id", day, day);
+        int status;
+        start = getCurrentTimeSeconds();
+        if (mode == 1) {
+            status = parseAndInsertCSV(SYNTHETIC_CSV_FILE);
+        } else if (mode == 2) {
+            status = bulkInsertCSV(SYNTHETIC_CSV_FILE, DEFAULT_BULK_BATCH_SIZE);
+        } else {
+            status = parallelInsertCSV(SYNTHETIC_CSV_FILE, DEFAULT_INGEST_WRITERS, DEFAULT_BULK_BATCH_SIZE);
+        }
+        if (status == EXIT_FAILURE) {
+            return;
+        }
+        phases[phaseCount++] = (BenchmarkPhase){ingestMode == 4 ? ingestPhases[mode - 1] : "ingest",
+                                                getCurrentTimeSeconds() - start, rows, peakRssKilobytes()};
+    }
 
-    if (mysql_query(conn, query)) {
-        fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
+    start = getCurrentTimeSeconds();
+    if (unifiedSeatAllocation(&mysqlStorage, &mainStatements, BENCHMARK_EXAM_DAYS, &placementStrategies[0], 0,
+                              NULL) == EXIT_FAILURE) {
         return;
     }
-
-    result = mysql_store_result(conn);
-    if (result == NULL) {
-        fprintf(stderr, "Could not retrieve result set: %s\n", mysql_error(conn));
+    double elapsed = getCurrentTimeSeconds() - start;
+    long seats = queryCount("SELECT COUNT(*) FROM seat_allocation");
+    if (seats < 0) {
         return;
     }
+    phases[phaseCount++] = (BenchmarkPhase){"allocate", elapsed, seats, peakRssKilobytes()};
 
-    // Room and seat allocation logic remains the same
-    // Use the revised function from earlier to allocate seats for students
-    allocateSeatsForResult(result, day);  // Helper function to allocate seats
-    mysql_free_result(result);
-}
-
-void allocateSeatsForResult(MYSQL_RES *result, int day) {
-    MYSQL_ROW row;
+    start = getCurrentTimeSeconds();
+    if (exportAllocatedSeatsMatrix(SYNTHETIC_EXPORT_FILE) == EXIT_FAILURE) {
+        return;
+    }
+    phases[phaseCount++] = (BenchmarkPhase){"export", getCurrentTimeSeconds() - start, seats, peakRssKilobytes()};
 
-    // Query to fetch room details
-    char query[512];
-    snprintf(query, sizeof(query),
-             "SELECT id, room_number, two_seater_count, three_seater_count "
-             "FROM rooms");
+    printf("\nEnd-to-end benchmark: %ld students, %ld enrollments, %d rooms (%s ingest)\n", config.students, rows,
+           config.rooms, ingestModes[ingestMode - 1]);
+    printf("%-15s | %9s | %10s | %12s | %12s\n", "Phase", "Seconds", "Items", "Items/s", "Peak RSS KB");
+    printf("-------------------------------------------------------------------------\n");
+    int i;
+    for (i = 0; i < phaseCount; i++) {
+        printf("%-15s | %9.3f | %10ld | %12.0f | %12ld\n", phases[i].name, phases[i].seconds, phases[i].items,
+               phases[i].seconds > 0 ? phases[i].items / phases[i].seconds : 0.0, phases[i].peakRssKb);
+    }
 
-    if (mysql_query(conn, query)) {
-        fprintf(stderr, "Room query failed: %s\n", mysql_error(conn));
-        return;
+    char configText[512];
+    formatBenchmarkConfig(configText, sizeof(configText), &config, ingestModes[ingestMode - 1]);
+    if (writeBenchmarkJson(BENCHMARK_RESULTS_FILE, configText, phases, phaseCount) == EXIT_SUCCESS) {
+        printf("\nResults written to %s\n", BENCHMARK_RESULTS_FILE);
+    }
+    int regressions = compareWithBaseline(BENCHMARK_BASELINE_FILE, configText, phases, phaseCount);
+    if (regressions > 0) {
+        printf("%d phase(s) regressed.\n", regressions);
     }
+    if (getValidatedChoice("\nEnter 1 to save these results as the baseline: ") == 1 &&
+        writeBenchmarkJson(BENCHMARK_BASELINE_FILE, configText, phases, phaseCount) == EXIT_SUCCESS) {
+        printf("Baseline saved to %s\n", BENCHMARK_BASELINE_FILE);
+    }
+}
 
-    MYSQL_RES *roomResult = mysql_store_result(conn);
-    if (roomResult == NULL) {
-        fprintf(stderr, "Could not retrieve room data: %s\n", mysql_error(conn));
+// Seats the current enrollments twice, reading them from MySQL and from an in-memory copy of the
+// tables, and saves neither run. Both must place every sitting the same way.
+void benchmarkStorageBackends() {
+    MemoryStorage store;
+    AllocationEngine engines[2];
+    double seconds[2];
+    const char *names[2];
+    long sittings = 0;
+    int ready = 0, mismatches = 0;
+    int b, d, i;
+
+    if (memoryStorageInit(&store) == EXIT_FAILURE) {
         return;
     }
-
-    int roomCount = mysql_num_rows(roomResult);
-    Room *rooms = malloc(sizeof(Room) * roomCount);
-    if (!rooms) {
-        fprintf(stderr, "Memory allocation failed for rooms.\n");
-        mysql_free_result(roomResult);
+    double start = getCurrentTimeSeconds();
+    if (memoryStorageCopyDatabase(&store, conn) == EXIT_FAILURE) {
+        memoryStorageFree(&store);
         return;
     }
-
-    // Initialize room data
-    int roomIndex = 0;
-    MYSQL_ROW roomRow;
-    while ((roomRow = mysql_fetch_row(roomResult))) {
-        rooms[roomIndex].room_id = atoi(roomRow[0]);
-        rooms[roomIndex].room_number = atoi(roomRow[1]);
-        int twoSeaterCount = atoi(roomRow[2]);
-        int threeSeaterCount = atoi(roomRow[3]);
-        rooms[roomIndex].total_benches = twoSeaterCount + threeSeaterCount;
-
-        // Allocate memory for seat status
-        rooms[roomIndex].seats = malloc(sizeof(int *) * rooms[roomIndex].total_benches);
-        int i;
-		for (i = 0; i < rooms[roomIndex].total_benches; i++) {
-            int seats_per_bench = (i < twoSeaterCount) ? 2 : 3; // Determine bench type
-            rooms[roomIndex].seats[i] = calloc(seats_per_bench, sizeof(int));
-            if (!rooms[roomIndex].seats[i]) {
-                fprintf(stderr, "Memory allocation failed for bench %d in room %d.\n", i, roomIndex);
-                exit(EXIT_FAILURE);
-            }
+    double copySeconds = getCurrentTimeSeconds() - start;
+
+    StorageBackend memory = memoryStorageBackend(&store);
+    StorageBackend *backends[2] = {&mysqlStorage, &memory};
+    void *sessions[2] = {&mainStatements, &store};
+    for (b = 0; b < 2; b++) {
+        names[b] = backends[b]->name;
+        start = getCurrentTimeSeconds();
+        if (allocationEngineInit(&engines[b], backends[b], sessions[b], BENCHMARK_EXAM_DAYS) == EXIT_FAILURE) {
+            break;
+        }
+        ready++;
+        engines[b].strategy = &placementStrategies[0];
+        if (allocationEngineRun(&engines[b], DEFAULT_ALLOCATION_WORKERS) == EXIT_FAILURE) {
+            break;
         }
-        roomIndex++;
+        seconds[b] = getCurrentTimeSeconds() - start;
     }
-    mysql_free_result(roomResult);
 
-    // Allocate seats for students
-    int total_allocated = 0, total_failed = 0;
-    while ((row = mysql_fetch_row(result))) {
-        int student_id = atoi(row[0]);
-        int subject_id = atoi(row[1]);
-        int allocated = 0;
-
-        // Try to allocate a seat for this student and subject
-        int i, bench, seat;
-        for (i = 0; i < roomCount && !allocated; i++) {
-            Room *room = &rooms[i];
-            for (bench = 0; bench < room->total_benches && !allocated; bench++) {
-                int seats_per_bench = (bench < room->total_benches / 2) ? 2 : 3; // Determine seats per bench dynamically
-                for (seat = 0; seat < seats_per_bench && !allocated; seat++) {
-                    if (room->seats[bench][seat] == 0 &&  // Seat is free
-                        !isAdjacentSeatConflict(room->room_id, bench, seat, room->total_benches,
-                                                seats_per_bench, subject_id, room->seats)) {
-                        allocateSeat(student_id, subject_id, room, bench, seat, day);
-                        room->seats[bench][seat] = subject_id;  // Mark seat as allocated
-                        allocated = 1;
-                        total_allocated++;
-                    }
+    if (b == 2) {
+        if (engines[0].dayCount != engines[1].dayCount) {
+            mismatches++;
+        }
+        for (d = 0; d < engines[0].dayCount && d < engines[1].dayCount; d++) {
+            const AllocationDay *x = &engines[0].days[d], *y = &engines[1].days[d];
+            sittings += x->count;
+            if (x->count != y->count) {
+                mismatches++;
+                continue;
+            }
+            for (i = 0; i < x->count; i++) {
+                const SeatAssignment *p = &x->assignments[i], *q = &y->assignments[i];
+                if (p->student_id != q->student_id || p->subject_id != q->subject_id || p->roomIndex != q->roomIndex ||
+                    p->bench != q->bench || p->seat != q->seat) {
+                    mismatches++;
                 }
             }
         }
 
-        if (!allocated) {
-            printf("Failed to allocate seat for student %d (Subject: %d) on Day %d.\n",
-                   student_id, subject_id, day);
-            total_failed++;
+        printf("\nAllocation of %ld sittings over %d days (load and place, nothing saved)\n", sittings,
+               engines[0].dayCount);
+        printf("%-10s | %9s | %12s\n", "Storage", "Seconds", "Sittings/s");
+        printf("--------------------------------------\n");
+        for (b = 0; b < 2; b++) {
+            printf("%-10s | %9.3f | %12.0f\n", names[b], seconds[b], seconds[b] > 0 ? sittings / seconds[b] : 0.0);
         }
+        printf("Copying the tables into memory took %.3f s.\n", copySeconds);
+        if (seconds[1] > 0) {
+            printf("Speedup: %.2fx\n", seconds[0] / seconds[1]);
+        }
+        printf("Placements %s.\n", mismatches == 0 ? "identical" : "DIFFER");
     }
 
-    printf("\nDay %d Allocation Summary:\n", day);
-    printf("Total Allocated: %d\n", total_allocated);
-    printf("Total Failed: %d\n", total_failed);
-
-    // Free memory for rooms and benches
-    int i, j;
-    for (i = 0; i < roomCount; i++) {
-        for (j = 0; j < rooms[i].total_benches; j++) {
-            free(rooms[i].seats[j]);
-        }
-        free(rooms[i].seats);
+    for (b = 0; b < ready; b++) {
+        allocationEngineFree(&engines[b]);
     }
-    free(rooms);
+    memoryStorageFree(&store);
 }
 
-int isAdjacentSeatConflict(int room_id, int bench, int seat, int total_benches, int seats_per_bench, int subject_id, int **seatMatrix) {
-    // Check the current bench
-    int i;
-    for (i = -1; i <= 1; i++) {  // Check adjacent seats: -1 (left), 0 (current), 1 (right)
-        int adjacentSeat = seat + i;
-        if (adjacentSeat >= 0 && adjacentSeat < seats_per_bench && seatMatrix[bench][adjacentSeat] == subject_id) {
-            return 1;  // Conflict detected
-        }
+// Runs the hot query shapes once as text and once as prepared statements: id lookups by symbol
+// number as ingest does them, the per-day enrollment load and the seat inserts of a save. Both
+// protocols must return the same rows. The inserts are rolled back, so nothing is changed.
+void benchmarkPreparedStatements() {
+    const char *names[3] = {"Id lookups", "Day loads", "Seat inserts"};
+    double seconds[3][2] = {{0}};
+    long rows[3][2] = {{0}};
+    uint64_t digests[2] = {14695981039346656037ULL, 14695981039346656037ULL};
+    long prepares = mainStatements.prepares, hits = mainStatements.hits;
+    long mismatches = 0;
+    int mode, d, i;
+
+    if (dbQuery(conn, "SELECT id, symbol_number FROM students", QUERY_OTHER)) {
+        fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
+        return;
+    }
+    MYSQL_RES *students = mysql_store_result(conn);
+    if (students == NULL) {
+        fprintf(stderr, "Could not retrieve students: %s\n", mysql_error(conn));
+        return;
+    }
+    MYSQL_STMT *lookup = statementCacheGet(&mainStatements, studentIdQuery);
+    if (lookup == NULL) {
+        mysql_free_result(students);
+        return;
     }
 
-    // Check the previous bench
-    if (bench > 0) {  // Ensure the previous bench exists
-        for (i = 0; i < seats_per_bench; i++) {
-            if (seatMatrix[bench - 1][i] == subject_id) {
-                return 1;  // Conflict detected
+    SqlBuffer query = {0};
+    for (mode = 0; mode < 2; mode++) {
+        MYSQL_ROW row;
+        mysql_data_seek(students, 0);
+        double start = getCurrentTimeSeconds();
+        while (rows[0][mode] < BENCHMARK_ID_LOOKUPS && (row = mysql_fetch_row(students))) {
+            int id = 0;
+            if (mode == 0) {
+                query.length = 0;
+                if (sqlBufferAppend(&query, "SELECT id FROM students WHERE symbol_number=") == EXIT_FAILURE ||
+                    sqlBufferAppendEscaped(&query, conn, row[1]) == EXIT_FAILURE) {
+                    break;
+                }
+                if (dbRealQuery(conn, query.data, query.length, QUERY_ID_LOOKUP) == 0) {
+                    MYSQL_RES *result = mysql_store_result(conn);
+                    MYSQL_ROW idRow = result ? dbFetchRow(result, QUERY_ID_LOOKUP) : NULL;
+                    id = idRow ? atoi(idRow[0]) : 0;
+                    if (result) mysql_free_result(result);
+                }
+            } else {
+                unsigned long length;
+                MYSQL_BIND param, result;
+                bindText(&param, row[1], &length);
+                bindInt(&result, &id);
+                if (mysql_stmt_bind_param(lookup, &param) == 0 && dbStatementExecute(lookup, QUERY_ID_LOOKUP) == 0 &&
+                    mysql_stmt_bind_result(lookup, &result) == 0) {
+                    dbStatementFetch(lookup, QUERY_ID_LOOKUP);
+                }
+                mysql_stmt_free_result(lookup);
             }
+            mismatches += id != atoi(row[0]);
+            rows[0][mode]++;
         }
+        seconds[0][mode] = getCurrentTimeSeconds() - start;
     }
-
-    // Check the next bench
-    if (bench < total_benches - 1) {  // Ensure the next bench exists
-        for (i = 0; i < seats_per_bench; i++) {
-            if (seatMatrix[bench + 1][i] == subject_id) {
-                return 1;  // Conflict detected
+    sqlBufferFree(&query);
+    mysql_free_result(students);
+
+    for (mode = 0; mode < 2; mode++) {
+        double start = getCurrentTimeSeconds();
+        for (d = 1; d <= BENCHMARK_EXAM_DAYS; d++) {
+            AllocationDay day;
+            memset(&day, 0, sizeof(day));
+            day.day = d;
+            int status = mode == 0 ? loadDayEnrollmentsText(conn, &day)
+                                   : mysqlStorageLoadDayEnrollments(&mainStatements, &day);
+            if (status == EXIT_FAILURE) {
+                mismatches++;
             }
+            for (i = 0; i < day.count; i++) {
+                digests[mode] = hashBytes(digests[mode], &day.assignments[i].student_id, sizeof(int));
+                digests[mode] = hashBytes(digests[mode], &day.assignments[i].subject_id, sizeof(int));
+            }
+            rows[1][mode] += day.count;
+            free(day.assignments);
         }
+        seconds[1][mode] = getCurrentTimeSeconds() - start;
     }
+    mismatches += digests[0] != digests[1];
 
-    return 0;  // No conflict
-}
-
-void exportAllocatedSeatsMatrix(const char *filename) {
-    FILE *file = fopen(filename, "w");
-    if (file == NULL) {
-        fprintf(stderr, "Could not open file for writing.\n");
-        return;
-    }
-
-    // Query to fetch seat allocation details
-    char queryStr[1024];
-    snprintf(queryStr, sizeof(queryStr),
-             "SELECT a.day, r.room_number, a.bench_number, r.two_seater_count, r.three_seater_count, "
-             "a.seat_number, s.symbol_number, sub.subject_name "
-             "FROM seat_allocation a "
-             "JOIN rooms r ON a.room_id = r.id "
-             "JOIN students s ON a.student_id = s.id "
-             "JOIN subjects sub ON a.subject_id = sub.id "
-             "ORDER BY a.day, r.room_number, a.bench_number, a.seat_number");
-
-    if (mysql_query(conn, queryStr)) {
-        fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
-        fclose(file);
-        return;
-    }
-
-    res = mysql_store_result(conn);
-    if (res == NULL) {
-        fprintf(stderr, "Could not retrieve data: %s\n", mysql_error(conn));
-        fclose(file);
+    // Seats from an allocation run that is never saved
+    AllocationEngine engine;
+    if (allocationEngineInit(&engine, &mysqlStorage, &mainStatements, BENCHMARK_EXAM_DAYS) == EXIT_FAILURE) {
         return;
     }
-
-    if (mysql_num_rows(res) == 0) {
-        fprintf(file, "No seat allocations available.\n");
-        printf("Query returned no results.\n");
-        mysql_free_result(res);
-        fclose(file);
+    engine.strategy = &placementStrategies[0];
+    if (allocationEngineRun(&engine, DEFAULT_ALLOCATION_WORKERS) == EXIT_FAILURE) {
+        allocationEngineFree(&engine);
         return;
     }
-
-    // Variables to track current day and room to create sections
-    int current_day = -1, current_room = -1;
-    int two_seater_count = 0, three_seater_count = 0;
-    int current_bench = -1;
-
-    fprintf(file, "Allocated Seats Matrix\n");
-    fprintf(file, "=======================\n\n");
-
-    while ((row = mysql_fetch_row(res))) {
-        int day = atoi(row[0]);
-        int room_number = atoi(row[1]);
-        int bench_number = atoi(row[2]);
-        int seat_number = atoi(row[5]);
-        const char *symbol_number = row[6];
-        const char *subject_name = row[7];
-
-        // Section for a new day
-        if (day != current_day) {
-            if (current_day != -1) fprintf(file, "\n\n\n"); // Add spacing between days
-            fprintf(file, "Day %d\n", day);
-            fprintf(file, "-------\n");
-            current_day = day;
-            current_room = -1; // Reset room tracking
-        }
-
-        // Section for a new room
-        if (room_number != current_room) {
-            if (current_room != -1) fprintf(file, "\n\n"); // Add spacing between rooms
-            fprintf(file, "Room %d\n", room_number);
-            fprintf(file, "-------\n");
-            current_room = room_number;
-
-            // Extract bench capacities for the room
-            two_seater_count = atoi(row[3]);
-            three_seater_count = atoi(row[4]);
+    for (mode = 0; mode < 2; mode++) {
+        SqlBatch text = {0};
+        StatementBatch prepared;
+        int failed = 0;
+        text.connection = conn;
+        text.prefix = "INSERT INTO seat_allocation (student_id, subject_id, room_id, bench_number, seat_number, day) "
+                      "VALUES ";
+        text.kind = QUERY_ALLOCATION_WRITE;
+        if (mode == 1 && statementBatchInit(&prepared, &mainStatements, text.prefix, NULL, 6,
+                                            QUERY_ALLOCATION_WRITE) == EXIT_FAILURE) {
+            break;
         }
-
-        // Section for a new bench
-        if (bench_number != current_bench) {
-            if (current_bench != -1) fprintf(file, "\n"); // Add spacing between benches
-            fprintf(file, "Bench %d: ", bench_number);
-            current_bench = bench_number;
+        if (mysql_autocommit(conn, 0)) {
+            fprintf(stderr, "Could not start transaction: %s\n", mysql_error(conn));
+            if (mode == 1) statementBatchFree(&prepared);
+            break;
         }
 
-        // Display seat allocation
-        fprintf(file, "%s (%s), ", symbol_number, subject_name);
-
-        // Add spacing and pipe based on seater type
-        if ((seat_number == 2 && bench_number <= two_seater_count) ||
-            (seat_number == 3 && bench_number > two_seater_count)) {
-            fprintf(file, "");  // End of row for 2- or 3-seater bench
+        double start = getCurrentTimeSeconds();
+        for (d = 0; d < engine.dayCount && !failed; d++) {
+            const AllocationDay *day = &engine.days[d];
+            for (i = 0; i < day->count && !failed; i++) {
+                const SeatAssignment *assignment = &day->assignments[i];
+                if (assignment->roomIndex < 0) {
+                    continue;
+                }
+                int row[6] = {assignment->student_id, assignment->subject_id,
+                              engine.rooms[assignment->roomIndex].room_id, assignment->bench, assignment->seat,
+                              day->day};
+                if (mode == 0) {
+                    char values[128];
+                    snprintf(values, sizeof(values), "(%d,%d,%d,%d,%d,%d)", row[0], row[1], row[2], row[3], row[4],
+                             row[5]);
+                    failed = sqlBatchBeginRow(&text) || sqlBufferAppend(&text.buffer, values) ||
+                             sqlBatchEndRow(&text);
+                } else {
+                    failed = statementBatchAdd(&prepared, row);
+                }
+                rows[2][mode]++;
+            }
         }
+        failed = failed || (mode == 0 ? sqlBatchFlush(&text) : statementBatchFlush(&prepared));
+        seconds[2][mode] = getCurrentTimeSeconds() - start;
+        mismatches += failed;
+
+        mysql_rollback(conn);
+        mysql_autocommit(conn, 1);
+        sqlBufferFree(&text.buffer);
+        if (mode == 1) statementBatchFree(&prepared);
     }
+    allocationEngineFree(&engine);
 
-    fprintf(file, "\n\nMatrix export complete.\n");
-
-    mysql_free_result(res);
-    fclose(file);
-    printf("\nSeat matrix exported successfully to %s.\n", filename);
+    printf("\n%-12s | %10s | %10s | %10s | %8s\n", "Query", "Rows", "Text s", "Prepared s", "Speedup");
+    printf("-------------------------------------------------------------\n");
+    for (i = 0; i < 3; i++) {
+        printf("%-12s | %10ld | %10.3f | %10.3f | %7.2fx\n", names[i], rows[i][1], seconds[i][0], seconds[i][1],
+               seconds[i][1] > 0 ? seconds[i][0] / seconds[i][1] : 0.0);
+    }
+    printf("Statements prepared: %ld, reused from the cache: %ld.\n", mainStatements.prepares - prepares,
+           mainStatements.hits - hits);
+    printf("Results %s.\n", mismatches == 0 ? "identical" : "DIFFER");
 }
 
-
-void getPassword(char *password, size_t size) {
-    printf("Enter password: ");
-    fflush(stdout);
-
-    char ch;
-    size_t i = 0;
-
-    while (i < size - 1 && (ch = getch()) != '\r') {
-        if (ch == '\b') { // Handle backspace
-            if (i > 0) {
-                printf("\b \b");
-                i--;
+#ifdef __linux__
+// Keep-alive HTTP client sending one lookup at a time and timing each round trip
+void *lookupClientThread(void *arg) {
+    LookupClient *client = arg;
+    struct sockaddr_in address;
+    char request[1024], encoded[768], response[SEAT_SERVICE_RESPONSE_BYTES + 512];
+    long n;
+    int noDelay = 1;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((uint16_t)client->port);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address))) {
+        perror("Could not connect to the seat service");
+        if (fd >= 0) close(fd);
+        client->failed = client->requests;
+        return NULL;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    for (n = 0; n < client->requests; n++) {
+        int k = (int)((client->first + n) % client->symbolCount);
+        int miss = n % BENCHMARK_LOOKUP_MISS_EVERY == BENCHMARK_LOOKUP_MISS_EVERY - 1;
+        urlEncode(encoded, sizeof(encoded), miss ? "no such student" : client->symbols[k]);
+        int length = snprintf(request, sizeof(request),
+                              "GET /seat?symbol=%s&day=%d HTTP/1.1\r\nHost: localhost\r\n\r\n", encoded,
+                              miss ? 0 : client->days[k]);
+        size_t received = 0, expected = 0;
+        int ok = 1;
+
+        double start = getCurrentTimeSeconds();
+        if (send(fd, request, length, MSG_NOSIGNAL) != length) {
+            ok = 0;
+        }
+        while (ok && (expected == 0 || received < expected)) {
+            ssize_t count = recv(fd, response + received, sizeof(response) - 1 - received, 0);
+            if (count <= 0) {
+                ok = 0;
+                break;
+            }
+            received += count;
+            response[received] = '\0';
+            char *headEnd = strstr(response, "\r\n\r\n");
+            char *contentLength = strstr(response, "Content-Length: ");
+            if (expected == 0 && headEnd != NULL && contentLength != NULL) {
+                expected = (size_t)(headEnd + 4 - response) + strtoul(contentLength + 16, NULL, 10);
             }
+        }
+        histogramRecord(client->latency, (uint64_t)((getCurrentTimeSeconds() - start) * 1e9));
+
+        if (!ok) {
+            client->failed += client->requests - n;
+            break;
+        }
+        int status = atoi(response + 9); // After "HTTP/1.1 "
+        if (status == 200 && !miss) {
+            client->found++;
+        } else if (status == 404 && miss) {
+            client->missing++;
         } else {
-            password[i++] = ch;
-            printf("*"); // Show asterisks for characters entered
+            client->failed++;
+        }
+        if (client->reloadAfter > 0 && n == client->reloadAfter) {
+            seatServiceRequestReload(client->service);
         }
     }
-
-    password[i] = '\0'; // Null-terminate the password
-    printf("\n");
+    close(fd);
+    return NULL;
 }
+#endif
 
-int registerUser() {
-    char username[50], password[50];
-    int role;
-
-    printf("\nEnter username: ");
-    scanf("%s", username);
-
-    // Check if the username already exists
-    char query[256];
-    snprintf(query, sizeof(query), "SELECT id FROM users WHERE username='%s'", username);
-
-    if (mysql_query(conn, query)) {
-        fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
-        return EXIT_FAILURE;
+// Lookups straight from the index, then the same lookups as HTTP requests from several clients. One
+// client asks for a reload halfway through to show lookups carrying on while a new index is built.
+void benchmarkSeatService() {
+#ifdef __linux__
+    SeatService service;
+    LookupClient clients[BENCHMARK_LOOKUP_CLIENTS];
+    Histogram direct, http;
+    StringPool pool = {0};
+    pthread_t server;
+    int i, started = 0;
+
+    if (seatServiceOpen(&service, conn, 0, NULL) == EXIT_FAILURE) {
+        return;
     }
-
-    MYSQL_RES *res = mysql_store_result(conn);
-    if (res == NULL) {
-        fprintf(stderr, "mysql_store_result() failed: %s\n", mysql_error(conn));
-        return EXIT_FAILURE;
+    size_t seatCount = service.index->seats.count;
+    if (seatCount == 0) {
+        printf("No saved seats; run an allocation first.\n");
+        seatServiceClose(&service);
+        return;
     }
 
-    MYSQL_ROW row = mysql_fetch_row(res);
-    if (row != NULL) {
-        printf("Username already exists. Please choose another.\n");
-        mysql_free_result(res);
-        return EXIT_FAILURE;
+    // Copied, since the reload frees the index they come from
+    int symbolCount = seatCount < 4096 ? (int)seatCount : 4096;
+    const char **symbols = malloc(sizeof(const char *) * symbolCount);
+    int *days = malloc(sizeof(int) * symbolCount);
+    if (symbols == NULL || days == NULL) {
+        fprintf(stderr, "Memory allocation failed for lookup benchmark.\n");
+        free(symbols);
+        free(days);
+        seatServiceClose(&service);
+        return;
     }
-    mysql_free_result(res);
-
-    // Securely get the password
-    getPassword(password, sizeof(password));
-
-    printf("Enter role (1 for Admin, 2 for Exam Coordinator): ");
-    scanf("%d", &role);
-
-    // Insert new user with hashed password into the users table
-    snprintf(query, sizeof(query),
-             "INSERT INTO users (username, password, role) VALUES ('%s', MD5('%s'), %d)",
-             username, password, role);
-
-    if (mysql_query(conn, query)) {
-        fprintf(stderr, "Error registering user: %s\n", mysql_error(conn));
-        return EXIT_FAILURE;
+    for (i = 0; i < symbolCount; i++) {
+        const SeatPlanEntry *entry = &service.index->seats.entries[(size_t)i * seatCount / symbolCount];
+        symbols[i] = stringPoolCopy(&pool, entry->symbol);
+        days[i] = entry->day;
+        if (symbols[i] == NULL) {
+            symbolCount = i;
+            break;
+        }
     }
 
-    printf("\nUser registered successfully.\n");
-    return EXIT_SUCCESS;
-}
-
-
-int login(char *username, int *role) {
-    char password[50];
-    char query[256];
-
-    // Securely get the password
-    getPassword(password, sizeof(password));
-
-    // Prepare the query with hashed password
-    snprintf(query, sizeof(query), 
-             "SELECT role FROM users WHERE username='%s' AND password=MD5('%s')", 
-             username, password);
-
-    // Execute the query
-    if (mysql_query(conn, query)) {
-        fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
-        return EXIT_FAILURE;
+    memset(&direct, 0, sizeof(direct));
+    memset(&http, 0, sizeof(http));
+    long directFound = 0, n;
+    double start = getCurrentTimeSeconds();
+    for (n = 0; n < BENCHMARK_LOOKUP_REQUESTS && symbolCount > 0; n++) {
+        const SeatPlanEntry *seats[SEAT_LOOKUP_MAX_SEATS];
+        int k = (int)(n % symbolCount);
+        double lookupStart = getCurrentTimeSeconds();
+        directFound += seatIndexFind(service.index, symbols[k], days[k], seats, SEAT_LOOKUP_MAX_SEATS) > 0;
+        histogramRecord(&direct, (uint64_t)((getCurrentTimeSeconds() - lookupStart) * 1e9));
     }
-
-    MYSQL_RES *res = mysql_store_result(conn);
-    if (res == NULL) {
-        fprintf(stderr, "Could not retrieve result: %s\n", mysql_error(conn));
-        return EXIT_FAILURE;
+    double directSeconds = getCurrentTimeSeconds() - start;
+
+    if (pthread_create(&server, NULL, seatServiceThread, &service)) {
+        fprintf(stderr, "Could not start the seat service.\n");
+        free(symbols);
+        free(days);
+        stringPoolFree(&pool);
+        seatServiceClose(&service);
+        return;
     }
-
-    // Check if the user exists and password matches
-    MYSQL_ROW row;
-    if ((row = mysql_fetch_row(res)) == NULL) {
-        printf("Invalid username or password.\n");
-        mysql_free_result(res);
-        return EXIT_FAILURE;
+    start = getCurrentTimeSeconds();
+    for (i = 0; i < BENCHMARK_LOOKUP_CLIENTS && symbolCount > 0; i++) {
+        memset(&clients[i], 0, sizeof(clients[i]));
+        clients[i].port = service.port;
+        clients[i].symbols = symbols;
+        clients[i].days = days;
+        clients[i].symbolCount = symbolCount;
+        clients[i].first = i * symbolCount / BENCHMARK_LOOKUP_CLIENTS;
+        clients[i].requests = BENCHMARK_LOOKUP_REQUESTS / BENCHMARK_LOOKUP_CLIENTS;
+        clients[i].latency = &http;
+        clients[i].service = &service;
+        clients[i].reloadAfter = i == 0 ? (int)(clients[i].requests / 2) : 0;
+        if (pthread_create(&clients[i].thread, NULL, lookupClientThread, &clients[i])) {
+            fprintf(stderr, "Could not start lookup client %d.\n", i);
+            break;
+        }
+        started++;
     }
+    long requests = 0, found = 0, missing = 0, failed = 0;
+    for (i = 0; i < started; i++) {
+        pthread_join(clients[i].thread, NULL);
+        requests += clients[i].requests;
+        found += clients[i].found;
+        missing += clients[i].missing;
+        failed += clients[i].failed;
+    }
+    double httpSeconds = getCurrentTimeSeconds() - start;
 
-    // Fetch role
-    *role = atoi(row[0]);
-
-    // Clean up
-    mysql_free_result(res);
-
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+    // Let the reload land before stopping, so it is part of what is reported
+    while (atomic_load(&service.reloading) || atomic_load(&service.pending) != NULL) {
+        sleepMicroseconds(1000);
+    }
+    seatServiceStop(&service);
+    pthread_join(server, NULL);
+
+    const char *names[2] = {"In-process index", "HTTP keep-alive"};
+    Histogram *histograms[2] = {&direct, &http};
+    long counts[2] = {n, requests};
+    double seconds[2] = {directSeconds, httpSeconds};
+    printf("\n%zu seats indexed, %d of them looked up, %d HTTP clients.\n", seatCount, symbolCount, started);
+    printf("%-16s | %9s | %8s | %10s | %8s | %8s | %8s | %8s\n", "Path", "Lookups", "Seconds", "Lookups/s",
+           "p50 us", "p99 us", "p99.9 us", "Max us");
+    printf("------------------------------------------------------------------------------------------------\n");
+    for (i = 0; i < 2; i++) {
+        printf("%-16s | %9ld | %8.3f | %10.0f | %8.2f | %8.2f | %8.2f | %8.2f\n", names[i], counts[i], seconds[i],
+               seconds[i] > 0 ? counts[i] / seconds[i] : 0.0, histogramPercentile(histograms[i], 50) / 1000.0,
+               histogramPercentile(histograms[i], 99) / 1000.0, histogramPercentile(histograms[i], 99.9) / 1000.0,
+               atomic_load(&histograms[i]->max) / 1000.0);
+    }
+    printf("Found %ld, not found %ld (unknown students), failed %ld; index generation %ld after the reload.\n",
+           found, missing, failed, service.generation);
+    printf("Results %s.\n", failed == 0 && directFound == n ? "as expected" : "UNEXPECTED");
+
+    seatServiceClose(&service);
+    free(symbols);
+    free(days);
+    stringPoolFree(&pool);
+#else
+    printf("The seat lookup service needs Linux (epoll).\n");
+#endif
+}